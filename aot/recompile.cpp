@@ -0,0 +1,98 @@
+// Static recompiler: translates the code reachable in a ROM into C++ for the 6502_aot target, see AotCore.
+// The ROM is a raw binary loaded at --load, or assembly source (*.s, *.asm). Code is followed from the ROM's
+// entry point (the load address for a raw binary), the reset, NMI and IRQ vectors when the ROM covers them, and
+// any --entry addresses, such as the targets of jump tables.
+//
+//   6502_recompile ROM [--load ADDR] [--entry ADDR]... [-o FILE.cpp]
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "assembler.h"
+#include "expression.h"
+#include "recompiler.h"
+
+namespace {
+
+    using namespace mos6502;
+
+    address parseAddress(const std::string_view text) {
+        const auto value = evaluate(text, [](std::string_view) -> std::optional<std::int64_t> { return std::nullopt; });
+        if (!value.known || value.value < 0 || value.value > 0xFFFF) throw std::runtime_error(fmt::format("bad address '{}'", text));
+        return static_cast<address>(value.value);
+    }
+
+    Program loadRom(const std::string& path, const std::optional<address> load) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error("cannot open " + path);
+        std::vector<byte> contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+        if (path.ends_with(".s") || path.ends_with(".asm")) {
+            return assemble(std::string_view(reinterpret_cast<const char*>(contents.data()), contents.size()));
+        }
+
+        if (!load) throw std::runtime_error("a raw ROM needs --load");
+        return Program(std::move(contents), *load, *load);
+    }
+
+} // namespace
+
+int main(const int argc, char* argv[]) {
+    try {
+        std::string rom;
+        std::string output;
+        std::optional<address> load;
+        std::vector<address> entries;
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view argument = argv[i];
+            const auto value = [&] {
+                if (++i == argc) throw std::runtime_error(fmt::format("{} needs a value", argument));
+                return std::string_view(argv[i]);
+            };
+
+            if (argument == "--load") load = parseAddress(value());
+            else if (argument == "--entry") entries.push_back(parseAddress(value()));
+            else if (argument == "-o") output = value();
+            else if (argument.starts_with("-")) throw std::runtime_error(fmt::format("unknown option {}", argument));
+            else rom = argument;
+        }
+        if (rom.empty()) {
+            fmt::println(stderr, "usage: 6502_recompile ROM [--load ADDR] [--entry ADDR]... [-o FILE.cpp]");
+            return 2;
+        }
+
+        const auto program = loadRom(rom, load);
+
+        Recompiler recompiler(program);
+        for (const auto entry : entries) recompiler.addEntry(entry);
+        recompiler.addVectors();
+        recompiler.analyse();
+
+        const auto source = recompiler.emit(rom);
+        if (output.empty()) {
+            std::fwrite(source.data(), 1, source.size(), stdout);
+        } else {
+            std::ofstream file(output, std::ios::binary);
+            if (!file.write(source.data(), static_cast<std::streamsize>(source.size()))) throw std::runtime_error("cannot write " + output);
+        }
+
+        std::size_t instructions = 0;
+        for (const auto& block : recompiler.blocks() | std::views::values) instructions += block.instructions.size();
+        fmt::println(stderr, "{}: {} blocks, {} instructions", rom, recompiler.blocks().size(), instructions);
+    } catch (const std::exception& e) {
+        fmt::println(stderr, "6502_recompile: {}", e.what());
+        return 1;
+    }
+    return 0;
+}
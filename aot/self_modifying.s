@@ -0,0 +1,12 @@
+; Self-modifying code for checking 6502_aot against the interpreter: each pass stores Y into the operand of the
+; LDA below, in the same basic block, so the compiled LDA #$00 is stale from the first pass on. $0302-$0340 end
+; up holding 01-3F on every backend.
+        .org $0200
+        LDY #$00
+loop:   INY
+        STY patch+1
+patch:  LDA #$00
+        STA $0301,Y
+        CPY #$40
+        BNE loop
+        BRK
@@ -0,0 +1,127 @@
+// Runs the same workload on CPU::run(), with and without superinstructions, and on the cycle-stepped TickCore,
+// checks that all end in the same state after the same number of cycles, and prints the emulated clock rate of
+// each and how many dispatches it took per emulated instruction.
+//
+//   6502_bench [ROUNDS]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#include <fmt/core.h>
+
+#include "assembler.h"
+#include "cpu.h"
+#include "tick_core.h"
+
+namespace {
+
+    using namespace mos6502;
+
+    // sums a page into a 16-bit checksum 64 times, through zero page, indexed and indirect accesses
+    constexpr auto workload = assemble<R"(
+            .org $0200
+            LDX #$00
+    init:   TXA
+            STA $0300,X
+            INX
+            BNE init
+
+            LDA #$00
+            STA $10
+            LDA #$03
+            STA $11
+            LDA #$40
+            STA $12
+
+    round:  LDY #$00
+    sum:    CLC
+            LDA ($10),Y
+            ADC $20
+            STA $20
+            LDA $21
+            ADC #$00
+            STA $21
+            ROL $22
+            INY
+            BNE sum
+            DEC $12
+            BNE round
+            BRK
+    )">();
+
+    struct Measurement {
+        double seconds;
+        std::uint64_t cycles;
+        std::uint64_t instructions;
+        std::uint64_t dispatches;
+        Registers registers;
+    };
+
+    template <typename Core>
+    Measurement measure(CPU& cpu, Core& core, const unsigned rounds) {
+        const auto program = workload.program();
+        const auto start = std::chrono::steady_clock::now();
+
+        std::uint64_t cycles = 0;
+        std::uint64_t instructions = 0;
+        std::uint64_t fused = 0;
+        for (unsigned i = 0; i < rounds; ++i) {
+            cpu.load(program);
+            const auto result = core.run(std::numeric_limits<std::uint64_t>::max());
+            cycles += result.cycles;
+            instructions += result.instructions;
+            fused += cpu.getFusedCount();
+        }
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return {elapsed.count(), cycles, instructions, instructions - fused, cpu.getRegisters()};
+    }
+
+    void report(const char* name, const Measurement& m) {
+        fmt::println("{:<12} {:>12} cycles  {:>8.3f} s  {:>8.2f} MHz  {:>6.2f} ns/cycle  {:>5.3f} dispatches/instruction",
+            name, m.cycles, m.seconds, m.cycles / m.seconds / 1e6, m.seconds * 1e9 / m.cycles,
+            static_cast<double>(m.dispatches) / m.instructions);
+    }
+
+    bool sameState(const Measurement& m, CPU& cpu, const Measurement& reference, CPU& referenceCpu) {
+        const auto& a = m.registers;
+        const auto& b = reference.registers;
+        return m.cycles == reference.cycles && m.instructions == reference.instructions && a.pc == b.pc
+            && a.sp == b.sp && a.ac == b.ac && a.x == b.x && a.y == b.y && a.sr == b.sr
+            && cpu.getMemory().peek(0x20) == referenceCpu.getMemory().peek(0x20)
+            && cpu.getMemory().peek(0x21) == referenceCpu.getMemory().peek(0x21);
+    }
+
+} // namespace
+
+int main(const int argc, const char* const* argv) {
+    const unsigned rounds = argc > 1 ? std::stoul(argv[1]) : 20;
+
+    CPU fast;
+    const auto interpreter = measure(fast, fast, rounds);
+
+    CPU unfusedCpu;
+    unfusedCpu.setSuperinstructions(false);
+    const auto unfused = measure(unfusedCpu, unfusedCpu, rounds);
+
+    CPU ticked;
+    TickCore tickCore(ticked);
+    const auto tick = measure(ticked, tickCore, rounds);
+
+    report("interpreter", interpreter);
+    report("unfused", unfused);
+    report("tick", tick);
+
+    if (!sameState(unfused, unfusedCpu, interpreter, fast) || !sameState(tick, ticked, interpreter, fast)) {
+        fmt::println(stderr, "the cores disagree");
+        return 1;
+    }
+    fmt::println("superinstructions save {:.1f}% of dispatches, {:.1f}% of time",
+        100.0 * (unfused.dispatches - interpreter.dispatches) / unfused.dispatches,
+        100.0 * (unfused.seconds - interpreter.seconds) / unfused.seconds);
+    fmt::println("tick core is {:.1f}x slower", tick.seconds / interpreter.seconds);
+    return 0;
+}
@@ -0,0 +1,711 @@
+// Differential tester: runs the core in lockstep with ReferenceCPU over randomized programs, and checks both
+// against per-opcode JSON test vectors in the "SingleStepTests" format. Every bus cycle is compared, so the core
+// is built with MOS6502_BUS_LOG for this tool. `--core tick` checks the cycle-stepped TickCore instead of CPU::step().
+//
+// `--run PROGRAMS` checks what only CPU::run() does, superinstructions and fast-forwarded idle, copy and fill loops,
+// against run() with all of them turned off, and superinstructions on their own as well, on generated programs full
+// of those loops and under a timer IRQ.
+//
+//   6502_difftest [--core interpreter|tick] [--threads N] [--random PROGRAMS] [--run PROGRAMS] [--seed S] [--steps N]
+//                 [FILE.json | DIRECTORY]...
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "cpu.h"
+#include "disassembler.h"
+#include "reference_cpu.h"
+#include "test_vectors.h"
+#include "tick_core.h"
+
+#ifndef MOS6502_BUS_LOG
+#error "6502_difftest compares bus cycles, build it with MOS6502_BUS_LOG defined"
+#endif
+
+namespace {
+
+    using namespace mos6502;
+
+    constexpr std::size_t messagesPerOpcode = 3;
+    constexpr std::size_t divergencesShown = 10;
+
+    // flag bits that exist in the status register, B and the unused bit only exist on the stack
+    constexpr byte flagMask = 0b11001111;
+
+    struct Settings {
+        std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        std::uint64_t programs = 0;
+        std::uint64_t runPrograms = 0;
+        std::uint64_t seed = 6502;
+        std::size_t steps = 1000;
+        bool tick = false;
+        std::vector<std::filesystem::path> files;
+    };
+
+    struct Report {
+        std::uint64_t vectors = 0;
+        std::uint64_t skipped = 0;
+        std::uint64_t programs = 0;
+        std::uint64_t instructions = 0;
+        std::array<std::uint64_t, 256> coreFailures{};
+        std::array<std::uint64_t, 256> referenceFailures{};
+        std::array<std::vector<std::string>, 256> messages;
+        std::vector<std::string> divergences;
+        std::uint64_t divergenceCount = 0;
+        std::uint64_t runPrograms = 0;
+        std::uint64_t runInstructions = 0;
+        std::uint64_t runDivergences = 0;
+        std::uint64_t runFused = 0;   // instructions run() fused, so the comparison is known to have covered some
+        std::uint64_t runSkipped = 0; // and fast-forwarded
+
+        void fail(const byte opcode, std::string message) {
+            if (messages[opcode].size() < messagesPerOpcode) messages[opcode].push_back(std::move(message));
+        }
+
+        void merge(const Report& other) {
+            vectors += other.vectors;
+            skipped += other.skipped;
+            programs += other.programs;
+            instructions += other.instructions;
+            divergenceCount += other.divergenceCount;
+            runPrograms += other.runPrograms;
+            runInstructions += other.runInstructions;
+            runDivergences += other.runDivergences;
+            runFused += other.runFused;
+            runSkipped += other.runSkipped;
+            for (int i = 0; i < 256; ++i) {
+                coreFailures[i] += other.coreFailures[i];
+                referenceFailures[i] += other.referenceFailures[i];
+                for (const auto& message : other.messages[i]) fail(i, message);
+            }
+            for (const auto& divergence : other.divergences) {
+                if (divergences.size() < divergencesShown) divergences.push_back(divergence);
+            }
+        }
+    };
+
+    struct Machine {
+        CPU cpu;
+        TickCore tickCore{cpu};
+        bool tick;
+        std::vector<BusCycle> bus;
+        ReferenceCPU reference;
+
+        explicit Machine(const bool tick) : tick(tick) {
+            cpu.setHaltOnBrk(false);
+            cpu.getMemory().setBusLog(&bus);
+        }
+
+        // one instruction on the core under test
+        cycles step() {
+            return tick ? tickCore.step() : cpu.step();
+        }
+    };
+
+    struct State {
+        word pc;
+        byte s, a, x, y, p;
+    };
+
+    State state(const CPU& cpu) {
+        const auto r = cpu.getRegisters();
+        return {r.pc, r.sp, r.ac, r.x, r.y, r.sr};
+    }
+
+    State state(const ReferenceCPU& cpu) {
+        return {cpu.pc, cpu.s, cpu.a, cpu.x, cpu.y, cpu.p};
+    }
+
+    // empty if the two states agree, otherwise one "field: actual, expected" entry per difference
+    std::string compare(const State& actual, const State& expected) {
+        std::string differences;
+        auto check = [&](const char* name, const int a, const int e, const int width) {
+            if (a != e) differences += fmt::format(" {}: ${:0{}X}, expected ${:0{}X};", name, a, width, e, width);
+        };
+        check("pc", actual.pc, expected.pc, 4);
+        check("s", actual.s, expected.s, 2);
+        check("a", actual.a, expected.a, 2);
+        check("x", actual.x, expected.x, 2);
+        check("y", actual.y, expected.y, 2);
+        check("p", actual.p & flagMask, expected.p & flagMask, 2);
+        return differences;
+    }
+
+    std::string compareCycles(const int actual, const int expected) {
+        return actual == expected ? "" : fmt::format(" cycles: {}, expected {};", actual, expected);
+    }
+
+    std::string compareBus(const std::vector<BusCycle>& actual, const std::vector<BusCycle>& expected) {
+        if (actual == expected) return "";
+        auto list = [](const std::vector<BusCycle>& cycles) {
+            std::string text;
+            for (const auto& [addr, value, write] : cycles) text += fmt::format(" {}${:04X}=${:02X}", write ? "w" : "r", addr, value);
+            return text;
+        };
+        return fmt::format(" bus:{}, expected:{};", list(actual), list(expected));
+    }
+
+    std::string instructionAt(const address pc, const auto& read) {
+        const byte bytes[3] = {read(pc), read(static_cast<address>(pc + 1)), read(static_cast<address>(pc + 2))};
+        char text[maxInstructionLength];
+        return fmt::format("${:04X}: {}", pc, std::string_view(text, disassemble(text, pc, bytes)));
+    }
+
+#pragma region Test vectors
+
+    // runs one vector on the core, returns the differences
+    std::string runCore(Machine& machine, const TestVector& vector) {
+        auto& memory = machine.cpu.getMemory();
+        const auto& [pc, s, a, x, y, p, ram] = vector.initial;
+        for (const auto& [addr, value] : ram) memory.poke(addr, value);
+        machine.cpu.setRegisters({pc, s, a, x, y, p});
+        machine.bus.clear();
+
+        cycles elapsed;
+        try {
+            elapsed = machine.step();
+        } catch (const std::exception& e) {
+            return fmt::format(" threw '{}'", e.what());
+        }
+
+        const auto& expected = vector.final;
+        std::string differences = compare(state(machine.cpu), {expected.pc, expected.s, expected.a, expected.x, expected.y, expected.p});
+        if (!vector.cycles.empty()) {
+            differences += compareCycles(elapsed, static_cast<int>(vector.cycles.size()));
+            differences += compareBus(machine.bus, vector.cycles);
+        }
+        for (const auto& [addr, value] : expected.ram) {
+            if (memory.peek(addr) != value) {
+                differences += fmt::format(" ${:04X}: ${:02X}, expected ${:02X};", addr, memory.peek(addr), value);
+            }
+        }
+        return differences;
+    }
+
+    std::string runReference(ReferenceCPU& reference, const TestVector& vector) {
+        const auto& [pc, s, a, x, y, p, ram] = vector.initial;
+        for (const auto& [addr, value] : ram) reference.ram[addr] = value;
+        reference.pc = pc;
+        reference.s = s;
+        reference.a = a;
+        reference.x = x;
+        reference.y = y;
+        reference.p = p;
+
+        const int elapsed = reference.step();
+
+        const auto& expected = vector.final;
+        std::string differences = compare(state(reference), {expected.pc, expected.s, expected.a, expected.x, expected.y, expected.p});
+        if (!vector.cycles.empty()) {
+            differences += compareCycles(elapsed, static_cast<int>(vector.cycles.size()));
+            differences += compareBus(reference.bus, vector.cycles);
+        }
+        for (const auto& [addr, value] : expected.ram) {
+            if (reference.ram[addr] != value) {
+                differences += fmt::format(" ${:04X}: ${:02X}, expected ${:02X};", addr, reference.ram[addr], value);
+            }
+        }
+        return differences;
+    }
+
+    void runVectorFile(Machine& machine, const std::filesystem::path& path, Report& report) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error("cannot open " + path.string());
+        const std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+        for (const auto& vector : readTestVectors(text)) {
+            byte opcode = 0;
+            for (const auto& [addr, value] : vector.initial.ram) {
+                if (addr == vector.initial.pc) opcode = value;
+            }
+            if (opcodes[opcode].mnemonic == Mnemonic::Illegal) {
+                ++report.skipped;
+                continue;
+            }
+            ++report.vectors;
+
+            if (auto differences = runCore(machine, vector); !differences.empty()) {
+                ++report.coreFailures[opcode];
+                report.fail(opcode, fmt::format("core      {}:{}", vector.name, differences));
+            }
+            if (auto differences = runReference(machine.reference, vector); !differences.empty()) {
+                ++report.referenceFailures[opcode];
+                report.fail(opcode, fmt::format("reference {}:{}", vector.name, differences));
+            }
+        }
+    }
+
+#pragma endregion
+#pragma region Random programs
+
+    std::vector<byte> legalOpcodes() {
+        std::vector<byte> legal;
+        for (int i = 0; i < 256; ++i) {
+            if (opcodes[i].mnemonic != Mnemonic::Illegal) legal.push_back(i);
+        }
+        return legal;
+    }
+
+    // random memory, with a page of legal instructions at $0200 where execution starts
+    void generate(ReferenceCPU& reference, const std::uint64_t seed) {
+        static const auto legal = legalOpcodes();
+        std::mt19937_64 rng(seed);
+
+        for (std::size_t i = 0; i < reference.ram.size(); i += 8) {
+            const auto bits = rng();
+            for (int j = 0; j < 8; ++j) reference.ram[i + j] = bits >> j * 8;
+        }
+        for (address pc = 0x0200; pc < 0x0300;) {
+            const byte opcode = legal[rng() % legal.size()];
+            reference.ram[pc] = opcode;
+            pc += opcodes[opcode].length;
+        }
+
+        const auto registers = rng();
+        reference.pc = 0x0200;
+        reference.s = registers;
+        reference.a = registers >> 8;
+        reference.x = registers >> 16;
+        reference.y = registers >> 24;
+        reference.p = (registers >> 32 & ~ReferenceCPU::B) | ReferenceCPU::U;
+    }
+
+    // regenerates the program, replays it up to instruction `index` and writes that instruction as a test vector,
+    // with the memory it touched and the state and bus cycles of the reference
+    std::string reproducer(const std::uint64_t seed, const std::uint64_t index) {
+        auto reference = std::make_unique<ReferenceCPU>();
+        generate(*reference, seed);
+        for (std::uint64_t i = 0; i < index; ++i) (void)reference->step();
+
+        const auto before = std::make_unique<ReferenceCPU>(*reference);
+        (void)reference->step();
+
+        TestVector vector;
+        vector.name = fmt::format("seed {} instruction {}", seed, index);
+        vector.initial = {before->pc, before->s, before->a, before->x, before->y, before->p, {}};
+        vector.final = {reference->pc, reference->s, reference->a, reference->x, reference->y, reference->p, {}};
+
+        std::vector<address> touched;
+        for (const auto& cycle : reference->bus) touched.push_back(cycle.addr);
+        std::ranges::sort(touched);
+        touched.erase(std::ranges::unique(touched).begin(), touched.end());
+        for (const auto addr : touched) {
+            vector.initial.ram.push_back({addr, before->ram[addr]});
+            vector.final.ram.push_back({addr, reference->ram[addr]});
+        }
+        vector.cycles = reference->bus;
+        return toJson(vector);
+    }
+
+    void runProgram(Machine& machine, const Settings& settings, const std::uint64_t number, Report& report) {
+        auto& [cpu, tickCore, tick, bus, reference] = machine;
+        const auto seed = settings.seed + number;
+        generate(reference, seed);
+
+        auto& memory = cpu.getMemory();
+        for (int addr = 0; addr < 0x10000; ++addr) memory.poke(addr, reference.ram[addr]);
+        const auto [pc, s, a, x, y, p] = state(reference);
+        cpu.setRegisters({pc, s, a, x, y, p});
+
+        ++report.programs;
+        for (std::uint64_t index = 0; index < settings.steps; ++index) {
+            const address at = reference.pc;
+            const byte opcode = reference.ram[at];
+            const auto instruction = instructionAt(at, [&](const address addr) { return reference.ram[addr]; });
+
+            const int expectedCycles = reference.step();
+            if (expectedCycles == 0) return; // illegal opcode, both cores stop here
+            ++report.instructions;
+
+            bus.clear();
+            std::string differences;
+            try {
+                const cycles elapsed = machine.step();
+                differences = compareCycles(elapsed, expectedCycles) + compare(state(cpu), state(reference))
+                            + compareBus(bus, reference.bus);
+            } catch (const std::exception& e) {
+                differences = fmt::format(" threw '{}'", e.what());
+            }
+            if (differences.empty()) continue;
+
+            ++report.divergenceCount;
+            ++report.coreFailures[opcode];
+            if (report.divergences.size() < divergencesShown) {
+                report.divergences.push_back(fmt::format("program {} (seed {}), instruction {} at {}:{}\n  reproducer: {}",
+                    number, seed, index, instruction, differences, reproducer(seed, index)));
+            }
+            return;
+        }
+    }
+
+#pragma endregion
+#pragma region Fast paths
+
+    // the IRQ source of the run() comparison: asserts the line every `period` cycles, a write to its page
+    // acknowledges it
+    class Timer : public TimedDevice, public PageHandler {
+        CPU& cpu;
+        std::uint64_t period;
+
+    public:
+        static constexpr byte page = 0xD0;
+
+        Timer(CPU& cpu, const std::uint64_t period) : cpu(cpu), period(period) {
+            cpu.getMemory().mapWrite(page, this);
+            cpu.schedule(this, period);
+        }
+
+        void expire(const std::uint64_t now) override {
+            cpu.setIrq(1, true);
+            cpu.schedule(this, now + period);
+        }
+
+        byte read(const address addr) override { return cpu.getMemory().peek(addr); }
+        void write(address, byte) override { cpu.setIrq(1, false); }
+    };
+
+    // opcodes that neither jump nor touch the stack, with operands that stay in the zero page
+    std::vector<byte> straightOpcodes() {
+        std::vector<byte> straight;
+        for (int i = 0; i < 256; ++i) {
+            const auto& [mnemonic, mode, length, cycles, penalty] = opcodes[i];
+            using enum Mnemonic;
+            if (mnemonic == Illegal || mnemonic == BRK || mnemonic == JMP || mnemonic == JSR || mnemonic == RTS
+                || mnemonic == RTI || mnemonic == TXS || mnemonic == PHA || mnemonic == PHP || mnemonic == PLA
+                || mnemonic == PLP || mode == Mode::Relative) continue;
+            if (mode == Mode::Implied || mode == Mode::Accumulator || mode == Mode::Immediate
+                || mode == Mode::ZeroPage || mode == Mode::ZeroPageX || mode == Mode::ZeroPageY) straight.push_back(i);
+        }
+        return straight;
+    }
+
+    /*
+     * A program made of the loops run() fast-forwards or fuses, in random variants and with random data:
+     * copy and fill loops over (zp),Y, abs,Y and abs,X counting either way, sometimes onto their own source;
+     * counted loops of straight-line code; and idle loops that wait for the IRQ handler to bump $30, or for
+     * nothing at all. The IRQ handler at $0F00 bumps $30 and acknowledges the timer. Memory from $1000 to
+     * $7FFF is random, everything else zero but for the code.
+     */
+    std::vector<byte> generateRunProgram(std::mt19937_64& rng, std::array<byte, 0x10000>& ram) {
+        static const auto straight = straightOpcodes();
+        const auto random = [&rng](const unsigned bound) { return static_cast<unsigned>(rng() % bound); };
+
+        ram.fill(0);
+        for (std::size_t addr = 0x1000; addr < 0x8000; ++addr) ram[addr] = rng();
+        constexpr byte handler[] = {0x48, 0xE6, 0x30, 0x8D, 0x00, Timer::page, 0x68, 0x40}; // PHA INC $30 STA $D000 PLA RTI
+        std::ranges::copy(handler, ram.begin() + 0x0F00);
+        ram[0xFFFE] = 0x00;
+        ram[0xFFFF] = 0x0F;
+
+        std::vector<byte> code;
+        const auto emit = [&code](const std::initializer_list<byte> bytes) { code.insert(code.end(), bytes); };
+        const auto branchBack = [&](const byte opcode, const std::size_t head) {
+            emit({opcode, static_cast<byte>(static_cast<int>(head) - static_cast<int>(code.size() + 2))});
+        };
+
+        emit({random(2) ? byte{0x58} : byte{0x78}}); // CLI or SEI
+        for (int segment = 0, segments = 1 + random(6); segment < segments; ++segment) {
+            switch (random(4)) {
+                case 0:
+                case 1: { // copy or fill
+                    const word source = 0x1000 + random(0x5000);
+                    const word destination = random(4) ? 0x1000 + random(0x5000) : source + random(40) - 20;
+                    emit({0xA9, static_cast<byte>(source), 0x85, 0x20, 0xA9, static_cast<byte>(source >> 8), 0x85, 0x21});
+                    emit({0xA9, static_cast<byte>(destination), 0x85, 0x22, 0xA9, static_cast<byte>(destination >> 8), 0x85, 0x23});
+                    emit({0xA9, static_cast<byte>(rng())});
+                    const bool x = random(3) == 0;
+                    emit({x ? byte{0xA2} : byte{0xA0}, static_cast<byte>(rng())});
+                    const bool copy = random(3) != 0;
+                    const std::size_t head = code.size();
+                    if (x) {
+                        if (copy) emit({0xBD, static_cast<byte>(source), static_cast<byte>(source >> 8)});
+                        emit({0x9D, static_cast<byte>(destination), static_cast<byte>(destination >> 8)});
+                        emit({random(2) ? byte{0xE8} : byte{0xCA}});
+                    } else {
+                        if (copy && random(2)) emit({0xB1, 0x20});
+                        else if (copy) emit({0xB9, static_cast<byte>(source), static_cast<byte>(source >> 8)});
+                        if (random(2)) emit({0x91, 0x22});
+                        else emit({0x99, static_cast<byte>(destination), static_cast<byte>(destination >> 8)});
+                        emit({random(2) ? byte{0xC8} : byte{0x88}});
+                    }
+                    branchBack(0xD0, head);
+                    break;
+                }
+                case 2: { // a counted loop of straight-line code, where most superinstructions come from
+                    emit({0xA2, static_cast<byte>(1 + random(255))});
+                    const std::size_t head = code.size();
+                    for (int i = 0, count = 1 + random(6); i < count; ++i) {
+                        const byte opcode = straight[random(straight.size())];
+                        // X counts the loop, and $20-$3F hold the pointers and the IRQ counter
+                        if (opcodes[opcode].mnemonic == Mnemonic::LDX || opcodes[opcode].mnemonic == Mnemonic::TAX
+                            || opcodes[opcode].mnemonic == Mnemonic::TSX || opcodes[opcode].mnemonic == Mnemonic::INX
+                            || opcodes[opcode].mnemonic == Mnemonic::DEX) continue;
+                        code.push_back(opcode);
+                        if (opcodes[opcode].length == 2) code.push_back(opcodes[opcode].mode == Mode::Immediate ? rng() : 0x40 + random(0xC0));
+                    }
+                    if (random(2)) emit({0x8A, 0x85, static_cast<byte>(0x40 + random(0xC0))}); // TXA STA zp
+                    emit({0xCA}); // DEX
+                    branchBack(0xD0, head);
+                    break;
+                }
+                default: { // an idle loop, left once the IRQ handler has run
+                    emit({0xA9, 0x00, 0x85, 0x30});
+                    const std::size_t head = code.size();
+                    emit({0xA5, 0x30});
+                    branchBack(0xF0, head);
+                    break;
+                }
+            }
+        }
+        if (random(2)) emit({0x4C, static_cast<byte>(0x0200 + code.size()), static_cast<byte>((0x0200 + code.size()) >> 8)}); // JMP *
+        emit({0x00});
+        return code;
+    }
+
+    struct RunOutcome {
+        RunResult result;
+        std::string error;
+    };
+
+    RunOutcome runBudget(CPU& cpu, const std::uint64_t budget) {
+        try {
+            return {cpu.run(budget), {}};
+        } catch (const std::exception& e) {
+            return {{}, e.what()};
+        }
+    }
+
+    // empty if a run() slice with fast paths agrees with the plain one, otherwise one entry per difference
+    std::string compareRuns(const CPU& cpu, const RunOutcome& outcome, const CPU& plain, const RunOutcome& expected) {
+        std::string differences;
+        if (outcome.error != expected.error) {
+            differences += fmt::format(" threw '{}', expected '{}';", outcome.error, expected.error);
+        }
+        if (outcome.result.reason != expected.result.reason) {
+            differences += fmt::format(" stopped {}, expected {};", static_cast<int>(outcome.result.reason),
+                static_cast<int>(expected.result.reason));
+        }
+        if (outcome.result.instructions != expected.result.instructions) {
+            differences += fmt::format(" instructions: {}, expected {};", outcome.result.instructions, expected.result.instructions);
+        }
+        if (cpu.getCycleCount() != plain.getCycleCount()) {
+            differences += fmt::format(" cycle count: {}, expected {};", cpu.getCycleCount(), plain.getCycleCount());
+        }
+        differences += compare(state(cpu), state(plain));
+        const byte* memory = cpu.getMemory().physical();
+        const byte* plainMemory = plain.getMemory().physical();
+        if (std::memcmp(memory, plainMemory, 0x10000) != 0) {
+            std::size_t addr = 0;
+            while (memory[addr] == plainMemory[addr]) ++addr;
+            differences += fmt::format(" ${:04X}: ${:02X}, expected ${:02X} (first difference);", addr, memory[addr], plainMemory[addr]);
+        }
+        return differences;
+    }
+
+    // runs a generated program in slices of random budgets on a CPU with superinstructions alone, so a wrong one
+    // is told apart from the loops fast-forwarded around it, on one with everything run() does beyond executing
+    // instructions one by one, and on one with none of it, comparing the first two to the last after every slice
+    void runFastPaths(const Settings& settings, const std::uint64_t number, Report& report) {
+        const auto seed = settings.seed + number;
+        std::mt19937_64 rng(seed);
+        auto ram = std::make_unique<std::array<byte, 0x10000>>();
+        const auto code = generateRunProgram(rng, *ram);
+        const auto period = 50 + rng() % 5000;
+
+        struct Variant {
+            const char* name;
+            bool fast; // idle skipping and bulk loops
+            bool fused;
+            std::unique_ptr<CPU> cpu = std::make_unique<CPU>();
+            std::unique_ptr<Timer> timer{};
+            RunOutcome outcome{};
+        };
+        std::array<Variant, 3> variants{{{"superinstructions", false, true}, {"fast paths", true, true}, {"plain", false, false}}};
+        for (auto& [name, fast, fused, cpu, timer, outcome] : variants) {
+            cpu->setIdleSkipping(fast);
+            cpu->setBulkLoops(fast);
+            cpu->setSuperinstructions(fused);
+            cpu->load(Program(code, 0x0200));
+            Memory& memory = cpu->getMemory();
+            for (std::size_t addr = 0; addr < ram->size(); ++addr) {
+                if (addr < 0x0200 || addr >= 0x0200 + code.size()) memory.poke(addr, (*ram)[addr]);
+            }
+            timer = std::make_unique<Timer>(*cpu, period);
+        }
+        const Variant& plain = variants.back();
+
+        ++report.runPrograms;
+        struct Count {
+            Report& report;
+            const CPU& fused;
+            const CPU& fast;
+            ~Count() {
+                report.runFused += fused.getFusedCount();
+                report.runSkipped += fast.getSkippedCount();
+            }
+        } count{report, *variants[0].cpu, *variants[1].cpu};
+        for (int slice = 0; slice < 16 && !plain.cpu->isHalted(); ++slice) {
+            const std::uint64_t budget = 1 + rng() % (rng() % 4 ? 3000 : 100'000);
+            for (auto& variant : variants) variant.outcome = runBudget(*variant.cpu, budget);
+            report.runInstructions += plain.outcome.result.instructions;
+
+            for (const auto& variant : variants) {
+                if (&variant == &plain) continue;
+                const auto differences = compareRuns(*variant.cpu, variant.outcome, *plain.cpu, plain.outcome);
+                if (differences.empty()) continue;
+
+                ++report.runDivergences;
+                if (report.divergences.size() < divergencesShown) {
+                    report.divergences.push_back(fmt::format("run program {} (seed {}), slice {} of {} cycles, {}:{}",
+                        number, seed, slice, budget, variant.name, differences));
+                }
+                return;
+            }
+            if (!plain.outcome.error.empty()) return;
+        }
+    }
+
+#pragma endregion
+
+    Settings parseSettings(const int argc, const char* const* argv) {
+        Settings settings;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view argument = argv[i];
+            auto value = [&]() -> std::uint64_t {
+                if (i + 1 >= argc) throw std::invalid_argument(fmt::format("{} needs a value", argument));
+                return std::stoull(argv[++i], nullptr, 0);
+            };
+
+            if (argument == "--core") {
+                if (i + 1 >= argc) throw std::invalid_argument("--core needs a value");
+                const std::string_view core = argv[++i];
+                if (core != "interpreter" && core != "tick") throw std::invalid_argument(fmt::format("unknown core {}", core));
+                settings.tick = core == "tick";
+            }
+            else if (argument == "--threads") settings.threads = std::max<std::uint64_t>(1, value());
+            else if (argument == "--random") settings.programs = value();
+            else if (argument == "--run") settings.runPrograms = value();
+            else if (argument == "--seed") settings.seed = value();
+            else if (argument == "--steps") settings.steps = value();
+            else if (argument.starts_with("--")) throw std::invalid_argument(fmt::format("unknown option {}", argument));
+            else if (std::filesystem::is_directory(argument)) {
+                for (const auto& entry : std::filesystem::directory_iterator(argument)) {
+                    if (entry.path().extension() == ".json") settings.files.push_back(entry.path());
+                }
+            }
+            else settings.files.emplace_back(argument);
+        }
+        std::ranges::sort(settings.files);
+        if (settings.files.empty() && settings.programs == 0 && settings.runPrograms == 0) settings.programs = 100'000;
+        return settings;
+    }
+
+    void print(const Report& report) {
+        for (int opcode = 0; opcode < 256; ++opcode) {
+            if (!report.coreFailures[opcode] && !report.referenceFailures[opcode]) continue;
+            const auto& info = opcodes[opcode];
+            fmt::println("${:02X} {}: {} core failures, {} reference failures",
+                opcode, name(info.mnemonic), report.coreFailures[opcode], report.referenceFailures[opcode]);
+            for (const auto& message : report.messages[opcode]) fmt::println("  {}", message);
+        }
+        for (const auto& divergence : report.divergences) fmt::println("{}", divergence);
+
+        if (report.vectors || report.skipped) {
+            std::uint64_t core = 0;
+            std::uint64_t reference = 0;
+            for (int i = 0; i < 256; ++i) {
+                core += report.coreFailures[i];
+                reference += report.referenceFailures[i];
+            }
+            core -= report.divergenceCount;
+            fmt::println("vectors: {} run, {} core failures, {} reference failures, {} skipped (illegal opcodes)",
+                report.vectors, core, reference, report.skipped);
+        }
+        if (report.programs) {
+            fmt::println("random: {} programs, {} instructions, {} divergences",
+                report.programs, report.instructions, report.divergenceCount);
+        }
+        if (report.runPrograms) {
+            fmt::println("run: {} programs, {} instructions ({} fused, {} fast-forwarded), {} divergences",
+                report.runPrograms, report.runInstructions, report.runFused, report.runSkipped, report.runDivergences);
+        }
+    }
+
+} // namespace
+
+int main(const int argc, const char* const* argv) {
+    Settings settings;
+    try {
+        settings = parseSettings(argc, argv);
+    } catch (const std::exception& e) {
+        fmt::println(stderr, "{}\nusage: {} [--core interpreter|tick] [--threads N] [--random PROGRAMS] [--run PROGRAMS] [--seed S] [--steps N] [FILE.json | DIRECTORY]...",
+            e.what(), argv[0]);
+        return 2;
+    }
+
+    // files are handed out first, then random programs in batches, to whichever thread is free
+    constexpr std::uint64_t batch = 64;
+    std::atomic<std::uint64_t> nextFile = 0;
+    std::atomic<std::uint64_t> nextProgram = 0;
+    std::atomic<std::uint64_t> nextRunProgram = 0;
+    std::vector<Report> reports(settings.threads);
+    std::vector<std::string> errors(settings.threads);
+
+    {
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < settings.threads; ++t) {
+            threads.emplace_back([&, t] {
+                try {
+                    auto machine = std::make_unique<Machine>(settings.tick);
+                    for (auto i = nextFile++; i < settings.files.size(); i = nextFile++) {
+                        runVectorFile(*machine, settings.files[i], reports[t]);
+                    }
+                    for (auto first = nextProgram.fetch_add(batch); first < settings.programs; first = nextProgram.fetch_add(batch)) {
+                        for (auto i = first; i < std::min(first + batch, settings.programs); ++i) {
+                            runProgram(*machine, settings, i, reports[t]);
+                        }
+                    }
+                    for (auto first = nextRunProgram.fetch_add(batch); first < settings.runPrograms; first = nextRunProgram.fetch_add(batch)) {
+                        for (auto i = first; i < std::min(first + batch, settings.runPrograms); ++i) {
+                            runFastPaths(settings, i, reports[t]);
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    errors[t] = e.what();
+                }
+            });
+        }
+    }
+
+    Report total;
+    for (const auto& report : reports) total.merge(report);
+    print(total);
+
+    bool failed = false;
+    for (const auto& error : errors) {
+        if (error.empty()) continue;
+        fmt::println(stderr, "error: {}", error);
+        failed = true;
+    }
+    for (int i = 0; i < 256; ++i) {
+        failed |= total.coreFailures[i] || total.referenceFailures[i];
+    }
+    failed |= total.runDivergences != 0;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace mos6502 {
+
+    // Pull parser over a JSON document held in memory. Test vector files run to millions of objects,
+    // so values are decoded straight into the caller's structures instead of building a tree.
+    class JsonReader {
+        std::string_view text;
+        std::size_t pos = 0;
+
+        void skipSpaces() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\r' || text[pos] == '\t')) ++pos;
+        }
+
+        [[noreturn]] void error(const std::string_view message) const {
+            throw std::runtime_error(std::string(message) + " at offset " + std::to_string(pos));
+        }
+
+    public:
+        explicit JsonReader(const std::string_view text) : text(text) {}
+
+        [[nodiscard]] char peek() {
+            skipSpaces();
+            if (pos >= text.size()) error("unexpected end of input");
+            return text[pos];
+        }
+
+        void expect(const char c) {
+            if (peek() != c) error(std::string("expected '") + c + "'");
+            ++pos;
+        }
+
+        [[nodiscard]] bool atEnd() {
+            skipSpaces();
+            return pos >= text.size();
+        }
+
+        [[nodiscard]] std::int64_t readInteger() {
+            skipSpaces();
+            const bool negative = pos < text.size() && text[pos] == '-';
+            if (negative) ++pos;
+
+            const auto start = pos;
+            std::int64_t value = 0;
+            while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+                value = value * 10 + (text[pos++] - '0');
+            }
+            if (pos == start) error("expected a number");
+            return negative ? -value : value;
+        }
+
+        // strings in test vectors are plain ASCII, escapes are kept as written
+        [[nodiscard]] std::string_view readString() {
+            expect('"');
+            const auto start = pos;
+            while (pos < text.size() && text[pos] != '"') {
+                if (text[pos] == '\\') ++pos;
+                ++pos;
+            }
+            if (pos >= text.size()) error("unterminated string");
+            return text.substr(start, pos++ - start);
+        }
+
+        // calls `element()` for each element, which must consume exactly one value
+        template <typename Element>
+        void readArray(Element element) {
+            expect('[');
+            if (peek() == ']') {
+                ++pos;
+                return;
+            }
+            while (true) {
+                element();
+                if (peek() == ']') {
+                    ++pos;
+                    return;
+                }
+                expect(',');
+            }
+        }
+
+        // calls `member(key)` for each member, which must consume exactly one value
+        template <typename Member>
+        void readObject(Member member) {
+            expect('{');
+            if (peek() == '}') {
+                ++pos;
+                return;
+            }
+            while (true) {
+                const auto key = readString();
+                expect(':');
+                member(key);
+                if (peek() == '}') {
+                    ++pos;
+                    return;
+                }
+                expect(',');
+            }
+        }
+
+        void skipValue() {
+            switch (peek()) {
+                case '{': readObject([this](std::string_view) { skipValue(); }); break;
+                case '[': readArray([this] { skipValue(); }); break;
+                case '"': (void)readString(); break;
+                default:
+                    while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']'
+                           && text[pos] != ' ' && text[pos] != '\n' && text[pos] != '\r' && text[pos] != '\t') ++pos;
+                    break;
+            }
+        }
+    };
+
+} // mos6502
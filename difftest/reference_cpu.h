@@ -0,0 +1,337 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.h"
+#include "memory.h"
+#include "opcodes.h"
+
+namespace mos6502 {
+
+    /*
+     * NMOS 6502 interpreter written to be obviously correct rather than fast, the core is checked against it.
+     *
+     * It shares nothing with CPU but the opcode table: flags live in a plain status byte, every addressing
+     * mode resolves to an effective address with the hardware's wraparound rules, and every bus cycle of the
+     * last instruction is logged, dummy reads and writes included.
+     */
+    class ReferenceCPU {
+    public:
+        static constexpr byte C = 0x01, Z = 0x02, I = 0x04, D = 0x08, B = 0x10, U = 0x20, V = 0x40, N = 0x80;
+
+        word pc = 0;
+        byte s = 0xFF;
+        byte a = 0;
+        byte x = 0;
+        byte y = 0;
+        byte p = U;
+        std::array<byte, 0x10000> ram{};
+
+        std::vector<BusCycle> bus;
+
+        // executes one instruction and returns its cycles, or 0 without executing anything for an illegal opcode
+        int step() {
+            bus.clear();
+
+            const Opcode& info = opcodes[ram[pc]];
+            if (info.mnemonic == Mnemonic::Illegal) return 0;
+            read(pc++);
+
+            using enum Mnemonic;
+            if (info.mnemonic == JSR) return jsr();
+
+            const bool writes = info.mnemonic == STA || info.mnemonic == STX || info.mnemonic == STY
+                             || info.mnemonic == ASL || info.mnemonic == LSR || info.mnemonic == ROL
+                             || info.mnemonic == ROR || info.mnemonic == INC || info.mnemonic == DEC;
+
+            int cycles = info.cycles;
+            bool pageCrossed = false;
+            word ea = 0;
+
+            switch (info.mode) {
+                case Mode::Implied:
+                case Mode::Accumulator:
+                    read(pc); // the byte after the opcode is read and ignored
+                    break;
+                case Mode::Immediate:
+                    ea = pc++;
+                    break;
+                case Mode::ZeroPage:
+                    ea = read(pc++);
+                    break;
+                case Mode::ZeroPageX: {
+                    const byte base = read(pc++);
+                    read(base);
+                    ea = static_cast<byte>(base + x);
+                    break;
+                }
+                case Mode::ZeroPageY: {
+                    const byte base = read(pc++);
+                    read(base);
+                    ea = static_cast<byte>(base + y);
+                    break;
+                }
+                case Mode::Absolute:
+                    ea = fetchWord();
+                    break;
+                case Mode::AbsoluteX:
+                    ea = indexed(fetchWord(), x, writes, pageCrossed);
+                    break;
+                case Mode::AbsoluteY:
+                    ea = indexed(fetchWord(), y, writes, pageCrossed);
+                    break;
+                case Mode::Indirect: {
+                    const word pointer = fetchWord();
+                    const byte low = read(pointer);
+                    ea = low | read((pointer & 0xFF00) | ((pointer + 1) & 0xFF)) << 8;
+                    break;
+                }
+                case Mode::IndirectX: {
+                    const byte base = read(pc++);
+                    read(base);
+                    const byte pointer = base + x;
+                    const byte low = read(pointer);
+                    ea = low | read(static_cast<byte>(pointer + 1)) << 8;
+                    break;
+                }
+                case Mode::IndirectY: {
+                    const byte pointer = read(pc++);
+                    const byte low = read(pointer);
+                    ea = indexed(low | read(static_cast<byte>(pointer + 1)) << 8, y, writes, pageCrossed);
+                    break;
+                }
+                case Mode::Relative: {
+                    const auto offset = static_cast<signed char>(read(pc++));
+                    ea = pc + offset;
+                    break;
+                }
+            }
+            if (pageCrossed) cycles += info.penalty;
+
+            const bool accumulator = info.mode == Mode::Accumulator;
+
+            switch (info.mnemonic) {
+                case ADC: adc(read(ea)); break;
+                case SBC: sbc(read(ea)); break;
+
+                case AND: setNZ(a &= read(ea)); break;
+                case EOR: setNZ(a ^= read(ea)); break;
+                case ORA: setNZ(a |= read(ea)); break;
+
+                case ASL: modify(accumulator, ea, [this](const byte v) { set(C, v & 0x80); return static_cast<byte>(v << 1); }); break;
+                case LSR: modify(accumulator, ea, [this](const byte v) { set(C, v & 0x01); return static_cast<byte>(v >> 1); }); break;
+                case ROL: modify(accumulator, ea, [this](const byte v) { const byte r = v << 1 | (p & C); set(C, v & 0x80); return r; }); break;
+                case ROR: modify(accumulator, ea, [this](const byte v) { const byte r = v >> 1 | (p & C) << 7; set(C, v & 0x01); return r; }); break;
+                case INC: modify(false, ea, [](const byte v) { return static_cast<byte>(v + 1); }); break;
+                case DEC: modify(false, ea, [](const byte v) { return static_cast<byte>(v - 1); }); break;
+
+                case BCC: cycles += branch(!(p & C), ea); break;
+                case BCS: cycles += branch(p & C, ea); break;
+                case BNE: cycles += branch(!(p & Z), ea); break;
+                case BEQ: cycles += branch(p & Z, ea); break;
+                case BPL: cycles += branch(!(p & N), ea); break;
+                case BMI: cycles += branch(p & N, ea); break;
+                case BVC: cycles += branch(!(p & V), ea); break;
+                case BVS: cycles += branch(p & V, ea); break;
+
+                case BIT: {
+                    const byte value = read(ea);
+                    set(Z, (a & value) == 0);
+                    set(V, value & 0x40);
+                    set(N, value & 0x80);
+                    break;
+                }
+
+                case BRK:
+                    ++pc; // skips the padding byte, already read as the byte after the opcode
+                    push(pc >> 8);
+                    push(pc & 0xFF);
+                    push(p | B | U);
+                    p |= I;
+                    pc = read(0xFFFE);
+                    pc |= read(0xFFFF) << 8;
+                    break;
+                case RTI:
+                    read(0x100 | s);
+                    p = (pull() & ~B) | U;
+                    pc = pull();
+                    pc |= pull() << 8;
+                    break;
+                case RTS:
+                    read(0x100 | s);
+                    pc = pull();
+                    pc |= pull() << 8;
+                    read(pc++);
+                    break;
+                case JMP: pc = ea; break;
+
+                case CLC: p &= ~C; break;
+                case CLD: p &= ~D; break;
+                case CLI: p &= ~I; break;
+                case CLV: p &= ~V; break;
+                case SEC: p |= C; break;
+                case SED: p |= D; break;
+                case SEI: p |= I; break;
+
+                case CMP: compare(a, read(ea)); break;
+                case CPX: compare(x, read(ea)); break;
+                case CPY: compare(y, read(ea)); break;
+
+                case DEX: setNZ(--x); break;
+                case DEY: setNZ(--y); break;
+                case INX: setNZ(++x); break;
+                case INY: setNZ(++y); break;
+
+                case LDA: setNZ(a = read(ea)); break;
+                case LDX: setNZ(x = read(ea)); break;
+                case LDY: setNZ(y = read(ea)); break;
+                case STA: write(ea, a); break;
+                case STX: write(ea, x); break;
+                case STY: write(ea, y); break;
+
+                case PHA: push(a); break;
+                case PHP: push(p | B | U); break;
+                case PLA: read(0x100 | s); setNZ(a = pull()); break;
+                case PLP: read(0x100 | s); p = (pull() & ~B) | U; break;
+
+                case TAX: setNZ(x = a); break;
+                case TAY: setNZ(y = a); break;
+                case TSX: setNZ(x = s); break;
+                case TXA: setNZ(a = x); break;
+                case TXS: s = x; break;
+                case TYA: setNZ(a = y); break;
+
+                case NOP:
+                case JSR:
+                case Illegal:
+                    break;
+            }
+            return cycles;
+        }
+
+    private:
+        byte read(const address addr) {
+            bus.push_back({addr, ram[addr], false});
+            return ram[addr];
+        }
+
+        void write(const address addr, const byte value) {
+            bus.push_back({addr, value, true});
+            ram[addr] = value;
+        }
+
+        word fetchWord() {
+            const byte low = read(pc++);
+            return low | read(pc++) << 8;
+        }
+
+        // base + index, reading the address without the carry into the high byte first when the hardware does
+        word indexed(const word base, const byte index, const bool writes, bool& pageCrossed) {
+            const word ea = base + index;
+            pageCrossed = (base ^ ea) & 0xFF00;
+            if (pageCrossed || writes) read((base & 0xFF00) | (ea & 0xFF));
+            return ea;
+        }
+
+        // the low byte of the routine is read before the return address is pushed, the high byte after
+        int jsr() {
+            const byte low = read(pc++);
+            read(0x100 | s);
+            push(pc >> 8);
+            push(pc & 0xFF);
+            pc = low | read(pc) << 8;
+            return opcodes[0x20].cycles;
+        }
+
+        void push(const byte value) {
+            write(0x100 | s--, value);
+        }
+
+        byte pull() {
+            return read(0x100 | ++s);
+        }
+
+        void set(const byte flag, const bool on) {
+            p = on ? p | flag : p & ~flag;
+        }
+
+        void setNZ(const byte value) {
+            set(Z, value == 0);
+            set(N, value & 0x80);
+        }
+
+        template <typename Operation>
+        void modify(const bool accumulator, const address ea, Operation operation) {
+            if (accumulator) {
+                setNZ(a = operation(a));
+            } else {
+                const byte old = read(ea);
+                write(ea, old);
+                const byte value = operation(old);
+                write(ea, value);
+                setNZ(value);
+            }
+        }
+
+        int branch(const bool taken, const word target) {
+            if (!taken) return 0;
+            read(pc);
+            const bool pageCrossed = (pc ^ target) & 0xFF00;
+            if (pageCrossed) read((pc & 0xFF00) | (target & 0xFF));
+            pc = target;
+            return 1 + pageCrossed;
+        }
+
+        void compare(const byte reg, const byte value) {
+            set(C, reg >= value);
+            setNZ(reg - value);
+        }
+
+        void adc(const byte value) {
+            const int carry = p & C;
+            const int sum = a + value + carry;
+            if (!(p & D)) {
+                set(C, sum > 0xFF);
+                set(V, ~(a ^ value) & (a ^ sum) & 0x80);
+                setNZ(a = sum);
+                return;
+            }
+
+            int low = (a & 0x0F) + (value & 0x0F) + carry;
+            int high = (a & 0xF0) + (value & 0xF0);
+            if (low > 9) {
+                low += 6;
+                high += 0x10;
+            }
+            set(Z, (sum & 0xFF) == 0);
+            set(N, high & 0x80);
+            set(V, ~(a ^ value) & (a ^ high) & 0x80);
+            if (high > 0x90) high += 0x60;
+            set(C, high > 0xFF);
+            a = (low & 0x0F) | (high & 0xF0);
+        }
+
+        void sbc(const byte value) {
+            const int borrow = !(p & C);
+            const int difference = a - value - borrow;
+            set(C, difference >= 0);
+            set(V, (a ^ value) & (a ^ difference) & 0x80);
+            setNZ(difference);
+            if (!(p & D)) {
+                a = difference;
+                return;
+            }
+
+            int low = (a & 0x0F) - (value & 0x0F) - borrow;
+            int high = (a & 0xF0) - (value & 0xF0);
+            if (low < 0) {
+                low -= 6;
+                high -= 0x10;
+            }
+            if (high < 0) high -= 0x60;
+            a = (low & 0x0F) | (high & 0xF0);
+        }
+    };
+
+} // mos6502
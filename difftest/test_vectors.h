@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "types.h"
+#include "memory.h"
+#include "json_reader.h"
+
+namespace mos6502 {
+
+    struct RamEntry {
+        address addr;
+        byte value;
+    };
+
+    // Machine state in the "SingleStepTests" per-opcode JSON format.
+    struct VectorState {
+        word pc = 0;
+        byte s = 0;
+        byte a = 0;
+        byte x = 0;
+        byte y = 0;
+        byte p = 0;
+        std::vector<RamEntry> ram;
+    };
+
+    struct TestVector {
+        std::string name;
+        VectorState initial;
+        VectorState final;
+        std::vector<BusCycle> cycles;
+    };
+
+namespace detail {
+
+    inline VectorState readState(JsonReader& json) {
+        VectorState state;
+        json.readObject([&](const std::string_view key) {
+            if (key == "ram") {
+                json.readArray([&] {
+                    RamEntry entry{};
+                    json.expect('[');
+                    entry.addr = json.readInteger();
+                    json.expect(',');
+                    entry.value = json.readInteger();
+                    json.expect(']');
+                    state.ram.push_back(entry);
+                });
+            }
+            else if (key == "pc") state.pc = json.readInteger();
+            else if (key == "s") state.s = json.readInteger();
+            else if (key == "a") state.a = json.readInteger();
+            else if (key == "x") state.x = json.readInteger();
+            else if (key == "y") state.y = json.readInteger();
+            else if (key == "p") state.p = json.readInteger();
+            else json.skipValue();
+        });
+        return state;
+    }
+
+    inline BusCycle readCycle(JsonReader& json) {
+        BusCycle cycle{};
+        json.expect('[');
+        cycle.addr = json.readInteger();
+        json.expect(',');
+        cycle.value = json.readInteger();
+        json.expect(',');
+        cycle.write = json.readString() == "write";
+        json.expect(']');
+        return cycle;
+    }
+
+} // detail
+
+    // parses a whole vector file: an array of {"name", "initial", "final", "cycles"} objects
+    inline std::vector<TestVector> readTestVectors(const std::string_view text) {
+        std::vector<TestVector> vectors;
+        JsonReader json(text);
+        json.readArray([&] {
+            auto& vector = vectors.emplace_back();
+            json.readObject([&](const std::string_view key) {
+                if (key == "name") vector.name = json.readString();
+                else if (key == "initial") vector.initial = detail::readState(json);
+                else if (key == "final") vector.final = detail::readState(json);
+                else if (key == "cycles") json.readArray([&] { vector.cycles.push_back(detail::readCycle(json)); });
+                else json.skipValue();
+            });
+        });
+        return vectors;
+    }
+
+    inline std::string toJson(const VectorState& state) {
+        std::string ram;
+        for (const auto& [addr, value] : state.ram) {
+            ram += fmt::format("{}[{}, {}]", ram.empty() ? "" : ", ", addr, value);
+        }
+        return fmt::format(R"({{"pc": {}, "s": {}, "a": {}, "x": {}, "y": {}, "p": {}, "ram": [{}]}})",
+            state.pc, state.s, state.a, state.x, state.y, state.p, ram);
+    }
+
+    inline std::string toJson(const TestVector& vector) {
+        std::string cycles;
+        for (const auto& [addr, value, write] : vector.cycles) {
+            cycles += fmt::format(R"({}[{}, {}, "{}"])", cycles.empty() ? "" : ", ", addr, value, write ? "write" : "read");
+        }
+        return fmt::format(R"({{"name": "{}", "initial": {}, "final": {}, "cycles": [{}]}})",
+            vector.name, toJson(vector.initial), toJson(vector.final), cycles);
+    }
+
+} // mos6502
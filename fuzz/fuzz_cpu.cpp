@@ -0,0 +1,90 @@
+// libFuzzer entry point for the 6502 core.
+//
+// By default every input is a program loaded and started at $0200. With MOS6502_FUZZ_ROM set, that ROM is
+// loaded once at MOS6502_FUZZ_LOAD and each input is copied to MOS6502_FUZZ_INPUT (default $0200) instead,
+// with execution starting at MOS6502_FUZZ_ENTRY (default: the load address). Addresses take any expression
+// the assembler accepts.
+//
+// One CPU is reused across iterations, only the pages the last run wrote to are restored before the next one.
+// Guest control-flow edges are exported to libFuzzer as extra counters.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cpu.h"
+#include "dirty_pages.h"
+#include "expression.h"
+
+namespace {
+
+    using namespace mos6502;
+
+    constexpr std::uint64_t cycleBudget = 100'000;
+
+    __attribute__((section("__libfuzzer_extra_counters")))
+    byte coverage[CPU::coverageSize];
+
+    struct Harness {
+        CPU cpu;
+        std::unique_ptr<DirtyPages> dirtyPages;
+        std::optional<address> input;
+        address entry = 0x0200;
+    };
+
+    Harness* harness;
+
+    address addressFromEnvironment(const char* name, const address fallback) {
+        const char* text = std::getenv(name);
+        if (!text) return fallback;
+        return evaluate(text, [](std::string_view) -> std::optional<std::int64_t> { return std::nullopt; }).value;
+    }
+
+    void loadRom(Harness& h, const char* path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error(std::string("cannot open ") + path);
+        std::vector<byte> rom{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+        const address load = addressFromEnvironment("MOS6502_FUZZ_LOAD", 0x0200);
+        if (load + rom.size() > 0x10000) throw std::runtime_error("ROM does not fit in memory");
+
+        h.entry = addressFromEnvironment("MOS6502_FUZZ_ENTRY", load);
+        h.input = addressFromEnvironment("MOS6502_FUZZ_INPUT", 0x0200);
+        h.cpu.getMemory().write(load, rom);
+    }
+
+} // namespace
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    harness = new Harness;
+    if (const char* rom = std::getenv("MOS6502_FUZZ_ROM")) loadRom(*harness, rom);
+
+    harness->dirtyPages = std::make_unique<DirtyPages>(harness->cpu.getMemory());
+    harness->cpu.setCoverage(coverage);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, const std::size_t size) {
+    auto& [cpu, dirtyPages, input, entry] = *harness;
+    dirtyPages->restore();
+
+    const address origin = input.value_or(entry);
+    const std::size_t length = std::min<std::size_t>(size, 0x10000 - origin);
+    cpu.load(Program(std::vector<byte>(data, data + length), entry, origin));
+
+    try {
+        cpu.run(cycleBudget);
+    } catch (const std::runtime_error&) {
+        // illegal opcodes end the run, they are not emulator bugs
+    }
+    return 0;
+}
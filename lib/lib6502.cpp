@@ -0,0 +1,138 @@
+#include "lib6502.h"
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "assembler.h"
+
+struct m6502 {
+    mos6502::CPU cpu;
+    std::string error; // what the last failing call threw
+
+    m6502(const mos6502::word pages, const std::size_t physicalSize) : cpu(pages, physicalSize) {}
+};
+
+namespace {
+
+    using namespace mos6502;
+
+    static_assert(M6502_STOP_BUDGET == static_cast<int>(StopReason::Budget));
+    static_assert(M6502_STOP_HALTED == static_cast<int>(StopReason::Halted));
+    static_assert(M6502_STOP_BREAKPOINT == static_cast<int>(StopReason::Breakpoint));
+    static_assert(M6502_STOP_WATCHPOINT == static_cast<int>(StopReason::Watchpoint));
+    static_assert(M6502_STOP_REQUESTED == static_cast<int>(StopReason::Requested));
+    static_assert(M6502_STOP_BLOCKED == static_cast<int>(StopReason::Blocked));
+
+    // runs `body`, turning what it throws into the handle's error and -1
+    template <typename Body>
+    int guarded(m6502* handle, Body body) {
+        try {
+            body();
+            handle->error.clear();
+            return 0;
+        } catch (const std::exception& e) {
+            handle->error = e.what();
+        } catch (...) {
+            handle->error = "unknown error";
+        }
+        return -1;
+    }
+
+    void load(m6502* handle, const Program& program) {
+        if (program.origin + program.code.size() > 0x10000) throw std::length_error("the code does not fit below $10000");
+        handle->cpu.load(program);
+    }
+
+} // namespace
+
+extern "C" {
+
+    uint32_t m6502_abi_version(void) {
+        return M6502_ABI_VERSION;
+    }
+
+    m6502* m6502_create(const uint16_t ram_pages, const size_t physical_size) {
+        // Memory would round these up, the caller is told instead
+        if (physical_size < 0x10000 || physical_size % 256) return nullptr;
+        try {
+            return new m6502(ram_pages, physical_size);
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    void m6502_destroy(m6502* cpu) {
+        delete cpu;
+    }
+
+    int m6502_load(m6502* cpu, const uint8_t* code, const size_t size, const uint16_t origin, const uint16_t entry) {
+        return guarded(cpu, [&] { load(cpu, Program(std::vector<byte>(code, code + size), entry, origin)); });
+    }
+
+    int m6502_load_source(m6502* cpu, const char* source) {
+        return guarded(cpu, [&] { load(cpu, assemble(source)); });
+    }
+
+    m6502_run_result m6502_run(m6502* cpu, const uint64_t budget) {
+        const auto start = cpu->cpu.getCycleCount();
+        RunResult result{};
+        if (guarded(cpu, [&] { result = cpu->cpu.run(budget); }) == 0) {
+            return {result.cycles, result.instructions, static_cast<uint32_t>(result.reason)};
+        }
+        // the instructions before the failing one are not counted
+        return {cpu->cpu.getCycleCount() - start, 0, M6502_STOP_ERROR};
+    }
+
+    m6502_run_result m6502_step(m6502* cpu) {
+        if (cpu->cpu.isHalted()) return {0, 0, M6502_STOP_HALTED};
+
+        const auto start = cpu->cpu.getCycleCount();
+        if (guarded(cpu, [&] { cpu->cpu.step(); }) != 0) return {cpu->cpu.getCycleCount() - start, 0, M6502_STOP_ERROR};
+        if (cpu->cpu.isHalted()) return {cpu->cpu.getCycleCount() - start, 0, M6502_STOP_HALTED};
+        return {cpu->cpu.getCycleCount() - start, 1, M6502_STOP_BUDGET};
+    }
+
+    void m6502_get_registers(const m6502* cpu, m6502_registers* registers) {
+        const auto [pc, sp, ac, x, y, sr] = cpu->cpu.getRegisters();
+        *registers = {pc, sp, ac, x, y, sr};
+    }
+
+    void m6502_set_registers(m6502* cpu, const m6502_registers* registers) {
+        cpu->cpu.setRegisters({registers->pc, registers->sp, registers->a, registers->x, registers->y, registers->sr});
+    }
+
+    uint64_t m6502_cycle_count(const m6502* cpu) {
+        return cpu->cpu.getCycleCount();
+    }
+
+    int m6502_halted(const m6502* cpu) {
+        return cpu->cpu.isHalted();
+    }
+
+    void m6502_set_halt_on_brk(m6502* cpu, const int halt) {
+        cpu->cpu.setHaltOnBrk(halt);
+    }
+
+    void m6502_set_irq(m6502* cpu, const uint32_t source, const int asserted) {
+        cpu->cpu.setIrq(source, asserted);
+    }
+
+    uint8_t* m6502_memory(m6502* cpu, size_t* size) {
+        Memory& memory = cpu->cpu.getMemory();
+        *size = memory.physicalSize();
+        return memory.physical();
+    }
+
+    uint8_t* m6502_page(m6502* cpu, const uint8_t page) {
+        Memory& memory = cpu->cpu.getMemory();
+        return memory.physical() + memory.physicalOffset(page);
+    }
+
+    const char* m6502_last_error(const m6502* cpu) {
+        return cpu->error.c_str();
+    }
+
+} // extern "C"
@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+ * lib6502: the emulator core as a shared library with a C interface, for hosts written in C or anything with a
+ * C FFI. Every type here is plain C with a fixed layout, the machine is an opaque handle, and no C++ exception
+ * leaves the library: failures come back as an error code and m6502_last_error() tells what went wrong.
+ *
+ * Guest memory is not copied in or out. m6502_memory() and m6502_page() return pointers into the store the CPU
+ * itself executes from, so the host reads results and patches code or data in place, between runs.
+ *
+ * The ABI only grows: functions are added, never changed, and M6502_ABI_VERSION goes up with each addition. A
+ * handle is used by one thread at a time.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#ifdef LIB6502_BUILD
+#define LIB6502_API __declspec(dllexport)
+#else
+#define LIB6502_API __declspec(dllimport)
+#endif
+#else
+#define LIB6502_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define M6502_ABI_VERSION 1
+
+typedef struct m6502 m6502;
+
+typedef struct m6502_registers {
+    uint16_t pc;
+    uint8_t sp;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t sr; /* bits 4 and 5 read as 0 and are ignored when set */
+} m6502_registers;
+
+/* why a run stopped, the values of mos6502::StopReason plus one for errors */
+enum {
+    M6502_STOP_BUDGET = 0,     /* ran out of cycles */
+    M6502_STOP_HALTED = 1,     /* reached a 0x00 opcode */
+    M6502_STOP_BREAKPOINT = 2, /* unused through this interface */
+    M6502_STOP_WATCHPOINT = 3, /* unused through this interface */
+    M6502_STOP_REQUESTED = 4,  /* unused through this interface */
+    M6502_STOP_BLOCKED = 5,    /* unused through this interface */
+    M6502_STOP_ERROR = 6,      /* an illegal instruction, see m6502_last_error() */
+};
+
+typedef struct m6502_run_result {
+    uint64_t cycles;
+    uint64_t instructions;
+    uint32_t reason; /* one of M6502_STOP_* */
+} m6502_run_result;
+
+/* the M6502_ABI_VERSION the library was built with, at least the one a host was compiled against */
+LIB6502_API uint32_t m6502_abi_version(void);
+
+/* a machine reporting `ram_pages` pages of RAM over `physical_size` bytes of physical memory, identity mapped;
+   256 and 0x10000 give the usual 64 KiB machine. NULL if `ram_pages` is not 1 to 256, `physical_size` is below
+   0x10000 or not a multiple of 256, or memory runs out */
+LIB6502_API m6502* m6502_create(uint16_t ram_pages, size_t physical_size);
+LIB6502_API void m6502_destroy(m6502* cpu);
+
+/* resets the CPU and copies `size` bytes of code to `origin`, with pc at `entry` and the stack empty;
+   returns 0, or -1 if the code does not fit */
+LIB6502_API int m6502_load(m6502* cpu, const uint8_t* code, size_t size, uint16_t origin, uint16_t entry);
+
+/* the same with assembly source; returns 0, or -1 if it does not assemble */
+LIB6502_API int m6502_load_source(m6502* cpu, const char* source);
+
+/* runs until `budget` cycles have elapsed, the CPU halts or an instruction fails */
+LIB6502_API m6502_run_result m6502_run(m6502* cpu, uint64_t budget);
+
+/* executes a single instruction, the reason being M6502_STOP_BUDGET when it did */
+LIB6502_API m6502_run_result m6502_step(m6502* cpu);
+
+LIB6502_API void m6502_get_registers(const m6502* cpu, m6502_registers* registers);
+LIB6502_API void m6502_set_registers(m6502* cpu, const m6502_registers* registers);
+
+/* cycles executed since the last load */
+LIB6502_API uint64_t m6502_cycle_count(const m6502* cpu);
+LIB6502_API int m6502_halted(const m6502* cpu);
+
+/* by default opcode 0x00 halts the CPU, 0 makes it execute BRK like the hardware does */
+LIB6502_API void m6502_set_halt_on_brk(m6502* cpu, int halt);
+
+/* asserts or releases the IRQ line for the sources in the bits of `source` */
+LIB6502_API void m6502_set_irq(m6502* cpu, uint32_t source, int asserted);
+
+/* the physical store, `*size` bytes; byte N is address N while the default mapping stands. Valid until the
+   machine is destroyed. Writes take effect at once, past read-only pages, and must not happen during a run */
+LIB6502_API uint8_t* m6502_memory(m6502* cpu, size_t* size);
+
+/* the 256 bytes CPU page `page` currently shows, with the same validity */
+LIB6502_API uint8_t* m6502_page(m6502* cpu, uint8_t page);
+
+/* what the last failing call on `cpu` reported, "" if none has failed */
+LIB6502_API const char* m6502_last_error(const m6502* cpu);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,137 @@
+#include "access_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <vector>
+
+namespace mos6502 {
+
+namespace {
+
+    void putLittle(std::vector<byte>& out, const std::uint64_t value, const int size) {
+        for (int i = 0; i < size; ++i) out.push_back(static_cast<byte>(value >> 8 * i));
+    }
+
+    void putBig32(std::vector<byte>& out, const std::uint32_t value) {
+        for (int i = 3; i >= 0; --i) out.push_back(static_cast<byte>(value >> 8 * i));
+    }
+
+    std::uint32_t crc32(const byte* data, const std::size_t size) {
+        static const auto table = [] {
+            std::array<std::uint32_t, 256> table{};
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                std::uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320 ^ c >> 1 : c >> 1;
+                table[i] = c;
+            }
+            return table;
+        }();
+
+        std::uint32_t crc = 0xFFFFFFFF;
+        for (std::size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+        return crc ^ 0xFFFFFFFF;
+    }
+
+    void putChunk(std::vector<byte>& png, const std::string_view type, const std::vector<byte>& data) {
+        putBig32(png, static_cast<std::uint32_t>(data.size()));
+        const auto start = png.size();
+        png.insert(png.end(), type.begin(), type.end());
+        png.insert(png.end(), data.begin(), data.end());
+        putBig32(png, crc32(png.data() + start, png.size() - start));
+    }
+
+    // a zlib stream of stored deflate blocks, the image is small enough not to need compressing
+    std::vector<byte> storeZlib(const std::vector<byte>& raw) {
+        std::vector<byte> out{0x78, 0x01};
+        for (std::size_t offset = 0; offset < raw.size();) {
+            const auto length = std::min<std::size_t>(raw.size() - offset, 0xFFFF);
+            out.push_back(offset + length == raw.size()); // the final block flag
+            putLittle(out, length, 2);
+            putLittle(out, ~length & 0xFFFF, 2);
+            out.insert(out.end(), raw.begin() + offset, raw.begin() + offset + length);
+            offset += length;
+        }
+
+        std::uint32_t a = 1, b = 0;
+        for (const byte value : raw) {
+            a = (a + value) % 65521;
+            b = (b + a) % 65521;
+        }
+        putBig32(out, b << 16 | a);
+        return out;
+    }
+
+} // namespace
+
+    AccessStats::Totals AccessStats::page(const byte page) const {
+        Totals totals{};
+        for (int i = page << 8; i < (page + 1) << 8; ++i) {
+            totals.reads += reads[i];
+            totals.writes += writes[i];
+            totals.executes += executes[i];
+        }
+        return totals;
+    }
+
+    void AccessStats::writeBinary(std::FILE* out) const {
+        std::vector<byte> data;
+        std::uint32_t records = 0;
+        for (int i = 0; i < 0x10000; ++i) records += reads[i] || writes[i] || executes[i];
+
+        constexpr std::string_view magic("6502ACC\0", 8);
+        data.insert(data.end(), magic.begin(), magic.end());
+        putLittle(data, 1, 4);
+        putLittle(data, records, 4);
+
+        for (int p = 0; p < 256; ++p) {
+            const auto totals = page(static_cast<byte>(p));
+            putLittle(data, totals.reads, 8);
+            putLittle(data, totals.writes, 8);
+            putLittle(data, totals.executes, 8);
+        }
+        for (int i = 0; i < 0x10000; ++i) {
+            if (!reads[i] && !writes[i] && !executes[i]) continue;
+            putLittle(data, i, 2);
+            putLittle(data, reads[i], 8);
+            putLittle(data, writes[i], 8);
+            putLittle(data, executes[i], 8);
+        }
+        std::fwrite(data.data(), 1, data.size(), out);
+    }
+
+    void AccessStats::writePng(std::FILE* out) const {
+        const auto largest = std::max({
+            *std::ranges::max_element(reads), *std::ranges::max_element(writes), *std::ranges::max_element(executes),
+        });
+        const double scale = largest ? 255 / std::log1p(static_cast<double>(largest)) : 0;
+        const auto level = [scale](const std::uint64_t count) {
+            return static_cast<byte>(std::lround(std::log1p(static_cast<double>(count)) * scale));
+        };
+
+        // each row starts with filter type 0, none
+        std::vector<byte> raw;
+        raw.reserve(256 * (1 + 256 * 3));
+        for (int row = 0; row < 256; ++row) {
+            raw.push_back(0);
+            for (int column = 0; column < 256; ++column) {
+                const auto i = row << 8 | column;
+                raw.push_back(level(writes[i]));
+                raw.push_back(level(executes[i]));
+                raw.push_back(level(reads[i]));
+            }
+        }
+
+        std::vector<byte> header;
+        putBig32(header, 256);
+        putBig32(header, 256);
+        header.insert(header.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, deflate, the standard filters, not interlaced
+
+        std::vector<byte> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        putChunk(png, "IHDR", header);
+        putChunk(png, "IDAT", storeZlib(raw));
+        putChunk(png, "IEND", {});
+        std::fwrite(png.data(), 1, png.size(), out);
+    }
+
+} // mos6502
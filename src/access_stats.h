@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+
+#include "types.h"
+
+namespace mos6502 {
+
+    /*
+     * Read, write and execute counts per address, kept by Memory while attached with setAccessStats().
+     *
+     * Opcode fetches count as executions rather than reads; operand fetches, data and stack accesses count as
+     * reads and writes. Counters go through read() and write() only, so peek() and poke() are not counted. At
+     * 1.5 MiB this is only allocated when asked for, away from Memory itself.
+     */
+    struct alignas(64) AccessStats {
+        struct Totals {
+            std::uint64_t reads;
+            std::uint64_t writes;
+            std::uint64_t executes;
+        };
+
+        std::array<std::uint64_t, 0x10000> reads{};
+        std::array<std::uint64_t, 0x10000> writes{};
+        std::array<std::uint64_t, 0x10000> executes{};
+
+        [[nodiscard]] Totals page(byte page) const;
+
+        /*
+         * Little endian:
+         *
+         *   "6502ACC\0", u32 version (1), u32 address record count
+         *   256 page records:        u64 reads, u64 writes, u64 executes
+         *   address records:         u16 address, u64 reads, u64 writes, u64 executes
+         *
+         * with address records only for addresses accessed at least once, in address order.
+         */
+        void writeBinary(std::FILE* out) const;
+
+        // 256x256 RGB PNG, one row per page and one pixel per address: writes in red, executions in green and
+        // reads in blue, on a log scale up to the largest count
+        void writePng(std::FILE* out) const;
+    };
+
+} // mos6502
@@ -0,0 +1,148 @@
+#include "acia6551.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace mos6502 {
+
+namespace {
+
+    // control register bits 3-0, 0 is the 16x external clock, taken to be the usual 1.8432 MHz crystal
+    constexpr double baudRates[16] = {
+        115200, 50, 75, 109.92, 134.58, 150, 300, 600, 1200, 1800, 2400, 3600, 4800, 7200, 9600, 19200,
+    };
+
+} // namespace
+
+    Acia6551::Acia6551(CPU& cpu, const address base, HostSerial* serial, const std::uint64_t clockHz, const std::uint32_t irqSource)
+        : cpu(cpu), memory(cpu.getMemory()), base(base), serial(serial), clockHz(clockHz), irqSource(irqSource) {
+        if ((base & 0xFF) > 0xFC) throw std::runtime_error("ACIA registers must not cross a page boundary");
+        previousRead = memory.mapRead(base >> 8, this);
+        previousWrite = memory.mapWrite(base >> 8, this);
+        if (serial) cpu.schedule(this, cpu.getCycleCount() + characterCycles());
+    }
+
+    Acia6551::~Acia6551() {
+        if (memory.readHandler(base >> 8) == this) memory.mapRead(base >> 8, previousRead);
+        if (memory.writeHandler(base >> 8) == this) memory.mapWrite(base >> 8, previousWrite);
+        cpu.cancel(this);
+        cpu.setIrq(irqSource, false);
+    }
+
+    byte Acia6551::read(const address addr) {
+        if (!inRange(addr)) return previousRead ? previousRead->read(addr) : memory.peek(addr);
+
+        switch (static_cast<Register>(addr - base)) {
+            case Data:
+                receiveFull = false;
+                idlePolls = 0;
+                updateIrq();
+                return received;
+            case Status: {
+                const bool idle = serial && !receiveFull && !pending && !serial->inputPending() && !serial->inputClosed();
+                if (!idle) {
+                    idlePolls = 0;
+                } else if (blockAfter && ++idlePolls >= blockAfter) {
+                    // the guest is waiting for input that only the host can bring
+                    idlePolls = 0;
+                    serial->flush();
+                    cpu.requestStop(StopReason::Blocked);
+                }
+                return status();
+            }
+            case Command: return command;
+            case Control: return control;
+        }
+        return 0;
+    }
+
+    void Acia6551::write(const address addr, const byte value) {
+        if (!inRange(addr)) {
+            if (previousWrite) previousWrite->write(addr, value);
+            else memory.poke(addr, value);
+            return;
+        }
+
+        switch (static_cast<Register>(addr - base)) {
+            case Data: transmit(value); break;
+            case Status:
+                // programmed reset
+                command &= 0xE0;
+                updateIrq();
+                break;
+            case Command:
+                command = value;
+                updateIrq();
+                break;
+            case Control:
+                control = value;
+                if (serial) cpu.schedule(this, cpu.getCycleCount() + characterCycles());
+                break;
+        }
+    }
+
+    // once per character time: retries held output, lets the host side send a quiet batch and receives
+    void Acia6551::expire(const std::uint64_t now) {
+        if (pending && serial->write(*pending)) pending.reset();
+        serial->poll();
+        if (!receiveFull) {
+            if (const auto value = serial->read()) {
+                received = *value;
+                receiveFull = true;
+            }
+        }
+        updateIrq();
+        cpu.schedule(this, now + characterCycles());
+    }
+
+    void Acia6551::transmit(const byte value) {
+        idlePolls = 0;
+        if (!serial) return;
+        // like the chip, writing while the transmitter is busy replaces the byte waiting
+        if (pending || !serial->write(value)) pending = value;
+        updateIrq();
+    }
+
+    bool Acia6551::interrupting() const {
+        if (!(command & 0x01)) return false;
+        const bool receiver = !(command & 0x02) && receiveFull;
+        const bool transmitter = (command & 0x0C) == 0x04 && !pending;
+        return receiver || transmitter;
+    }
+
+    byte Acia6551::status() const {
+        return (receiveFull ? ReceiveFull : 0) | (pending ? 0 : TransmitEmpty) | (interrupting() ? Irq : 0);
+    }
+
+    std::uint64_t Acia6551::characterCycles() const {
+        // a start bit, 8 data bits and a stop bit
+        return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(clockHz * 10 / baudRates[control & 0x0F]));
+    }
+
+    std::vector<byte> Acia6551::saveState() const {
+        StateWriter out;
+        out.put(command).put(control).put(received).put<byte>(receiveFull);
+        out.put<byte>(pending.has_value()).put(pending.value_or(0));
+        return std::move(out).bytes();
+    }
+
+    void Acia6551::restoreState(const std::span<const byte> state) {
+        StateReader in(state);
+        command = in.get<byte>();
+        control = in.get<byte>();
+        received = in.get<byte>();
+        receiveFull = in.get<byte>();
+        const bool held = in.get<byte>();
+        const auto value = in.get<byte>();
+        pending = held ? std::optional(value) : std::nullopt;
+        if (!in.done()) throw std::runtime_error("ACIA state has the wrong size");
+
+        updateIrq();
+        if (serial) cpu.schedule(this, cpu.getCycleCount() + characterCycles());
+    }
+
+    void Acia6551::updateIrq() {
+        cpu.setIrq(irqSource, interrupting());
+    }
+
+} // mos6502
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "types.h"
+#include "cpu.h"
+#include "host_serial.h"
+#include "memory.h"
+#include "save_state.h"
+
+namespace mos6502 {
+
+    /*
+     * MOS 6551 Asynchronous Communications Interface Adapter, connected to a HostSerial.
+     *
+     * Input is taken from the host one character time apart, at the baud rate in the control register and the
+     * given CPU clock, by a CPU::schedule() event rather than per instruction. Output goes to the host as soon
+     * as it is written; TDRE only drops while the host side is full. The receiver interrupts when command bit 1
+     * is clear, the transmitter when command bits 3-2 are 01, both only with DTR (command bit 0) set.
+     *
+     * Without a HostSerial the ACIA receives nothing and its output is dropped. Parity, framing errors, overrun
+     * and the modem lines are not modelled: the host side buffers input instead of overrunning.
+     */
+    class Acia6551 final : public PageHandler, public TimedDevice, public StatefulDevice {
+    public:
+        enum Register : byte {
+            Data, Status, Command, Control,
+        };
+
+        enum StatusBit : byte {
+            ReceiveFull = 0x08,
+            TransmitEmpty = 0x10,
+            Irq = 0x80,
+        };
+
+        // maps the 4 registers at `base`, the rest of its page keeps working as before
+        Acia6551(CPU& cpu, address base, HostSerial* serial, std::uint64_t clockHz = 1'000'000, std::uint32_t irqSource = 0x02);
+        ~Acia6551() override;
+
+        Acia6551(const Acia6551&) = delete;
+        Acia6551& operator=(const Acia6551&) = delete;
+
+        // makes run() stop with StopReason::Blocked once the guest has read the status this many times in a row
+        // with nothing received and nothing waiting on the host, so a scheduler can park it until input arrives;
+        // 0, the default, never blocks
+        void setBlockWhenIdle(unsigned polls) { blockAfter = polls; }
+
+        byte read(address addr) override;
+        void write(address addr, byte value) override;
+        void expire(std::uint64_t now) override;
+
+        // the registers and the byte held for the host; the host side's own buffers are not part of it
+        [[nodiscard]] const char* stateName() const override { return "acia"; }
+        [[nodiscard]] std::vector<byte> saveState() const override;
+        void restoreState(std::span<const byte> state) override;
+
+    private:
+        CPU& cpu;
+        Memory& memory;
+        address base;
+        HostSerial* serial;
+        std::uint64_t clockHz;
+        std::uint32_t irqSource;
+        PageHandler* previousRead{};
+        PageHandler* previousWrite{};
+
+        byte command{};
+        byte control{};
+        byte received{};
+        bool receiveFull{};
+        std::optional<byte> pending; // written while the host side was full
+
+        unsigned blockAfter = 0;
+        unsigned idlePolls = 0;
+
+        [[nodiscard]] bool inRange(address addr) const { return static_cast<address>(addr - base) < 4; }
+        [[nodiscard]] bool interrupting() const;
+        [[nodiscard]] byte status() const;
+        [[nodiscard]] std::uint64_t characterCycles() const;
+
+        void transmit(byte value);
+        void updateIrq();
+    };
+
+} // mos6502
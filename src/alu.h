@@ -0,0 +1,133 @@
+#pragma once
+
+#include "types.h"
+
+namespace mos6502 {
+
+    // The status register, laid out like the byte PHP pushes (bits 4 and 5 aside).
+    struct StatusFlags {
+        bool c : 1{};
+        bool z : 1{};
+        bool i : 1{};
+        bool d : 1{};
+        bool b : 1{};
+        bool : 1;
+        bool v : 1{};
+        bool n : 1{};
+    };
+
+    [[nodiscard]] constexpr byte pack(const StatusFlags sr) {
+        return sr.c | sr.z << 1 | sr.i << 2 | sr.d << 3 | sr.b << 4 | sr.v << 6 | sr.n << 7;
+    }
+
+    [[nodiscard]] constexpr StatusFlags unpack(const byte value) {
+        StatusFlags sr;
+        sr.c = value & 0x01;
+        sr.z = value & 0x02;
+        sr.i = value & 0x04;
+        sr.d = value & 0x08;
+        sr.b = value & 0x10;
+        sr.v = value & 0x40;
+        sr.n = value & 0x80;
+        return sr;
+    }
+
+    /*
+     * The ALU operations, shared by CPU and StaticCPU so the two cannot disagree on them. Each takes the
+     * operands, updates the flags it affects and returns the result.
+     */
+    namespace alu {
+
+        constexpr void setNZ(StatusFlags& sr, const byte value) {
+            sr.z = value == 0;
+            sr.n = value & 0x80;
+        }
+
+        [[nodiscard]] constexpr byte adc(StatusFlags& sr, const byte ac, const byte value) {
+            const int result = ac + value + sr.c;
+            if (sr.d) [[unlikely]] {
+                // NMOS decimal mode: Z comes from the binary sum, N and V from the sum before the high digit is adjusted
+                int low = (ac & 0x0F) + (value & 0x0F) + sr.c;
+                int high = (ac & 0xF0) + (value & 0xF0);
+                if (low > 0x09) {
+                    low += 0x06;
+                    high += 0x10;
+                }
+                sr.z = (result & 0xFF) == 0;
+                sr.n = high & 0x80;
+                sr.v = (~(ac ^ value) & (ac ^ high) & 0x80) != 0;
+                if (high > 0x90) high += 0x60;
+                sr.c = high > 0xFF;
+                return (low & 0x0F) | (high & 0xF0);
+            }
+            sr.c = result > 0xFF;
+            sr.v = (~(ac ^ value) & (ac ^ result) & 0x80) != 0;
+            setNZ(sr, static_cast<byte>(result));
+            return static_cast<byte>(result);
+        }
+
+        [[nodiscard]] constexpr byte sbc(StatusFlags& sr, const byte ac, const byte value) {
+            const int borrow = !sr.c;
+            const int result = ac - value - borrow;
+            sr.c = result >= 0; // carry is the inverted borrow
+            sr.v = ((ac ^ result) & (ac ^ value) & 0x80) != 0;
+            setNZ(sr, static_cast<byte>(result));
+
+            if (sr.d) [[unlikely]] {
+                // NMOS decimal mode: the flags above still come from the binary difference
+                int low = (ac & 0x0F) - (value & 0x0F) - borrow;
+                int high = (ac & 0xF0) - (value & 0xF0);
+                if (low & 0x10) {
+                    low -= 0x06;
+                    --high;
+                }
+                if (high & 0x100) high -= 0x60;
+                return (low & 0x0F) | (high & 0xF0);
+            }
+            return static_cast<byte>(result);
+        }
+
+        // CMP, CPX and CPY
+        constexpr void compare(StatusFlags& sr, const byte reg, const byte value) {
+            sr.c = reg >= value;
+            setNZ(sr, static_cast<byte>(reg - value));
+        }
+
+        [[nodiscard]] constexpr byte asl(StatusFlags& sr, const byte value) {
+            sr.c = value & 0x80;
+            const byte result = value << 1;
+            setNZ(sr, result);
+            return result;
+        }
+
+        [[nodiscard]] constexpr byte lsr(StatusFlags& sr, const byte value) {
+            sr.c = value & 0x01;
+            const byte result = value >> 1;
+            setNZ(sr, result);
+            return result;
+        }
+
+        [[nodiscard]] constexpr byte rol(StatusFlags& sr, const byte value) {
+            const byte result = value << 1 | sr.c;
+            sr.c = value & 0x80;
+            setNZ(sr, result);
+            return result;
+        }
+
+        [[nodiscard]] constexpr byte ror(StatusFlags& sr, const byte value) {
+            const byte result = value >> 1 | sr.c << 7;
+            sr.c = value & 0x01;
+            setNZ(sr, result);
+            return result;
+        }
+
+        // BIT: Z from the AND, N and V straight from bits 7 and 6 of the operand
+        constexpr void bit(StatusFlags& sr, const byte ac, const byte value) {
+            sr.z = (ac & value) == 0;
+            sr.v = value & 0x40;
+            sr.n = value & 0x80;
+        }
+
+    } // alu
+
+} // mos6502
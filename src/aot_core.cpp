@@ -0,0 +1,111 @@
+#include "aot_core.h"
+
+#include <algorithm>
+#include <ranges>
+
+namespace mos6502 {
+
+    AotCore::AotCore(CPU& cpu, const std::span<const Block> blocks)
+        : cpu(cpu), memory(cpu.getMemory()), blocks(blocks), entries(0x10000), compiled(0x10000) {
+        for (const auto& block : blocks) {
+            const bool matches = std::ranges::all_of(std::views::iota(std::size_t{0}, block.code.size()), [&](const std::size_t i) {
+                return memory.peek(static_cast<address>(block.start + i)) == block.code[i];
+            });
+            if (!matches) continue;
+
+            entries[block.start] = &block;
+            for (std::size_t i = 0; i < block.code.size(); ++i) compiled[static_cast<address>(block.start + i)] = true;
+        }
+
+        for (int page = 0; page < 256; ++page) {
+            const bool hasCode = std::ranges::any_of(std::views::iota(page << 8, (page + 1) << 8), [this](const int addr) {
+                return compiled[addr];
+            });
+            if (!hasCode || memory.isReadOnly(page)) continue;
+
+            previousWrite[page] = memory.mapWrite(page, this);
+            hooked[page] = true;
+        }
+    }
+
+    AotCore::~AotCore() {
+        for (int page = 0; page < 256; ++page) {
+            if (hooked[page] && memory.writeHandler(page) == this) memory.mapWrite(page, previousWrite[page]);
+        }
+    }
+
+    std::size_t AotCore::blockCount() const {
+        return std::ranges::count_if(entries, [](const Block* block) { return block != nullptr; });
+    }
+
+    // the run loop's body, as in CPU::runLoop()
+    bool AotCore::interpret() {
+        cpu.opcode = cpu.fetchOpcode();
+
+        if (cpu.opcode == 0x00 && cpu.haltOnBrk) [[unlikely]] {
+            cpu.halted = true;
+            cpu.stopReason = StopReason::Halted;
+            return false;
+        }
+
+        cpu.cycleCount += cpu.execute(CPU::decode(cpu.opcode));
+        return true;
+    }
+
+    RunResult AotCore::run(const std::uint64_t budget) {
+        if (cpu.halted) return {StopReason::Halted, 0, 0};
+        if (cpu.breakpoints) return cpu.run(budget);
+
+        const auto start = cpu.cycleCount;
+        std::uint64_t instructions = 0;
+
+        cpu.stopReason = StopReason::Budget;
+        cpu.runEnd = budget > CPU::never - start ? CPU::never : start + budget;
+
+        while (true) {
+            cpu.deadline = std::min(cpu.runEnd, cpu.eventDeadline());
+
+            while (cpu.cycleCount < cpu.deadline) {
+                // a block runs whole, so only when its last instruction still starts before the deadline
+                const Block* block = entries[cpu.pc];
+                if (block && cpu.deadline - cpu.cycleCount >= static_cast<std::uint64_t>(block->maxCycles)) [[likely]] {
+                    instructions += block->run(cpu);
+                } else if (interpret()) {
+                    ++instructions;
+                } else {
+                    break;
+                }
+            }
+
+            if (cpu.stopReason != StopReason::Budget || cpu.cycleCount >= cpu.runEnd) break;
+            cpu.serviceEvents();
+            if (cpu.stopReason != StopReason::Budget) break; // a device asked to stop
+        }
+
+        return {cpu.stopReason, cpu.cycleCount - start, instructions};
+    }
+
+    byte AotCore::read(const address addr) {
+        return memory.peek(addr);
+    }
+
+    void AotCore::write(const address addr, const byte value) {
+        if (compiled[addr] && memory.peek(addr) != value) invalidate(addr);
+
+        if (PageHandler* previous = previousWrite[addr >> 8]) previous->write(addr, value);
+        else memory.poke(addr, value);
+    }
+
+    // drops the blocks compiled from the byte at `addr`, which is about to change, and makes a running block
+    // leave after the write, as the rest of it may be compiled from that byte
+    void AotCore::invalidate(const address addr) {
+        for (const auto& block : blocks) {
+            if (entries[block.start] == &block && static_cast<address>(addr - block.start) < block.code.size()) {
+                entries[block.start] = nullptr;
+            }
+        }
+        compiled[addr] = false;
+        cpu.deadline = std::min(cpu.deadline, cpu.cycleCount);
+    }
+
+} // mos6502
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "types.h"
+#include "cpu.h"
+#include "memory.h"
+
+namespace mos6502 {
+
+    /*
+     * Runs a CPU on code recompiled ahead of time by 6502_recompile, one basic block per call instead of one
+     * instruction per dispatch, falling back to the interpreter wherever there is no block for the PC: code the
+     * recompiler could not see (targets of JMP ($nnnn), returns to pushed addresses it did not find a JSR for,
+     * anything outside the ROM), BRK, RTI and illegal opcodes.
+     *
+     * A block is only used when its bytes in memory, as mapped when the core is created, are the ones it was
+     * compiled from. Pages holding compiled code are hooked for writes, and a write that changes a compiled byte
+     * drops every block containing it, so self-modifying code is interpreted from then on. Such a write also
+     * moves the deadline, so a block that rewrites its own later instructions leaves right after the store and
+     * the interpreter runs the new ones. Read-only pages are not hooked, nothing can change them.
+     *
+     * Blocks keep the interpreter's timing: one only starts when it ends before the run loop's deadline, the
+     * cycle count is brought up to date before every access that is not to the zero page or the stack, so
+     * devices read it as they would from the interpreter, and a block leaves early when such an access moved
+     * the deadline (a device event, an IRQ or requestStop()).
+     */
+    class AotCore final : public PageHandler {
+    public:
+        struct Block {
+            address start;
+            std::span<const byte> code; // the bytes the block was compiled from
+            cycles maxCycles;          // with every page crossing and taken branch
+            unsigned (*run)(CPU&);     // returns the instructions executed
+        };
+
+        // the blocks linked into this build, defined by the output of 6502_recompile
+        [[nodiscard]] static std::span<const Block> recompiled();
+
+        // uses the blocks whose code is in memory now, so it is created after the ROM is loaded
+        AotCore(CPU& cpu, std::span<const Block> blocks);
+        ~AotCore() override;
+
+        AotCore(const AotCore&) = delete;
+        AotCore& operator=(const AotCore&) = delete;
+
+        // blocks that still match memory
+        [[nodiscard]] std::size_t blockCount() const;
+
+        // a single instruction on the interpreter, for tracing and profiling
+        cycles step() { return cpu.step(); }
+
+        // same contract as CPU::run(budget); with breakpoints set it is CPU::run(budget), which checks them
+        // before every instruction
+        RunResult run(std::uint64_t budget);
+
+        byte read(address addr) override;
+        void write(address addr, byte value) override;
+
+    private:
+        CPU& cpu;
+        Memory& memory;
+        std::span<const Block> blocks;
+        std::vector<const Block*> entries;   // the block starting at each address, if any
+        std::vector<bool> compiled;          // bytes some usable block was compiled from
+        std::array<bool, 256> hooked{};
+        std::array<PageHandler*, 256> previousWrite{};
+
+        bool interpret();
+        void invalidate(address addr);
+
+        // one specialisation per block, generated by 6502_recompile
+        template <address Start>
+        static unsigned block(CPU& c);
+    };
+
+} // mos6502
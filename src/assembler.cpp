@@ -0,0 +1,16 @@
+#include "assembler.h"
+
+#include <string>
+
+namespace mos6502 {
+
+    void assemblyError(const std::size_t line, const std::string_view message) {
+        throw AssemblyError("line " + std::to_string(line) + ": " + std::string(message));
+    }
+
+    Program assemble(const std::string_view source) {
+        auto [origin, entryPoint, code] = Assembler(source).assemble();
+        return Program(std::move(code), entryPoint, origin);
+    }
+
+} // mos6502
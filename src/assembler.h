@@ -0,0 +1,410 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "types.h"
+#include "opcodes.h"
+#include "expression.h"
+#include "program.h"
+
+namespace mos6502 {
+
+    struct Assembly {
+        address origin = 0;
+        address entryPoint = 0;
+        std::vector<byte> code;
+    };
+
+    struct AssemblyError : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    [[noreturn]] void assemblyError(std::size_t line, std::string_view message);
+
+    /*
+     * Two-pass assembler for the official 6502 instruction set.
+     *
+     *           .org $0200          ; load address, later .org pads forward with zeros
+     *           .entry start        ; entry point, defaults to the first .org
+     *   count = 10                  ; constant
+     *   start:  LDX #0
+     *   loop:   STA buffer,X        ; zero page is chosen automatically when the address is known to fit
+     *           INX
+     *           CPX #count
+     *           BNE loop
+     *           BRK
+     *   buffer: .byte 1, 2, "text"
+     *           .word start, *+2
+     *
+     * Everything is constexpr, so sources can be assembled at compile time through assemble<"...">().
+     */
+    class Assembler {
+        struct Symbol {
+            std::string_view name;
+            std::int64_t value;
+        };
+
+        std::string_view source;
+        std::vector<Symbol> symbols;
+        std::vector<Mode> modes; // addressing mode picked for each instruction by the first pass
+
+        int pass = 0;
+        std::size_t line = 0;
+        std::size_t instruction = 0;
+        std::int64_t pc = 0;
+        std::int64_t location = 0; // value of `*`, the address the current line starts at
+        bool placed = false; // whether anything has been emitted since the first .org
+        bool hasEntry = false;
+        Assembly result;
+
+        [[nodiscard]] static constexpr std::string_view trim(std::string_view text) {
+            while (!text.empty() && (text.front() == ' ' || text.front() == '\t' || text.front() == '\r')) text.remove_prefix(1);
+            while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+            return text;
+        }
+
+        [[nodiscard]] static constexpr char upper(const char c) {
+            return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+        }
+
+        [[nodiscard]] static constexpr bool equalsIgnoreCase(const std::string_view a, const std::string_view b) {
+            return std::ranges::equal(a, b, [](const char l, const char r) { return upper(l) == upper(r); });
+        }
+
+        // position of the first `c` outside of quotes and parentheses, npos if there is none
+        [[nodiscard]] static constexpr std::size_t findTopLevel(const std::string_view text, const char c, const bool last = false) {
+            std::size_t found = std::string_view::npos;
+            int depth = 0;
+            char quote = 0;
+            for (std::size_t i = 0; i < text.size(); ++i) {
+                const char ch = text[i];
+                if (quote) {
+                    if (ch == quote) quote = 0;
+                } else if (ch == '"' || (ch == '\'' && i + 2 < text.size() && text[i + 2] == '\'')) {
+                    quote = ch;
+                } else if (ch == '(') {
+                    ++depth;
+                } else if (ch == ')') {
+                    --depth;
+                } else if (ch == c && depth == 0) {
+                    if (!last) return i;
+                    found = i;
+                }
+            }
+            return found;
+        }
+
+        // whether the whole text is one parenthesized group, as in "(ptr)" but not "(a)+(b)"
+        [[nodiscard]] static constexpr bool isParenthesized(const std::string_view text) {
+            if (text.size() < 2 || text.front() != '(' || text.back() != ')') return false;
+            int depth = 0;
+            for (std::size_t i = 0; i < text.size(); ++i) {
+                if (text[i] == '(') ++depth;
+                else if (text[i] == ')' && --depth == 0) return i == text.size() - 1;
+            }
+            return false;
+        }
+
+        [[nodiscard]] static constexpr std::string_view stripComment(const std::string_view text) {
+            return text.substr(0, findTopLevel(text, ';'));
+        }
+
+        [[nodiscard]] constexpr std::optional<std::int64_t> lookup(const std::string_view name) const {
+            for (const auto& symbol : symbols) {
+                if (symbol.name == name) return symbol.value;
+            }
+            return std::nullopt;
+        }
+
+        constexpr void define(const std::string_view name, const std::int64_t value) {
+            for (auto& symbol : symbols) {
+                if (symbol.name == name) {
+                    if (pass == 1) assemblyError(line, "duplicate symbol");
+                    symbol.value = value;
+                    return;
+                }
+            }
+            symbols.push_back({name, value});
+        }
+
+        constexpr Value evaluate(const std::string_view text) const {
+            auto resolve = [this](const std::string_view name) { return lookup(name); };
+            const auto value = mos6502::evaluate(trim(text), resolve, location);
+            if (pass == 2 && !value.known) assemblyError(line, "undefined symbol");
+            return value;
+        }
+
+        constexpr void emit(const byte value) {
+            if (pass == 2) result.code.push_back(value);
+            ++pc;
+            placed = true;
+        }
+
+        constexpr void emitByte(const std::int64_t value) {
+            if (pass == 2 && (value < -128 || value > 0xFF)) assemblyError(line, "value does not fit in a byte");
+            emit(static_cast<byte>(value));
+        }
+
+        constexpr void emitWord(const std::int64_t value) {
+            if (pass == 2 && (value < 0 || value > 0xFFFF)) assemblyError(line, "value does not fit in a word");
+            emit(static_cast<byte>(value & 0xFF));
+            emit(static_cast<byte>((value >> 8) & 0xFF));
+        }
+
+        // calls `f` with every comma separated item of `text`
+        template <typename F>
+        constexpr void forEachItem(std::string_view text, F&& f) {
+            while (true) {
+                const auto comma = findTopLevel(text, ',');
+                f(trim(text.substr(0, comma)));
+                if (comma == std::string_view::npos) break;
+                text.remove_prefix(comma + 1);
+            }
+        }
+
+        constexpr void directive(const std::string_view name, const std::string_view operand) {
+            if (equalsIgnoreCase(name, ".org")) {
+                const auto target = evaluate(operand);
+                if (!target.known) assemblyError(line, ".org needs a value known in the first pass");
+                if (target.value < 0 || target.value > 0xFFFF) assemblyError(line, "address out of range");
+                if (!placed) {
+                    pc = target.value;
+                    result.origin = static_cast<address>(target.value);
+                    if (!hasEntry) result.entryPoint = static_cast<address>(target.value);
+                    return;
+                }
+                if (target.value < pc) assemblyError(line, ".org cannot move backwards");
+                while (pc < target.value) emit(0);
+            } else if (equalsIgnoreCase(name, ".entry")) {
+                const auto entry = evaluate(operand);
+                if (pass == 2) {
+                    result.entryPoint = static_cast<address>(entry.value);
+                    hasEntry = true;
+                }
+            } else if (equalsIgnoreCase(name, ".byte")) {
+                forEachItem(operand, [this](const std::string_view item) {
+                    if (item.size() >= 2 && item.front() == '"' && item.back() == '"') {
+                        for (const char c : item.substr(1, item.size() - 2)) emit(static_cast<byte>(c));
+                    } else {
+                        emitByte(evaluate(item).value);
+                    }
+                });
+            } else if (equalsIgnoreCase(name, ".word")) {
+                forEachItem(operand, [this](const std::string_view item) {
+                    emitWord(evaluate(item).value);
+                });
+            } else {
+                assemblyError(line, "unknown directive");
+            }
+        }
+
+        [[nodiscard]] constexpr Mode selectMode(const Mnemonic mnemonic, const std::string_view operand) const {
+            const auto has = [mnemonic](const Mode mode) { return encode(mnemonic, mode) != -1; };
+            const auto fitsZeroPage = [this](const std::string_view text) {
+                const auto value = evaluate(text);
+                return value.known && value.value >= 0 && value.value <= 0xFF;
+            };
+
+            if (operand.empty()) return has(Mode::Implied) ? Mode::Implied : Mode::Accumulator;
+            if (equalsIgnoreCase(operand, "A")) return Mode::Accumulator;
+            if (operand.front() == '#') return Mode::Immediate;
+
+            if (isParenthesized(operand)) {
+                const auto inner = operand.substr(1, operand.size() - 2);
+                const auto comma = findTopLevel(inner, ',', true);
+                if (comma == std::string_view::npos) return Mode::Indirect;
+                if (equalsIgnoreCase(trim(inner.substr(comma + 1)), "X")) return Mode::IndirectX;
+                assemblyError(line, "only X can index an indirect address");
+            }
+
+            const auto comma = findTopLevel(operand, ',', true);
+            if (comma != std::string_view::npos) {
+                const auto base = trim(operand.substr(0, comma));
+                const auto index = trim(operand.substr(comma + 1));
+                if (equalsIgnoreCase(index, "Y") && isParenthesized(base)) return Mode::IndirectY;
+                if (equalsIgnoreCase(index, "X")) return has(Mode::ZeroPageX) && fitsZeroPage(base) ? Mode::ZeroPageX : Mode::AbsoluteX;
+                if (equalsIgnoreCase(index, "Y")) return has(Mode::ZeroPageY) && fitsZeroPage(base) ? Mode::ZeroPageY : Mode::AbsoluteY;
+                assemblyError(line, "unknown index register");
+            }
+
+            if (has(Mode::Relative)) return Mode::Relative;
+            return has(Mode::ZeroPage) && fitsZeroPage(operand) ? Mode::ZeroPage : Mode::Absolute;
+        }
+
+        // the address expression of an operand, without the addressing mode syntax around it
+        [[nodiscard]] static constexpr std::string_view operandExpression(const Mode mode, const std::string_view operand) {
+            switch (mode) {
+                case Mode::Immediate:
+                    return operand.substr(1);
+                case Mode::Indirect:
+                    return operand.substr(1, operand.size() - 2);
+                case Mode::IndirectX:
+                    return operand.substr(1, findTopLevel(operand.substr(1, operand.size() - 2), ',', true));
+                case Mode::IndirectY: {
+                    const auto base = trim(operand.substr(0, findTopLevel(operand, ',', true)));
+                    return base.substr(1, base.size() - 2);
+                }
+                case Mode::ZeroPageX:
+                case Mode::ZeroPageY:
+                case Mode::AbsoluteX:
+                case Mode::AbsoluteY:
+                    return operand.substr(0, findTopLevel(operand, ',', true));
+                default:
+                    return operand;
+            }
+        }
+
+        constexpr void assembleInstruction(const Mnemonic mnemonic, const std::string_view operand) {
+            Mode mode;
+            if (pass == 1) {
+                mode = selectMode(mnemonic, operand);
+                modes.push_back(mode);
+            } else {
+                mode = modes[instruction];
+            }
+            ++instruction;
+
+            const int opcode = encode(mnemonic, mode);
+            if (opcode == -1) assemblyError(line, "addressing mode not supported by this instruction");
+
+            const auto start = pc;
+            emit(static_cast<byte>(opcode));
+
+            if (length(mode) == 1) {
+                if (mode == Mode::Implied && !operand.empty()) assemblyError(line, "instruction takes no operand");
+                return;
+            }
+
+            const auto value = evaluate(operandExpression(mode, operand)).value;
+            if (mode == Mode::Relative) {
+                const auto offset = value - (start + 2);
+                if (pass == 2 && (offset < -128 || offset > 127)) assemblyError(line, "branch target out of range");
+                emit(static_cast<byte>(offset & 0xFF));
+            } else if (length(mode) == 2) {
+                emitByte(value);
+            } else {
+                emitWord(value);
+            }
+        }
+
+        [[nodiscard]] static constexpr std::optional<Mnemonic> findMnemonic(const std::string_view text) {
+            for (byte i = 0; i < static_cast<byte>(Mnemonic::Illegal); ++i) {
+                if (equalsIgnoreCase(text, name(static_cast<Mnemonic>(i)))) return static_cast<Mnemonic>(i);
+            }
+            return std::nullopt;
+        }
+
+        constexpr void assembleLine(std::string_view text) {
+            location = pc;
+            text = trim(stripComment(text));
+            if (text.empty()) return;
+
+            // label
+            std::size_t end = 0;
+            while (end < text.size() && isIdentifierChar(text[end])) ++end;
+            if (end > 0 && end < text.size() && text[end] == ':' && isIdentifierStart(text[0])) {
+                define(text.substr(0, end), pc);
+                text = trim(text.substr(end + 1));
+                if (text.empty()) return;
+                end = 0;
+                while (end < text.size() && isIdentifierChar(text[end])) ++end;
+            }
+
+            const auto head = text.substr(0, end);
+            const auto rest = trim(text.substr(end));
+
+            // constant
+            if (!rest.empty() && rest.front() == '=' && isIdentifierStart(text[0])) {
+                const auto value = evaluate(rest.substr(1));
+                if (value.known) define(head, value.value);
+                return;
+            }
+
+            if (head.empty()) assemblyError(line, "syntax error");
+            if (head.front() == '.') return directive(head, rest);
+
+            const auto mnemonic = findMnemonic(head);
+            if (!mnemonic) assemblyError(line, "unknown instruction");
+            assembleInstruction(*mnemonic, rest);
+        }
+
+        constexpr void runPass(const int number) {
+            pass = number;
+            pc = 0;
+            placed = false;
+            instruction = 0;
+            line = 0;
+
+            std::string_view remaining = source;
+            while (!remaining.empty()) {
+                const auto newline = remaining.find('\n');
+                ++line;
+                try {
+                    assembleLine(remaining.substr(0, newline));
+                } catch (const AssemblyError&) {
+                    throw;
+                } catch (const std::runtime_error& e) {
+                    assemblyError(line, e.what());
+                }
+                if (newline == std::string_view::npos) break;
+                remaining.remove_prefix(newline + 1);
+            }
+        }
+
+    public:
+        constexpr explicit Assembler(const std::string_view source) : source(source) {}
+
+        [[nodiscard]] constexpr Assembly assemble() {
+            runPass(1);
+            result = {};
+            hasEntry = false;
+            runPass(2);
+            return std::move(result);
+        }
+    };
+
+    // assemble at runtime, throws std::runtime_error on malformed source
+    [[nodiscard]] Program assemble(std::string_view source);
+
+    template <std::size_t N>
+    struct Source {
+        char text[N]{};
+
+        consteval Source(const char (&source)[N]) { // NOLINT(*-explicit-constructor)
+            std::copy_n(source, N, text);
+        }
+
+        [[nodiscard]] constexpr std::string_view view() const { return {text, N - 1}; }
+    };
+
+    template <std::size_t N>
+    struct StaticProgram {
+        std::array<byte, N> code{};
+        address origin = 0;
+        address entryPoint = 0;
+
+        [[nodiscard]] Program program() const {
+            return Program({code.begin(), code.end()}, entryPoint, origin);
+        }
+    };
+
+    // assemble at compile time: constexpr auto program = assemble<"LDA #1 ...">();
+    template <Source source>
+    consteval auto assemble() {
+        constexpr auto size = Assembler(source.view()).assemble().code.size();
+        const auto assembly = Assembler(source.view()).assemble();
+
+        StaticProgram<size> program;
+        std::ranges::copy(assembly.code, program.code.begin());
+        program.origin = assembly.origin;
+        program.entryPoint = assembly.entryPoint;
+        return program;
+    }
+
+} // mos6502
@@ -0,0 +1,49 @@
+#include "bank_switch.h"
+
+#include <stdexcept>
+
+namespace mos6502 {
+
+    BankSwitch::BankSwitch(Memory& memory, const address window, const std::size_t windowSize, const address reg)
+        : memory(memory), window(window), windowSize(windowSize), banks(memory.physicalSize() / windowSize), reg(reg) {
+        if (windowSize == 0 || windowSize % 256 || window % 256 || window + windowSize > 0x10000) {
+            throw std::invalid_argument("bank window must be whole pages inside the address space");
+        }
+        if (banks == 0 || banks > 256) throw std::invalid_argument("physical memory must hold 1 to 256 banks");
+
+        bank = static_cast<byte>(window / windowSize % banks);
+        select(bank);
+        previousRead = memory.mapRead(reg >> 8, this);
+        previousWrite = memory.mapWrite(reg >> 8, this);
+    }
+
+    BankSwitch::~BankSwitch() {
+        if (memory.readHandler(reg >> 8) == this) memory.mapRead(reg >> 8, previousRead);
+        if (memory.writeHandler(reg >> 8) == this) memory.mapWrite(reg >> 8, previousWrite);
+    }
+
+    void BankSwitch::select(const byte bank) {
+        this->bank = static_cast<byte>(bank % banks);
+        memory.mapPhysical(window >> 8, static_cast<word>(windowSize >> 8), this->bank * windowSize);
+    }
+
+    void BankSwitch::restoreState(const std::span<const byte> state) {
+        if (state.size() != 1) throw std::runtime_error("bank switch state has the wrong size");
+        select(state[0]);
+    }
+
+    byte BankSwitch::read(const address addr) {
+        if (addr == reg) return bank;
+        return previousRead ? previousRead->read(addr) : memory.peek(addr);
+    }
+
+    void BankSwitch::write(const address addr, const byte value) {
+        if (addr == reg) {
+            select(value);
+            return;
+        }
+        if (previousWrite) previousWrite->write(addr, value);
+        else memory.poke(addr, value);
+    }
+
+} // mos6502
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+
+#include "types.h"
+#include "memory.h"
+#include "save_state.h"
+
+namespace mos6502 {
+
+    /*
+     * A bank select register for a window of the address space. Writing N to the register maps bank N, the
+     * window-sized block of the physical store at N * window size, into the window; reading it gives the bank
+     * selected. Bank numbers wrap at the number of banks the store holds. A switch is a Memory::mapPhysical()
+     * of the window's pages, so accesses in the window stay on the fast path, a page table load from the store.
+     */
+    class BankSwitch final : public PageHandler, public StatefulDevice {
+    public:
+        // maps the register at `reg`, the rest of its page keeps working as before; the window starts out
+        // showing the bank of its own addresses, as without banking
+        BankSwitch(Memory& memory, address window, std::size_t windowSize, address reg);
+        ~BankSwitch() override;
+
+        BankSwitch(const BankSwitch&) = delete;
+        BankSwitch& operator=(const BankSwitch&) = delete;
+
+        void select(byte bank);
+        [[nodiscard]] byte selected() const { return bank; }
+
+        byte read(address addr) override;
+        void write(address addr, byte value) override;
+
+        [[nodiscard]] const char* stateName() const override { return "banks"; }
+        [[nodiscard]] std::vector<byte> saveState() const override { return {bank}; }
+        void restoreState(std::span<const byte> state) override;
+
+    private:
+        Memory& memory;
+        address window;
+        std::size_t windowSize;
+        std::size_t banks;
+        address reg;
+        byte bank{};
+        PageHandler* previousRead{};
+        PageHandler* previousWrite{};
+    };
+
+} // mos6502
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+
+#include "types.h"
+
+namespace mos6502 {
+
+    // PC breakpoints kept as a per-address bitmap behind a per-page count,
+    // so the run loop only looks up single addresses on pages that hold a breakpoint.
+    class Breakpoints {
+        std::array<word, 256> perPage{};
+        std::bitset<0x10000> addresses;
+
+    public:
+        [[nodiscard]] bool at(const address addr) const {
+            return perPage[addr >> 8] && addresses[addr];
+        }
+
+        void add(const address addr) {
+            if (addresses[addr]) return;
+            addresses[addr] = true;
+            ++perPage[addr >> 8];
+        }
+
+        void remove(const address addr) {
+            if (!addresses[addr]) return;
+            addresses[addr] = false;
+            --perPage[addr >> 8];
+        }
+    };
+
+} // mos6502
@@ -1,5 +1,10 @@
 #include "cpu.h"
 
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+
 #include <fmt/core.h>
 
 namespace mos6502 {
@@ -11,6 +16,50 @@ namespace mos6502 {
         x = 0;
         y = 0;
         *reinterpret_cast<byte*>(&sr) = 0;
+        cycleCount = 0;
+        halted = false;
+        fused = 0;
+        skipped = 0;
+        idle = {};
+        impureLoops = {};
+        previousLocation = 0;
+        events.clear();
+        nextEvent = never;
+        irqLines = 0;
+        deadline = 0;
+        fastForward = false;
+    }
+
+    [[nodiscard]] byte CPU::status() const {
+        return *reinterpret_cast<const byte*>(&sr);
+    }
+
+    void CPU::setStatus(const byte value) {
+        *reinterpret_cast<byte*>(&sr) = value;
+    }
+
+    [[nodiscard]] Registers CPU::getRegisters() const {
+        return {pc, sp, ac, x, y, status()};
+    }
+
+    void CPU::setRegisters(const Registers& registers) {
+        pc = registers.pc;
+        sp = registers.sp;
+        ac = registers.ac;
+        x = registers.x;
+        y = registers.y;
+        setStatus(registers.sr);
+    }
+
+    std::uint64_t CPU::stateHash() const {
+        const auto [pc, sp, ac, x, y, sr] = getRegisters();
+        const std::uint64_t packed = std::uint64_t{halted} << 56 | std::uint64_t{pc} << 40 | std::uint64_t{sp} << 32 |
+            std::uint64_t{ac} << 24 | std::uint64_t{x} << 16 | std::uint64_t{y} << 8 | sr;
+        return memory.getHash() ^ mixHash(std::uint64_t{1} << 62 | packed);
+    }
+
+    [[nodiscard]] byte CPU::fetchOpcode() {
+        return memory.fetchOpcode(pc++);
     }
 
     [[nodiscard]] byte CPU::fetch() {
@@ -24,7 +73,7 @@ namespace mos6502 {
     }
 
     void CPU::push(const byte value) {
-        memory.write(0x100 + sp--, value);
+        memory.writeStack(sp--, value);
     }
 
     void CPU::pushWord(const word value) {
@@ -33,11 +82,12 @@ namespace mos6502 {
     }
 
     byte CPU::pop() {
-        return memory.read(0x100 + ++sp);
+        return memory.readStack(++sp);
     }
 
     word CPU::popWord() {
-        return pop() | (pop() << 8);
+        const byte low = pop();
+        return low | (pop() << 8);
     }
 
     CPU::instruction CPU::decode(const byte opcode) {
@@ -45,31 +95,327 @@ namespace mos6502 {
     }
 
     cycles CPU::execute(const instruction operation) {
+#ifdef MOS6502_BUS_LOG
+        // single-byte instructions read the byte after the opcode and ignore it
+        if (opcodes[opcode].length == 1 && opcodes[opcode].mnemonic != Mnemonic::Illegal) dummyRead(pc);
+#endif
         return (this->*operation)();
     }
 
+    void CPU::setState(const State& state) {
+        reset();
+
+        setRegisters(state.registers);
+        cycleCount = state.cycleCount;
+        irqLines = state.irqLines;
+        halted = state.halted;
+    }
+
     void CPU::load(const Program& program) {
         reset();
 
-        memory.write(program.entryPoint, program.code);
+        memory.write(program.origin, program.code);
 
         pc = program.entryPoint;
         sp = 0xFF;
     }
 
-    void CPU::run() {
-        long cycles = 0;
+    void CPU::setHostCall(HostCallHandler* handler, const byte opcode) {
+        if (handler && (opcode == 0x00 || opcodes[opcode].mnemonic != Mnemonic::Illegal)) {
+            throw std::runtime_error("the host call opcode must be an undefined one");
+        }
+        hostCall = handler;
+        hostCallOpcode = opcode;
+    }
+
+    void CPU::requestStop(const StopReason reason) {
+        stopReason = reason;
+        deadline = 0;
+    }
+
+    void CPU::schedule(TimedDevice* device, const std::uint64_t cycle) {
+        cancel(device);
+        events.push_back({device, cycle});
+        nextEvent = std::min(nextEvent, cycle);
+        deadline = std::min(deadline, cycle); // scheduled by a device during run()
+    }
+
+    void CPU::cancel(TimedDevice* device) {
+        std::erase_if(events, [device](const Event& event) { return event.device == device; });
+        nextEvent = never;
+        for (const auto& event : events) nextEvent = std::min(nextEvent, event.cycle);
+    }
+
+    void CPU::setIrq(const std::uint32_t source, const bool asserted) {
+        irqLines = asserted ? irqLines | source : irqLines & ~source;
+        if (asserted) deadline = std::min(deadline, cycleCount); // leaves the run loop to take it
+    }
+
+    // fires the device events that are due, one at a time since expire() may schedule again, then takes IRQ
+    void CPU::serviceEvents() {
+        while (cycleCount >= nextEvent) {
+            const auto due = std::ranges::find_if(events, [this](const Event& event) { return event.cycle <= cycleCount; });
+            TimedDevice* device = due->device;
+            cancel(device);
+            device->expire(cycleCount);
+        }
+        if (irqLines && !sr.i) interrupt();
+        idle = {}; // memory may have changed under the loop
+    }
+
+    // instructions from `head` to `closer` that neither write nor read anything but plain memory, nor touch the
+    // stack or the I flag, so an iteration depends on nothing but the registers and memory nobody else changes
+    // until the next event; 0 if the loop is not like that
+    unsigned CPU::pureLoopLength(const address closer, const address head) const {
+        const auto plain = [this](const address addr) { return memory.readHandler(addr >> 8) == nullptr; };
+
+        unsigned count = 0;
+        for (std::uint32_t at = head; at <= closer; ++count) {
+            const auto& info = opcodes[memory.peek(at)];
+            if (info.mnemonic == Mnemonic::Illegal || !plain(at) || !plain(at + info.length - 1)) return 0;
+            const address operand = memory.peek(at + 1) | memory.peek(at + 2) << 8;
+
+            switch (info.mode) {
+                case Mode::Implied:
+                case Mode::Accumulator:
+                    switch (info.mnemonic) {
+                        case Mnemonic::BRK: case Mnemonic::RTI: case Mnemonic::RTS: case Mnemonic::PHA:
+                        case Mnemonic::PHP: case Mnemonic::PLA: case Mnemonic::PLP: case Mnemonic::CLI:
+                        case Mnemonic::SEI:
+                            return 0;
+                        default:
+                            break;
+                    }
+                    break;
+                case Mode::Immediate:
+                    break;
+                case Mode::ZeroPage:
+                case Mode::Absolute:
+                    if (at == closer && info.mnemonic == Mnemonic::JMP) break;
+                    switch (info.mnemonic) {
+                        case Mnemonic::LDA: case Mnemonic::LDX: case Mnemonic::LDY: case Mnemonic::CMP:
+                        case Mnemonic::CPX: case Mnemonic::CPY: case Mnemonic::BIT: case Mnemonic::AND:
+                        case Mnemonic::ORA: case Mnemonic::EOR: case Mnemonic::ADC: case Mnemonic::SBC:
+                            if (!plain(info.mode == Mode::ZeroPage ? operand & 0xFF : operand)) return 0;
+                            break;
+                        default:
+                            return 0;
+                    }
+                    break;
+                case Mode::Relative:
+                    if (at != closer) return 0;
+                    break;
+                default:
+                    return 0;
+            }
+
+            if (at == closer) return count + 1;
+            at += info.length;
+        }
+        return 0;
+    }
+
+    // called from a taken branch or JMP back to `head`, with the cycle count still at the start of the closer
+    void CPU::watchLoop(const address closer, const address head) {
+        if (const auto length = idleSkipping ? pureLoopLength(closer, head) : 0) skipIdle(closer, head, length);
+        else if (!bulkLoops || !copyLoop(closer, head)) impureLoops[closer & 0xFF] = closer;
+    }
+
+    // A pure loop that comes back to its top in the state it left it in repeats unchanged until an event can
+    // change memory, so the whole iterations that still start before the deadline are skipped, adding their
+    // cycles and instructions. The same state is taken from two consecutive iterations with no event between.
+    void CPU::skipIdle(const address closer, const address head, const unsigned length) {
+        const Registers registers{head, sp, ac, x, y, status()};
+        if (idle.closer == closer && idle.registers == registers && idle.cycle < cycleCount && cycleCount < deadline) {
+            const auto period = cycleCount - idle.cycle;
+            const auto iterations = (deadline - 1 - cycleCount) / period;
+            cycleCount += iterations * period;
+            skipped += iterations * length;
+        }
+        idle = {closer, registers, cycleCount};
+    }
+
+namespace {
+
+    struct IndexedAccess {
+        Mode mode;
+        address operand;
+    };
+
+    bool isIndexed(const Mode mode) {
+        return mode == Mode::IndirectY || mode == Mode::AbsoluteY || mode == Mode::AbsoluteX;
+    }
+
+    // whether [a, a + n) and [b, b + m) share an address, wrapping at the top of memory
+    bool overlaps(const address a, const std::uint32_t n, const address b, const std::uint32_t m) {
+        return static_cast<address>(b - a) < n || static_cast<address>(a - b) < m;
+    }
+
+} // namespace
+
+    // LDA src; STA dst; INY; BNE and the fills without the LDA, with (zp),Y, abs,Y or abs,X operands and DEY, INX
+    // or DEX counting instead, run in bulk over Memory::copy() or fill() for as many iterations as would start
+    // before the deadline, leaving the registers, flags and cycle count where the last of them did. Returns false
+    // unless the loop is one of these; one that is still runs on the interpreter where the bulk copy would not
+    // match it, because a page involved has a handler or the ranges overlap each other, the loop or its pointers.
+    bool CPU::copyLoop(const address closer, const address head) {
+        const auto decode = [this](const address at) -> const Opcode& { return opcodes[memory.peek(at)]; };
+        const auto operand = [this](const address at) { return static_cast<address>(memory.peek(at + 1) | memory.peek(at + 2) << 8); };
+
+        address at = head;
+        std::optional<IndexedAccess> source;
+        if (decode(at).mnemonic == Mnemonic::LDA && isIndexed(decode(at).mode)) {
+            source = IndexedAccess{decode(at).mode, operand(at)};
+            at += decode(at).length;
+        }
+        if (decode(at).mnemonic != Mnemonic::STA || !isIndexed(decode(at).mode)) return false;
+        const IndexedAccess destination{decode(at).mode, operand(at)};
+        const auto storeCycles = decode(at).cycles;
+        at += decode(at).length;
+
+        const auto counter = decode(at).mnemonic;
+        const bool usesX = destination.mode == Mode::AbsoluteX;
+        const bool up = counter == Mnemonic::INX || counter == Mnemonic::INY;
+        if (usesX ? counter != Mnemonic::INX && counter != Mnemonic::DEX : counter != Mnemonic::INY && counter != Mnemonic::DEY) return false;
+        if (source && (source->mode == Mode::AbsoluteX) != usesX) return false;
+        if (++at != closer || memory.peek(closer) != 0xD0) return false; // BNE
+
+        // where the iterations left find their bytes, with the pointers of (zp),Y as they are now
+        if (memory.readHandler(0)) return true;
+        const auto base = [this](const IndexedAccess& access) {
+            return access.mode == Mode::IndirectY ? memory.readZeroPageWord(static_cast<byte>(access.operand)) : access.operand;
+        };
+        const address to = base(destination);
+        const address from = source ? base(*source) : 0;
+
+        const byte start = usesX ? x : y; // the index of the next iteration, the counter has moved it already
+        const unsigned remaining = up ? 0x100 - start : start;
+        const auto& load = opcodes[memory.peek(head)];
+        const cycles taken = opcodes[0xD0].cycles + opcodes[0xD0].penalty * (1 + ((closer + 2) >> 8 != head >> 8));
+
+        // the whole iterations whose BNE still starts before the deadline, from the end of the current one
+        auto now = cycleCount + taken;
+        unsigned count = 0;
+        for (byte index = start; count < remaining; ++count, up ? ++index : --index) {
+            const bool crosses = source && (from & 0xFF) + index > 0xFF;
+            const auto body = (source ? load.cycles + crosses * load.penalty : 0) + storeCycles + 2;
+            if (now + body >= deadline) break;
+            now += body + (count + 1 == remaining ? opcodes[0xD0].cycles : taken);
+        }
+        if (count == 0) return true;
+
+        // the bytes those iterations touch, and nothing they depend on among the ones they write
+        const byte first = up ? start : start - count + 1;
+        const auto written = static_cast<address>(to + first);
+        if (overlaps(written, count, head, closer + 2 - head)) return true;
+        for (const auto& access : {std::optional(destination), source}) {
+            if (!access || access->mode != Mode::IndirectY) continue;
+            const byte pointer = access->operand;
+            if (overlaps(written, count, pointer, 1) || overlaps(written, count, static_cast<byte>(pointer + 1), 1)) return true;
+        }
+        if (source ? !memory.copy(written, from + first, count) : !memory.fill(written, ac, count)) return true;
+
+        const byte index = up ? start + count : start - count;
+        (usesX ? x : y) = index;
+        if (source) ac = memory.peek(static_cast<address>(from + static_cast<byte>(up ? index - 1 : index + 1)));
+        sr.z = index == 0;
+        sr.n = index & 0x80;
+        if (count == remaining) pc = closer + 2;
+
+        cycleCount = now - taken; // the closer that called us adds its own cycles
+        skipped += count * (source ? 4 : 3);
+        return true;
+    }
+
+    void CPU::interrupt() {
+        pushWord(pc);
+        push((*reinterpret_cast<byte*>(&sr) & ~0b00010000) | 0b00100000);
+        sr.i = true;
+        pc = memory.readWord(0xFFFE);
+        cycleCount += 7;
+    }
+
+    cycles CPU::step() {
+        const auto start = cycleCount;
+        if (eventsPending()) serviceEvents();
+
+        opcode = fetchOpcode();
+
+        if (opcode == 0x00 && haltOnBrk) {
+            halted = true;
+            return static_cast<cycles>(cycleCount - start);
+        }
+
+        cycleCount += execute(decode(opcode));
+        return static_cast<cycles>(cycleCount - start);
+    }
+
+    template <bool Debug>
+    RunResult CPU::runLoop(const std::uint64_t budget) {
+        const auto start = cycleCount;
+        const auto fusedBefore = fused;
+        const auto skippedBefore = skipped;
+        std::uint64_t instructions = 0;
+
+        stopReason = StopReason::Budget;
+        runEnd = budget > never - start ? never : start + budget;
+
+        // breakpoints are checked before every instruction, so nothing is fused while they are set
+        const instruction* const table = !Debug && fusing ? superinstructions.data() : CPU::instructions;
+        // skipped iterations make no bus cycles, count no accesses and record no edges
+        fastForward = !Debug && !coverage && !memory.getAccessStats();
+#ifdef MOS6502_BUS_LOG
+        fastForward = fastForward && !memory.getBusLog();
+#endif
+        idle = {}; // the host may have changed memory since the last run()
+
+        // step() must not fast-forward to this run's deadline, not even after an instruction threw
+        struct EndFastForward {
+            bool& flag;
+            ~EndFastForward() { flag = false; }
+        } endFastForward{fastForward};
 
         while (true) {
-            const byte opcode = fetch();
+            deadline = std::min(runEnd, eventDeadline());
 
-            if (opcode == 0x00) break;
+            while (cycleCount < deadline) {
+                if constexpr (Debug) {
+                    if (breakpoints->at(pc)) {
+                        stopReason = StopReason::Breakpoint;
+                        break;
+                    }
+                }
 
-            const auto operation = decode(opcode);
-            cycles += execute(operation);
+                opcode = fetchOpcode();
+
+                if (opcode == 0x00 && haltOnBrk) [[unlikely]] {
+                    halted = true;
+                    stopReason = StopReason::Halted;
+                    break;
+                }
+
+                cycleCount += execute(table[opcode]);
+                ++instructions;
+            }
+
+            if (stopReason != StopReason::Budget || cycleCount >= runEnd) break;
+            serviceEvents();
+            if (stopReason != StopReason::Budget) break; // a device asked to stop
         }
 
-        fmt::println("Execution took {} cycles", cycles);
+        return {stopReason, cycleCount - start, instructions + (fused - fusedBefore) + (skipped - skippedBefore)};
+    }
+
+    RunResult CPU::run(const std::uint64_t budget) {
+        if (halted) return {StopReason::Halted, 0, 0};
+
+        return breakpoints ? runLoop<true>(budget) : runLoop<false>(budget);
+    }
+
+    void CPU::run() {
+        const auto result = run(std::numeric_limits<std::uint64_t>::max());
+
+        fmt::println("Execution took {} cycles", result.cycles);
     }
 
     void CPU::run(const Program& program)  {
@@ -1,35 +1,186 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
 #include "types.h"
+#include "alu.h"
 #include "memory.h"
+#include "breakpoints.h"
+#include "opcodes.h"
 #include "program.h"
 
 namespace mos6502 {
 
+enum class StopReason : byte {
+    Budget,     // ran out of cycles
+    Halted,     // reached a 0x00 opcode
+    Breakpoint, // about to execute an instruction with a breakpoint
+    Watchpoint, // a watched address was accessed by the last instruction
+    Requested,  // requestStop() was called
+    Blocked,    // a device asked to stop until it has input, see Scheduler
+};
+
+struct RunResult {
+    StopReason reason;
+    std::uint64_t cycles;
+    std::uint64_t instructions;
+};
+
+class CPU;
+
+// Host services the guest reaches through a reserved opcode, see CPU::setHostCall().
+class HostCallHandler {
+public:
+    virtual ~HostCallHandler() = default;
+
+    // runs `service` with the CPU's registers and memory, returns the cycles to charge on top of the trap's own 2
+    virtual cycles call(CPU& cpu, byte service) = 0;
+};
+
+// A device with work due at a given cycle, such as a timer running out, see CPU::schedule().
+class TimedDevice {
+public:
+    virtual ~TimedDevice() = default;
+
+    // called between instructions once the cycle count has reached the scheduled cycle
+    virtual void expire(std::uint64_t now) = 0;
+};
+
+struct Registers {
+    word pc;
+    byte sp;
+    byte ac;
+    byte x;
+    byte y;
+    byte sr;
+
+    bool operator==(const Registers&) const = default;
+};
+
 class CPU {
     word pc{};
     byte sp{};
     byte ac{};
     byte x{};
     byte y{};
-    struct {
-        bool c : 1{};
-        bool z : 1{};
-        bool i : 1{};
-        bool d : 1{};
-        bool b : 1{};
-        bool : 1;
-        bool v : 1{};
-        bool n : 1{};
-    } sr{};
+    StatusFlags sr{};
 
     Memory memory;
 
+    byte opcode{}; // opcode of the instruction being executed
+
+    std::uint64_t cycleCount{}; // cycles executed since the last load()
+    std::uint64_t deadline{};   // the run loop leaves once cycleCount reaches it
+    std::uint64_t runEnd{};     // cycle the current run() ends at, deadline also stops at device events
+    StopReason stopReason{};
+    bool halted{};
+    bool haltOnBrk = true; // treat opcode 0x00 as the end of the program instead of executing BRK
+    bool fusing = true;    // run() dispatches through superinstructions
+    std::uint64_t fused{}; // instructions run as the second half of a superinstruction since the last load()
+
+    // idle loops and copy or fill loops, see watchLoop()
+    struct IdleLoop {
+        address closer{}; // the branch or JMP back to the top
+        Registers registers{};
+        std::uint64_t cycle = std::numeric_limits<std::uint64_t>::max();
+    };
+
+    bool idleSkipping = true;
+    bool bulkLoops = true;
+    bool fastForward{};                     // while run() may fast-forward loops
+    IdleLoop idle;                          // the last pure loop iteration seen, until the next event
+    std::array<address, 256> impureLoops{}; // closers of loops that are neither, by their low byte
+    std::uint64_t skipped{};                // instructions fast-forwarded since the last load()
+
+    const Breakpoints* breakpoints{};
+
+    HostCallHandler* hostCall{};
+    byte hostCallOpcode{};
+
+    struct Event {
+        TimedDevice* device;
+        std::uint64_t cycle;
+    };
+
+    static constexpr auto never = std::numeric_limits<std::uint64_t>::max();
+
+    std::vector<Event> events;  // one entry per device with something scheduled
+    std::uint64_t nextEvent = never;
+    std::uint32_t irqLines{};   // one bit per device holding IRQ low
+
+    // true when serviceEvents() has something to do before the next instruction
+    [[nodiscard]] bool eventsPending() const {
+        return cycleCount >= nextEvent || (irqLines && !sr.i);
+    }
+
+    // where the run loop has to leave to service device events and interrupts
+    [[nodiscard]] std::uint64_t eventDeadline() const {
+        if (irqLines) return sr.i ? std::min(nextEvent, cycleCount + 1) : cycleCount;
+        return nextEvent;
+    }
+
+    void serviceEvents();
+    void interrupt();
+
+    // called by a branch or JMP at `closer` that goes back to `head`
+    void loopedBack(const address closer, const address head) {
+        if (fastForward && impureLoops[closer & 0xFF] != closer) watchLoop(closer, head);
+    }
+
+    void watchLoop(address closer, address head);
+    [[nodiscard]] unsigned pureLoopLength(address closer, address head) const;
+    void skipIdle(address closer, address head, unsigned length);
+    [[nodiscard]] bool copyLoop(address closer, address head);
+
+    byte* coverage{};        // edge hit counters while fuzzing, nullptr otherwise
+    word previousLocation{}; // last control-flow target, shifted, as in AFL
+
     void reset();
 
+    void recordEdge(const word target) {
+        if (coverage) [[unlikely]] {
+            ++coverage[target ^ previousLocation];
+            previousLocation = target >> 1;
+        }
+    }
+
+    [[nodiscard]] byte status() const;
+    void setStatus(byte value);
+
+    [[nodiscard]] byte fetchOpcode();
     [[nodiscard]] byte fetch();
     [[nodiscard]] word fetchWord();
 
+    // accesses the hardware makes without using the result, only performed while bus cycles are recorded
+    void dummyRead([[maybe_unused]] const address addr) const {
+#ifdef MOS6502_BUS_LOG
+        (void)memory.read(addr);
+#endif
+    }
+
+    void dummyWrite([[maybe_unused]] const address addr, [[maybe_unused]] const byte value) {
+#ifdef MOS6502_BUS_LOG
+        memory.write(addr, value);
+#endif
+    }
+
+    [[nodiscard]] byte zeroPageIndexed(byte index);
+    [[nodiscard]] byte readIndexed(address base, byte index);
+    [[nodiscard]] address indexedForWrite(address base, byte index);
+    [[nodiscard]] byte readModify(address addr);
+    [[nodiscard]] byte readModifyZeroPage(byte offset);
+
+    // cycles taken by the instruction being executed, `penalties` counts page crossings and taken branches
+    [[nodiscard]] cycles cost(const int penalties = 0) const {
+        const auto& info = opcodes[opcode];
+        return info.cycles + penalties * info.penalty;
+    }
+
 #pragma region Transfer Instructions
 
     void lda(byte value);
@@ -276,15 +427,115 @@ class CPU {
     using instruction = cycles (CPU::*)();
     static const instruction instructions[];
 
+#pragma region Superinstructions
+
+    // the instructions with a fused handler in place of the first of each frequent pair, for run() without
+    // breakpoints; the pairs come from the profiler's opcode pair counts on the demo, bench and device workloads
+    static const std::array<instruction, 256> superinstructions;
+
+    // executes First, then Then straight away if the next opcode is Second and the run loop would have started
+    // it too, before the deadline and so with no event or interrupt in between
+    template <instruction First, byte Second, instruction Then>
+    cycles fuse();
+
+    // the same with any conditional branch following First
+    template <instruction First>
+    cycles fuseBranch();
+
+#pragma endregion
+
     static instruction decode(byte opcode);
     cycles execute(instruction operation);
 
+    template <bool Debug>
+    RunResult runLoop(std::uint64_t budget);
+
+    friend class TickCore;
+    friend class AotCore;
+
 public:
-    explicit CPU(const byte memoryPages = 255): memory(memoryPages) {}
+    explicit CPU(const word memoryPages = 256, const std::size_t physicalSize = 0x10000)
+        : memory(memoryPages, physicalSize) {}
 
     Memory& getMemory() { return memory; }
+    [[nodiscard]] const Memory& getMemory() const { return memory; }
+
+    [[nodiscard]] Registers getRegisters() const;
+    void setRegisters(const Registers& registers);
+
+    [[nodiscard]] std::uint64_t getCycleCount() const { return cycleCount; }
+    [[nodiscard]] bool isHalted() const { return halted; }
+
+    // a hash of the registers, memory and its mapping, the same whenever the machine returns to a state it was
+    // in before; the cycle count, interrupts and devices are left out. Costs nothing while the memory is
+    // hashing, see Memory::setHashing()
+    [[nodiscard]] std::uint64_t stateHash() const;
+
+    // what a save state keeps of the CPU, see save_state.h
+    struct State {
+        Registers registers;
+        std::uint64_t cycleCount;
+        std::uint32_t irqLines;
+        bool halted;
+    };
+
+    [[nodiscard]] State getState() const { return {getRegisters(), cycleCount, irqLines, halted}; }
+
+    // resets the CPU into `state`, leaving memory alone; scheduled events are dropped, so devices restore after it
+    void setState(const State& state);
+
+    // checked before every instruction while set, nullptr turns the checks off
+    void setBreakpoints(const Breakpoints* breakpoints) { this->breakpoints = breakpoints; }
+
+    // by default opcode 0x00 halts the CPU, turning it off makes it execute BRK like the hardware does
+    void setHaltOnBrk(const bool halt) { haltOnBrk = halt; }
+
+    // run() executes frequent instruction pairs in one dispatch unless turned off, with the same results
+    void setSuperinstructions(const bool enabled) { fusing = enabled; }
+
+    // instructions that did not need a dispatch of their own since the last load(), see superinstructions
+    [[nodiscard]] std::uint64_t getFusedCount() const { return fused; }
+
+    // run() skips the iterations of idle loops up to the next event unless turned off, with the same results
+    void setIdleSkipping(const bool enabled) { idleSkipping = enabled; }
+
+    // run() executes the remaining iterations of byte copy and fill loops at once unless turned off, with the
+    // same results
+    void setBulkLoops(const bool enabled) { bulkLoops = enabled; }
+
+    // instructions run() fast-forwarded in idle, copy and fill loops since the last load()
+    [[nodiscard]] std::uint64_t getSkippedCount() const { return skipped; }
+
+    // makes `opcode`, which must be one the 6502 does not define, a two-byte trap: the byte after it selects the
+    // service `handler` runs; nullptr turns the trap off and the opcode is illegal again
+    void setHostCall(HostCallHandler* handler, byte opcode = 0x02);
+
+    // counts control-flow edges (branches, jumps, calls and returns) into `map` while set, nullptr turns it off
+    void setCoverage(byte* map) { coverage = map; }
+    static constexpr std::size_t coverageSize = 0x10000;
+
+    // makes run() return after the current instruction, safe to call from page handlers
+    void requestStop(StopReason reason);
+
+    // makes `device` expire() once the cycle count reaches `cycle`, replacing what it had scheduled; the run
+    // loop stops there and nowhere else, so devices cost nothing between their events
+    void schedule(TimedDevice* device, std::uint64_t cycle);
+    void cancel(TimedDevice* device);
+
+    // the IRQ line is held low while any source asserts it, each device owns a bit of `source`;
+    // it is taken between instructions while the I flag is clear
+    void setIrq(std::uint32_t source, bool asserted);
+
+    // load() resets the machine and drops scheduled events and interrupts, so devices are attached after it
 
     void load(const Program& program);
+
+    // executes a single instruction, ignoring breakpoints
+    cycles step();
+
+    // runs until `budget` cycles have elapsed, the CPU halts or a stop is requested
+    RunResult run(std::uint64_t budget);
+
     void run();
     void run(const Program& program);
 };
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <stdexcept>
 
 #include "cpu.h"
@@ -5,13 +6,48 @@
 namespace mos6502 {
 
     bool isSamePage(const address a, const address b) {
-        return a & 0xFF00 == b & 0xFF00;
+        return (a & 0xFF00) == (b & 0xFF00);
     }
 
     bool isNegative(const byte value) {
         return value & 0b10000000;
     }
 
+    // zp,X and zp,Y read the base address while the index is being added, which wraps within the zero page
+    byte CPU::zeroPageIndexed(const byte index) {
+        const byte base = fetch();
+        dummyRead(base);
+        return base + index;
+    }
+
+    // an indexed read that crosses a page first reads from the address without the carry into the high byte
+    byte CPU::readIndexed(const address base, const byte index) {
+        const address addr = base + index;
+        if (!isSamePage(base, addr)) dummyRead((base & 0xFF00) | (addr & 0xFF));
+        return memory.read(addr);
+    }
+
+    // indexed writes and read-modify-writes always make that read, crossing a page or not
+    address CPU::indexedForWrite(const address base, const byte index) {
+        const address addr = base + index;
+        dummyRead((base & 0xFF00) | (addr & 0xFF));
+        return addr;
+    }
+
+    // read-modify-write instructions write the unmodified value back before the result
+    byte CPU::readModify(const address addr) {
+        const byte value = memory.read(addr);
+        dummyWrite(addr, value);
+        return value;
+    }
+
+    // the same for the zero page, which skips the page table lookup
+    byte CPU::readModifyZeroPage(const byte offset) {
+        const byte value = memory.readZeroPage(offset);
+        dummyWrite(offset, value);
+        return value;
+    }
+
 #pragma region Transfer Instructions
 
     void CPU::lda(const byte value) {
@@ -22,45 +58,45 @@ namespace mos6502 {
 
     cycles CPU::lda_imm() {
         lda(fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::lda_zp() {
-        lda(memory.read(fetch()));
-        return 3;
+        lda(memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::lda_zp_x() {
-        lda(memory.read(fetch() + x));
-        return 4;
+        lda(memory.readZeroPage(zeroPageIndexed(x)));
+        return cost();
     }
 
     cycles CPU::lda_abs() {
         lda(memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::lda_abs_x() {
         const auto addr = fetchWord();
-        lda(memory.read(addr + x));
-        return isSamePage(addr, addr + x) ? 4 : 5;
+        lda(readIndexed(addr, x));
+        return cost(!isSamePage(addr, addr + x));
     }
 
     cycles CPU::lda_abs_y() {
         const auto addr = fetchWord();
-        lda(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 4 : 5;
+        lda(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     cycles CPU::lda_ind_x() {
-        lda(memory.read(memory.readWord(fetch() + x)));
-        return 6;
+        lda(memory.read(memory.readZeroPageWord(zeroPageIndexed(x))));
+        return cost();
     }
 
     cycles CPU::lda_ind_y() {
-        const auto addr = memory.readWord(fetch());
-        lda(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 5 : 6;
+        const auto addr = memory.readZeroPageWord(fetch());
+        lda(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     void CPU::ldx(const byte value) {
@@ -71,28 +107,28 @@ namespace mos6502 {
 
     cycles CPU::ldx_imm() {
         ldx(fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::ldx_zp() {
-        ldx(memory.read(fetch()));
-        return 3;
+        ldx(memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::ldx_zp_y() {
-        ldx(memory.read(fetch() + y));
-        return 4;
+        ldx(memory.readZeroPage(zeroPageIndexed(y)));
+        return cost();
     }
 
     cycles CPU::ldx_abs() {
         ldx(memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::ldx_abs_y() {
         const auto addr = fetchWord();
-        ldx(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 4 : 5;
+        ldx(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     void CPU::ldy(const byte value) {
@@ -104,133 +140,133 @@ namespace mos6502 {
     // Add implementations for ldy_ methods
     cycles CPU::ldy_imm() {
         ldy(fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::ldy_zp() {
-        ldy(memory.read(fetch()));
-        return 3;
+        ldy(memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::ldy_zp_x() {
-        ldy(memory.read(fetch() + x));
-        return 4;
+        ldy(memory.readZeroPage(zeroPageIndexed(x)));
+        return cost();
     }
 
     cycles CPU::ldy_abs() {
         ldy(memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::ldy_abs_x() {
         const auto addr = fetchWord();
-        ldy(memory.read(addr + x));
-        return isSamePage(addr, addr + x) ? 4 : 5;
+        ldy(readIndexed(addr, x));
+        return cost(!isSamePage(addr, addr + x));
     }
 
     cycles CPU::sta_zp() {
-        memory.write(fetch(), ac);
-        return 3;
+        memory.writeZeroPage(fetch(), ac);
+        return cost();
     }
 
     cycles CPU::sta_zp_x() {
-        memory.write(fetch() + x, ac);
-        return 4;
+        memory.writeZeroPage(zeroPageIndexed(x), ac);
+        return cost();
     }
 
     cycles CPU::sta_abs() {
         memory.write(fetchWord(), ac);
-        return 4;
+        return cost();
     }
 
     cycles CPU::sta_abs_x() {
-        memory.write(fetchWord() + x, ac);
-        return 5;
+        memory.write(indexedForWrite(fetchWord(), x), ac);
+        return cost();
     }
 
     cycles CPU::sta_abs_y() {
-        memory.write(fetchWord() + y, ac);
-        return 5;
+        memory.write(indexedForWrite(fetchWord(), y), ac);
+        return cost();
     }
 
     cycles CPU::sta_ind_x() {
-        memory.write(memory.readWord(fetch() + x), ac);
-        return 6;
+        memory.write(memory.readZeroPageWord(zeroPageIndexed(x)), ac);
+        return cost();
     }
 
     cycles CPU::sta_ind_y() {
-        memory.write(memory.readWord(fetch()) + y, ac);
-        return 6;
+        memory.write(indexedForWrite(memory.readZeroPageWord(fetch()), y), ac);
+        return cost();
     }
 
     cycles CPU::stx_zp() {
-        memory.write(fetch(), x);
-        return 3;
+        memory.writeZeroPage(fetch(), x);
+        return cost();
     }
 
     cycles CPU::stx_zp_y() {
-        memory.write(fetch() + y, x);
-        return 4;
+        memory.writeZeroPage(zeroPageIndexed(y), x);
+        return cost();
     }
 
     cycles CPU::stx_abs() {
         memory.write(fetchWord(), x);
-        return 4;
+        return cost();
     }
 
     cycles CPU::sty_zp() {
-        memory.write(fetch(), y);
-        return 3;
+        memory.writeZeroPage(fetch(), y);
+        return cost();
     }
 
     cycles CPU::sty_zp_x() {
-        memory.write(fetch() + x, y);
-        return 4;
+        memory.writeZeroPage(zeroPageIndexed(x), y);
+        return cost();
     }
 
     cycles CPU::sty_abs() {
         memory.write(fetchWord(), y);
-        return 4;
+        return cost();
     }
 
     cycles CPU::tax() {
         x = ac;
         sr.z = x == 0;
         sr.n = isNegative(x);
-        return 2;
+        return cost();
     }
 
     cycles CPU::tay() {
         y = ac;
         sr.z = y == 0;
         sr.n = isNegative(y);
-        return 2;
+        return cost();
     }
 
     cycles CPU::tsx() {
         x = sp;
         sr.z = x == 0;
         sr.n = isNegative(x);
-        return 2;
+        return cost();
     }
 
     cycles CPU::txa() {
         ac = x;
         sr.z = ac == 0;
         sr.n = isNegative(ac);
-        return 2;
+        return cost();
     }
 
     cycles CPU::txs() {
         sp = x;
-        return 2;
+        return cost();
     }
 
     cycles CPU::tya() {
         ac = y;
         sr.z = ac == 0;
         sr.n = isNegative(ac);
-        return 2;
+        return cost();
     }
 
 #pragma endregion
@@ -238,24 +274,26 @@ namespace mos6502 {
 
     cycles CPU::pha() {
         push(ac);
-        return 3;
+        return cost();
     }
 
     cycles CPU::php() {
         push(*reinterpret_cast<byte*>(&sr) | 0b00110000);
-        return 3;
+        return cost();
     }
 
     cycles CPU::pla() {
+        dummyRead(0x100 | sp);
         ac = pop();
         sr.z = ac == 0;
         sr.n = isNegative(ac);
-        return 4;
+        return cost();
     }
 
     cycles CPU::plp() {
+        dummyRead(0x100 | sp);
         *reinterpret_cast<byte*>(&sr) = pop() & 0b11001111;
-        return 4;
+        return cost();
     }
 
 #pragma endregion
@@ -263,209 +301,199 @@ namespace mos6502 {
 
     cycles CPU::dec_zp() {
         const auto addr = fetch();
-        const auto value = memory.read(addr) - 1;
-        memory.write(addr, value);
+        const byte value = readModifyZeroPage(addr) - 1;
+        memory.writeZeroPage(addr, value);
         sr.z = value == 0;
         sr.n = isNegative(value);
-        return 5;
+        return cost();
     }
 
     cycles CPU::dec_zp_x() {
-        const auto addr = fetch() + x;
-        const auto value = memory.read(addr) - 1;
-        memory.write(addr, value);
+        const auto addr = zeroPageIndexed(x);
+        const byte value = readModifyZeroPage(addr) - 1;
+        memory.writeZeroPage(addr, value);
         sr.z = value == 0;
         sr.n = isNegative(value);
-        return 6;
+        return cost();
     }
 
     cycles CPU::dec_abs() {
         const auto addr = fetchWord();
-        const auto value = memory.read(addr) - 1;
+        const byte value = readModify(addr) - 1;
         memory.write(addr, value);
         sr.z = value == 0;
         sr.n = isNegative(value);
-        return 6;
+        return cost();
     }
 
     cycles CPU::dec_abs_x() {
-        const auto addr = fetchWord() + x;
-        const auto value = memory.read(addr) - 1;
+        const auto addr = indexedForWrite(fetchWord(), x);
+        const byte value = readModify(addr) - 1;
         memory.write(addr, value);
         sr.z = value == 0;
         sr.n = isNegative(value);
-        return 7;
+        return cost();
     }
 
     cycles CPU::dex() {
         x--;
         sr.z = x == 0;
         sr.n = isNegative(x);
-        return 2;
+        return cost();
     }
 
     cycles CPU::dey() {
         y--;
         sr.z = y == 0;
         sr.n = isNegative(y);
-        return 2;
+        return cost();
     }
 
     cycles CPU::inc_zp() {
         const auto addr = fetch();
-        const auto value = memory.read(addr) + 1;
-        memory.write(addr, value);
+        const byte value = readModifyZeroPage(addr) + 1;
+        memory.writeZeroPage(addr, value);
         sr.z = value == 0;
         sr.n = isNegative(value);
-        return 5;
+        return cost();
     }
 
     cycles CPU::inc_zp_x() {
-        const auto addr = fetch() + x;
-        const auto value = memory.read(addr) + 1;
-        memory.write(addr, value);
+        const auto addr = zeroPageIndexed(x);
+        const byte value = readModifyZeroPage(addr) + 1;
+        memory.writeZeroPage(addr, value);
         sr.z = value == 0;
         sr.n = isNegative(value);
-        return 6;
+        return cost();
     }
 
     cycles CPU::inc_abs() {
         const auto addr = fetchWord();
-        const auto value = memory.read(addr) + 1;
+        const byte value = readModify(addr) + 1;
         memory.write(addr, value);
         sr.z = value == 0;
         sr.n = isNegative(value);
-        return 6;
+        return cost();
     }
 
     cycles CPU::inc_abs_x() {
-        const auto addr = fetchWord() + x;
-        const auto value = memory.read(addr) + 1;
+        const auto addr = indexedForWrite(fetchWord(), x);
+        const byte value = readModify(addr) + 1;
         memory.write(addr, value);
         sr.z = value == 0;
         sr.n = isNegative(value);
-        return 7;
+        return cost();
     }
 
     cycles CPU::inx() {
         x++;
         sr.z = x == 0;
         sr.n = isNegative(x);
-        return 2;
+        return cost();
     }
 
     cycles CPU::iny() {
         y++;
         sr.z = y == 0;
         sr.n = isNegative(y);
-        return 2;
+        return cost();
     }
 
 #pragma endregion
 #pragma region Arithmetic Operations
 
     void CPU::adc(const byte value) {
-        const auto result = ac + value + sr.c;
-        sr.c = result > 0xFF;
-        sr.z = (result & 0xFF) == 0;
-        sr.v = (~(ac ^ value) & (ac ^ result) & 0x80) != 0;
-        sr.n = isNegative(result);
-        ac = result;
+        ac = alu::adc(sr, ac, value);
     }
 
     cycles CPU::adc_imm() {
         adc(fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::adc_zp() {
-        adc(memory.read(fetch()));
-        return 3;
+        adc(memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::adc_zp_x() {
-        adc(memory.read(fetch() + x));
-        return 4;
+        adc(memory.readZeroPage(zeroPageIndexed(x)));
+        return cost();
     }
 
     cycles CPU::adc_abs() {
         adc(memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::adc_abs_x() {
         const auto addr = fetchWord();
-        adc(memory.read(addr + x));
-        return isSamePage(addr, addr + x) ? 4 : 5;
+        adc(readIndexed(addr, x));
+        return cost(!isSamePage(addr, addr + x));
     }
 
     cycles CPU::adc_abs_y() {
         const auto addr = fetchWord();
-        adc(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 4 : 5;
+        adc(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     cycles CPU::adc_ind_x() {
-        adc(memory.read(memory.readWord(fetch() + x)));
-        return 6;
+        adc(memory.read(memory.readZeroPageWord(zeroPageIndexed(x))));
+        return cost();
     }
 
     cycles CPU::adc_ind_y() {
-        const auto addr = memory.readWord(fetch());
-        adc(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 5 : 6;
+        const auto addr = memory.readZeroPageWord(fetch());
+        adc(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     void CPU::sbc(const byte value) {
-        const auto result = ac - value - !sr.c;
-        sr.c = result < 0;
-        sr.z = (result & 0xFF) == 0;
-        sr.v = ((ac ^ result) & (ac ^ value) & 0x80) != 0;
-        sr.n = isNegative(result);
-        ac = result;
+        ac = alu::sbc(sr, ac, value);
     }
 
     cycles CPU::sbc_imm() {
         sbc(fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::sbc_zp() {
-        sbc(memory.read(fetch()));
-        return 3;
+        sbc(memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::sbc_zp_x() {
-        sbc(memory.read(fetch() + x));
-        return 4;
+        sbc(memory.readZeroPage(zeroPageIndexed(x)));
+        return cost();
     }
 
     cycles CPU::sbc_abs() {
         sbc(memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::sbc_abs_x() {
         const auto addr = fetchWord();
-        sbc(memory.read(addr + x));
-        return isSamePage(addr, addr + x) ? 4 : 5;
+        sbc(readIndexed(addr, x));
+        return cost(!isSamePage(addr, addr + x));
     }
 
     cycles CPU::sbc_abs_y() {
         const auto addr = fetchWord();
-        sbc(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 4 : 5;
+        sbc(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     cycles CPU::sbc_ind_x() {
-        sbc(memory.read(memory.readWord(fetch() + x)));
-        return 6;
+        sbc(memory.read(memory.readZeroPageWord(zeroPageIndexed(x))));
+        return cost();
     }
 
     cycles CPU::sbc_ind_y() {
-        const auto addr = memory.readWord(fetch());
-        sbc(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 5 : 6;
+        const auto addr = memory.readZeroPageWord(fetch());
+        sbc(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
 #pragma endregion
@@ -479,45 +507,45 @@ namespace mos6502 {
 
     cycles CPU::and_imm() {
         and_(fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::and_zp() {
-        and_(memory.read(fetch()));
-        return 3;
+        and_(memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::and_zp_x() {
-        and_(memory.read(fetch() + x));
-        return 4;
+        and_(memory.readZeroPage(zeroPageIndexed(x)));
+        return cost();
     }
 
     cycles CPU::and_abs() {
         and_(memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::and_abs_x() {
         const auto addr = fetchWord();
-        and_(memory.read(addr + x));
-        return isSamePage(addr, addr + x) ? 4 : 5;
+        and_(readIndexed(addr, x));
+        return cost(!isSamePage(addr, addr + x));
     }
 
     cycles CPU::and_abs_y() {
         const auto addr = fetchWord();
-        and_(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 4 : 5;
+        and_(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     cycles CPU::and_ind_x() {
-        and_(memory.read(memory.readWord(fetch() + x)));
-        return 6;
+        and_(memory.read(memory.readZeroPageWord(zeroPageIndexed(x))));
+        return cost();
     }
 
     cycles CPU::and_ind_y() {
-        const auto addr = memory.readWord(fetch());
-        and_(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 5 : 6;
+        const auto addr = memory.readZeroPageWord(fetch());
+        and_(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     void CPU::eor_(const byte value) {
@@ -528,45 +556,45 @@ namespace mos6502 {
 
     cycles CPU::eor_imm() {
         eor_(fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::eor_zp() {
-        eor_(memory.read(fetch()));
-        return 3;
+        eor_(memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::eor_zp_x() {
-        eor_(memory.read(fetch() + x));
-        return 4;
+        eor_(memory.readZeroPage(zeroPageIndexed(x)));
+        return cost();
     }
 
     cycles CPU::eor_abs() {
         eor_(memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::eor_abs_x() {
         const auto addr = fetchWord();
-        eor_(memory.read(addr + x));
-        return isSamePage(addr, addr + x) ? 4 : 5;
+        eor_(readIndexed(addr, x));
+        return cost(!isSamePage(addr, addr + x));
     }
 
     cycles CPU::eor_abs_y() {
         const auto addr = fetchWord();
-        eor_(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 4 : 5;
+        eor_(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     cycles CPU::eor_ind_x() {
-        eor_(memory.read(memory.readWord(fetch() + x)));
-        return 6;
+        eor_(memory.read(memory.readZeroPageWord(zeroPageIndexed(x))));
+        return cost();
     }
 
     cycles CPU::eor_ind_y() {
-        const auto addr = memory.readWord(fetch());
-        eor_(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 5 : 6;
+        const auto addr = memory.readZeroPageWord(fetch());
+        eor_(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     void CPU::ora_(const byte value) {
@@ -577,212 +605,196 @@ namespace mos6502 {
 
     cycles CPU::ora_imm() {
         ora_(fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::ora_zp() {
-        ora_(memory.read(fetch()));
-        return 3;
+        ora_(memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::ora_zp_x() {
-        ora_(memory.read(fetch() + x));
-        return 4;
+        ora_(memory.readZeroPage(zeroPageIndexed(x)));
+        return cost();
     }
 
     cycles CPU::ora_abs() {
         ora_(memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::ora_abs_x() {
         const auto addr = fetchWord();
-        ora_(memory.read(addr + x));
-        return isSamePage(addr, addr + x) ? 4 : 5;
+        ora_(readIndexed(addr, x));
+        return cost(!isSamePage(addr, addr + x));
     }
 
     cycles CPU::ora_abs_y() {
         const auto addr = fetchWord();
-        ora_(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 4 : 5;
+        ora_(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     cycles CPU::ora_ind_x() {
-        ora_(memory.read(memory.readWord(fetch() + x)));
-        return 6;
+        ora_(memory.read(memory.readZeroPageWord(zeroPageIndexed(x))));
+        return cost();
     }
 
     cycles CPU::ora_ind_y() {
-        const auto addr = memory.readWord(fetch());
-        ora_(memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 5 : 6;
+        const auto addr = memory.readZeroPageWord(fetch());
+        ora_(readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
 #pragma endregion
 #pragma region Shift & Rotate Instructions
 
     byte CPU::asl_(const byte value) {
-        sr.c = value & 0b10000000;
-        const auto result = value << 1;
-        sr.z = result == 0;
-        sr.n = isNegative(result);
-        return result;
+        return alu::asl(sr, value);
     }
 
     cycles CPU::asl_acc() {
         ac = asl_(ac);
-        return 2;
+        return cost();
     }
 
     cycles CPU::asl_zp() {
         const auto addr = fetch();
-        const auto value = memory.read(addr);
-        memory.write(addr, asl_(value));
-        return 5;
+        const auto value = readModifyZeroPage(addr);
+        memory.writeZeroPage(addr, asl_(value));
+        return cost();
     }
 
     cycles CPU::asl_zp_x() {
-        const auto addr = fetch() + x;
-        const auto value = memory.read(addr);
-        memory.write(addr, asl_(value));
-        return 6;
+        const auto addr = zeroPageIndexed(x);
+        const auto value = readModifyZeroPage(addr);
+        memory.writeZeroPage(addr, asl_(value));
+        return cost();
     }
 
     cycles CPU::asl_abs() {
         const auto addr = fetchWord();
-        const auto value = memory.read(addr);
+        const auto value = readModify(addr);
         memory.write(addr, asl_(value));
-        return 6;
+        return cost();
     }
 
     cycles CPU::asl_abs_x() {
-        const auto addr = fetchWord() + x;
-        const auto value = memory.read(addr);
+        const auto addr = indexedForWrite(fetchWord(), x);
+        const auto value = readModify(addr);
         memory.write(addr, asl_(value));
-        return 7;
+        return cost();
     }
 
     byte CPU::lsr_(const byte value) {
-        sr.c = value & 0b00000001;
-        const auto result = value >> 1;
-        sr.z = result == 0;
-        sr.n = isNegative(result);
-        return result;
+        return alu::lsr(sr, value);
     }
 
     cycles CPU::lsr_acc() {
         ac = lsr_(ac);
-        return 2;
+        return cost();
     }
 
     cycles CPU::lsr_zp() {
         const auto addr = fetch();
-        const auto value = memory.read(addr);
-        memory.write(addr, lsr_(value));
-        return 5;
+        const auto value = readModifyZeroPage(addr);
+        memory.writeZeroPage(addr, lsr_(value));
+        return cost();
     }
 
     cycles CPU::lsr_zp_x() {
-        const auto addr = fetch() + x;
-        const auto value = memory.read(addr);
-        memory.write(addr, lsr_(value));
-        return 6;
+        const auto addr = zeroPageIndexed(x);
+        const auto value = readModifyZeroPage(addr);
+        memory.writeZeroPage(addr, lsr_(value));
+        return cost();
     }
 
     cycles CPU::lsr_abs() {
         const auto addr = fetchWord();
-        const auto value = memory.read(addr);
+        const auto value = readModify(addr);
         memory.write(addr, lsr_(value));
-        return 6;
+        return cost();
     }
 
     cycles CPU::lsr_abs_x() {
-        const auto addr = fetchWord() + x;
-        const auto value = memory.read(addr);
+        const auto addr = indexedForWrite(fetchWord(), x);
+        const auto value = readModify(addr);
         memory.write(addr, lsr_(value));
-        return 7;
+        return cost();
     }
 
     byte CPU::rol_(const byte value) {
-        const auto result = (value << 1) | sr.c;
-        sr.c = value & 0b10000000;
-        sr.z = result == 0;
-        sr.n = isNegative(result);
-        return result;
+        return alu::rol(sr, value);
     }
 
     cycles CPU::rol_acc() {
         ac = rol_(ac);
-        return 2;
+        return cost();
     }
 
     cycles CPU::rol_zp() {
         const auto addr = fetch();
-        const auto value = memory.read(addr);
-        memory.write(addr, rol_(value));
-        return 5;
+        const auto value = readModifyZeroPage(addr);
+        memory.writeZeroPage(addr, rol_(value));
+        return cost();
     }
 
     cycles CPU::rol_zp_x() {
-        const auto addr = fetch() + x;
-        const auto value = memory.read(addr);
-        memory.write(addr, rol_(value));
-        return 6;
+        const auto addr = zeroPageIndexed(x);
+        const auto value = readModifyZeroPage(addr);
+        memory.writeZeroPage(addr, rol_(value));
+        return cost();
     }
 
     cycles CPU::rol_abs() {
         const auto addr = fetchWord();
-        const auto value = memory.read(addr);
+        const auto value = readModify(addr);
         memory.write(addr, rol_(value));
-        return 6;
+        return cost();
     }
 
     cycles CPU::rol_abs_x() {
-        const auto addr = fetchWord() + x;
-        const auto value = memory.read(addr);
+        const auto addr = indexedForWrite(fetchWord(), x);
+        const auto value = readModify(addr);
         memory.write(addr, rol_(value));
-        return 7;
+        return cost();
     }
 
     byte CPU::ror_(const byte value) {
-        const auto result = (value >> 1) | (sr.c << 7);
-        sr.c = value & 0b00000001;
-        sr.z = result == 0;
-        sr.n = isNegative(result);
-        return result;
+        return alu::ror(sr, value);
     }
 
     cycles CPU::ror_acc() {
         ac = ror_(ac);
-        return 2;
+        return cost();
     }
 
     cycles CPU::ror_zp() {
         const auto addr = fetch();
-        const auto value = memory.read(addr);
-        memory.write(addr, ror_(value));
-        return 5;
+        const auto value = readModifyZeroPage(addr);
+        memory.writeZeroPage(addr, ror_(value));
+        return cost();
     }
 
     cycles CPU::ror_zp_x() {
-        const auto addr = fetch() + x;
-        const auto value = memory.read(addr);
-        memory.write(addr, ror_(value));
-        return 6;
+        const auto addr = zeroPageIndexed(x);
+        const auto value = readModifyZeroPage(addr);
+        memory.writeZeroPage(addr, ror_(value));
+        return cost();
     }
 
     cycles CPU::ror_abs() {
         const auto addr = fetchWord();
-        const auto value = memory.read(addr);
+        const auto value = readModify(addr);
         memory.write(addr, ror_(value));
-        return 6;
+        return cost();
     }
 
     cycles CPU::ror_abs_x() {
-        const auto addr = fetchWord() + x;
-        const auto value = memory.read(addr);
+        const auto addr = indexedForWrite(fetchWord(), x);
+        const auto value = readModify(addr);
         memory.write(addr, ror_(value));
-        return 7;
+        return cost();
     }
 
 #pragma endregion
@@ -790,119 +802,117 @@ namespace mos6502 {
 
     cycles CPU::clc() {
         sr.c = false;
-        return 2;
+        return cost();
     }
 
     cycles CPU::cld() {
         sr.d = false;
-        return 2;
+        return cost();
     }
 
     cycles CPU::cli() {
         sr.i = false;
-        return 2;
+        return cost();
     }
 
     cycles CPU::clv() {
         sr.v = false;
-        return 2;
+        return cost();
     }
 
     cycles CPU::sec() {
         sr.c = true;
-        return 2;
+        return cost();
     }
 
     cycles CPU::sed() {
         sr.d = true;
-        return 2;
+        return cost();
     }
 
     cycles CPU::sei() {
         sr.i = true;
-        return 2;
+        return cost();
     }
 
 #pragma endregion
 #pragma region Comparisons
 
     void CPU::cmp_(const byte reg, const byte value) {
-        sr.c = reg >= value;
-        sr.z = reg == value;
-        sr.n = isNegative(reg - value);
+        alu::compare(sr, reg, value);
     }
 
     cycles CPU::cmp_imm() {
         cmp_(ac, fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::cmp_zp() {
-        cmp_(ac, memory.read(fetch()));
-        return 3;
+        cmp_(ac, memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::cmp_zp_x() {
-        cmp_(ac, memory.read(fetch() + x));
-        return 4;
+        cmp_(ac, memory.readZeroPage(zeroPageIndexed(x)));
+        return cost();
     }
 
     cycles CPU::cmp_abs() {
         cmp_(ac, memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::cmp_abs_x() {
         const auto addr = fetchWord();
-        cmp_(ac, memory.read(addr + x));
-        return isSamePage(addr, addr + x) ? 4 : 5;
+        cmp_(ac, readIndexed(addr, x));
+        return cost(!isSamePage(addr, addr + x));
     }
 
     cycles CPU::cmp_abs_y() {
         const auto addr = fetchWord();
-        cmp_(ac, memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 4 : 5;
+        cmp_(ac, readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     cycles CPU::cmp_ind_x() {
-        cmp_(ac, memory.read(memory.readWord(fetch() + x)));
-        return 6;
+        cmp_(ac, memory.read(memory.readZeroPageWord(zeroPageIndexed(x))));
+        return cost();
     }
 
     cycles CPU::cmp_ind_y() {
-        const auto addr = memory.readWord(fetch());
-        cmp_(ac, memory.read(addr + y));
-        return isSamePage(addr, addr + y) ? 5 : 6;
+        const auto addr = memory.readZeroPageWord(fetch());
+        cmp_(ac, readIndexed(addr, y));
+        return cost(!isSamePage(addr, addr + y));
     }
 
     cycles CPU::cpx_imm() {
         cmp_(x, fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::cpx_zp() {
-        cmp_(x, memory.read(fetch()));
-        return 3;
+        cmp_(x, memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::cpx_abs() {
         cmp_(x, memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
     cycles CPU::cpy_imm() {
         cmp_(y, fetch());
-        return 2;
+        return cost();
     }
 
     cycles CPU::cpy_zp() {
-        cmp_(y, memory.read(fetch()));
-        return 3;
+        cmp_(y, memory.readZeroPage(fetch()));
+        return cost();
     }
 
     cycles CPU::cpy_abs() {
         cmp_(y, memory.read(fetchWord()));
-        return 4;
+        return cost();
     }
 
 #pragma endregion
@@ -913,12 +923,19 @@ namespace mos6502 {
         const byte startPage = pc >> 8;
 
         if (condition) {
-            pc += offset;
+            dummyRead(pc);
+            const address target = pc + offset;
+            if (startPage != target >> 8) dummyRead((pc & 0xFF00) | (target & 0xFF));
+            pc = target;
         }
 
         const bool pageChanged = startPage != pc >> 8;
+        recordEdge(pc);
 
-        return 2 + (condition ? (pageChanged ? 2 : 1) : 0);
+        // after the cost is known, a copy loop run in bulk moves pc on
+        const auto spent = cost(condition + pageChanged);
+        if (condition && offset < 0) loopedBack(pc - offset - 2, pc);
+        return spent;
     }
 
     cycles CPU::bcc() {
@@ -957,74 +974,114 @@ namespace mos6502 {
 #pragma region Jumps & Subroutines
 
     cycles CPU::jmp_abs() {
+        const address closer = pc - 1;
         pc = fetchWord();
-        return 3;
+        if (pc <= closer) loopedBack(closer, pc);
+        recordEdge(pc);
+        return cost();
     }
 
     cycles CPU::jmp_ind() {
-        pc = memory.readWord(fetchWord());
-        return 5;
+        // the pointer's high byte is read without carrying into the page, so JMP ($10FF) reads $10FF and $1000
+        const address pointer = fetchWord();
+        const byte low = memory.read(pointer);
+        pc = low | (memory.read((pointer & 0xFF00) | ((pointer + 1) & 0xFF)) << 8);
+        recordEdge(pc);
+        return cost();
     }
 
     cycles CPU::jsr() {
-        const address routine = fetchWord();
+        // the high byte of the routine is fetched last, so the return address pushed is the last byte of the JSR
+        const byte low = fetch();
+        dummyRead(0x100 | sp);
         pushWord(pc);
-        pc = routine;
-        return 6;
+        pc = low | (fetch() << 8);
+        recordEdge(pc);
+        return cost();
     }
 
     cycles CPU::rts() {
-        pc = popWord();
-        return 6;
+        dummyRead(0x100 | sp);
+        const address returnAddress = popWord();
+        dummyRead(returnAddress);
+        pc = returnAddress + 1;
+        recordEdge(pc);
+        return cost();
     }
 
 #pragma endregion
 #pragma region Interrupts
 
     cycles CPU::brk() {
-        pushWord(pc + 2);
+        pushWord(pc + 1); // skips the padding byte after BRK
         push(*reinterpret_cast<byte*>(&sr) | 0b00110000);
         sr.i = true;
         pc = memory.readWord(0xFFFE);
-        return 7;
+        return cost();
     }
 
     cycles CPU::rti() {
+        dummyRead(0x100 | sp);
         *reinterpret_cast<byte*>(&sr) = pop() & 0b11001111;
         pc = popWord();
-        return 6;
+        return cost();
     }
 
 #pragma endregion
 #pragma region Other Instructions
 
     cycles CPU::bit_zp() {
-        const auto value = memory.read(fetch());
-        sr.z = (ac & value) == 0;
-        sr.v = value & 0b01000000;
-        sr.n = value & 0b10000000;
-        return 3;
+        const auto value = memory.readZeroPage(fetch());
+        alu::bit(sr, ac, value);
+        return cost();
     }
 
     cycles CPU::bit_abs() {
         const auto value = memory.read(fetchWord());
-        sr.z = (ac & value) == 0;
-        sr.v = value & 0b01000000;
-        sr.n = value & 0b10000000;
-        return 4;
+        alu::bit(sr, ac, value);
+        return cost();
     }
 
-    // ReSharper disable once CppMemberFunctionMayBeStatic
-    cycles CPU::nop() { // NOLINT(*-convert-member-functions-to-static)
-        return 2;
+    cycles CPU::nop() {
+        return cost();
     }
 
-    // ReSharper disable once CppMemberFunctionMayBeStatic
-    cycles CPU::illegal() { // NOLINT(*-convert-member-functions-to-static)
+    cycles CPU::illegal() {
+        if (hostCall && opcode == hostCallOpcode) {
+            const byte service = fetch();
+            return 2 + hostCall->call(*this, service);
+        }
         throw std::runtime_error("Illegal instruction");
         return 0;
     }
 
+#pragma endregion
+#pragma region Superinstructions
+
+    template <CPU::instruction First, byte Second, CPU::instruction Then>
+    cycles CPU::fuse() {
+        const cycles first = (this->*First)();
+        if (memory.peek(pc) != Second || cycleCount + first >= deadline) return first;
+
+        cycleCount += first;
+        ++fused;
+        opcode = fetchOpcode();
+        return execute(Then);
+    }
+
+    template <CPU::instruction First>
+    cycles CPU::fuseBranch() {
+        const cycles first = (this->*First)();
+        if ((memory.peek(pc) & 0x1F) != 0x10 || cycleCount + first >= deadline) return first;
+
+        cycleCount += first;
+        ++fused;
+        opcode = fetchOpcode();
+        // a branch tests the flag picked by bits 7-6 (N, V, C, Z) against bit 5
+        const bool flags[] = {sr.n, sr.v, sr.c, sr.z};
+        return branch_(flags[opcode >> 6] == static_cast<bool>(opcode & 0x20));
+    }
+
 #pragma endregion
 
 // define static field instructions from header file
@@ -1047,4 +1104,25 @@ const CPU::instruction CPU::instructions[256] = {
     &beq,       &sbc_ind_y, &illegal, &illegal, &illegal,   &sbc_zp_x,  &inc_zp_x,  &illegal, &sed, &sbc_abs_y, &illegal,   &illegal, &illegal,     &sbc_abs_x, &inc_abs_x, &illegal
 };
 
+const std::array<CPU::instruction, 256> CPU::superinstructions = [] {
+    std::array<instruction, 256> table;
+    std::ranges::copy(instructions, table.begin());
+
+    // loop counters and compares ahead of their branch
+    table[0xC9] = &CPU::fuseBranch<&CPU::cmp_imm>;
+    table[0xE0] = &CPU::fuseBranch<&CPU::cpx_imm>;
+    table[0xC0] = &CPU::fuseBranch<&CPU::cpy_imm>;
+    table[0xE8] = &CPU::fuseBranch<&CPU::inx>;
+    table[0xC8] = &CPU::fuseBranch<&CPU::iny>;
+    table[0xCA] = &CPU::fuseBranch<&CPU::dex>;
+    table[0x88] = &CPU::fuseBranch<&CPU::dey>;
+
+    // TXA; STA zp,X fills, LDA zp; STA zp copies, ADC; STA zp sums
+    table[0x8A] = &CPU::fuse<&CPU::txa, 0x95, &CPU::sta_zp_x>;
+    table[0xA5] = &CPU::fuse<&CPU::lda_zp, 0x85, &CPU::sta_zp>;
+    table[0x65] = &CPU::fuse<&CPU::adc_zp, 0x85, &CPU::sta_zp>;
+    table[0x69] = &CPU::fuse<&CPU::adc_imm, 0x85, &CPU::sta_zp>;
+    return table;
+}();
+
 } // mos6502
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "debugger.h"
+
+#include <algorithm>
+#include <optional>
+#include <string_view>
+
+#include "expression.h"
+
+namespace mos6502 {
+
+    // Reports accesses to watched addresses of one page and forwards every access to what was mapped before.
+    class Debugger::WatchHandler final : public PageHandler {
+        Debugger& debugger;
+        Memory& memory;
+        PageHandler* nextRead;
+        PageHandler* nextWrite;
+
+    public:
+        WatchHandler(Debugger& debugger, Memory& memory, PageHandler* nextRead, PageHandler* nextWrite)
+            : debugger(debugger), memory(memory), nextRead(nextRead), nextWrite(nextWrite) {}
+
+        [[nodiscard]] PageHandler* previousRead() const { return nextRead; }
+        [[nodiscard]] PageHandler* previousWrite() const { return nextWrite; }
+
+        byte read(const address addr) override {
+            const byte value = nextRead ? nextRead->read(addr) : memory.peek(addr);
+            debugger.watchAccess(addr, value, Access::Read);
+            return value;
+        }
+
+        void write(const address addr, const byte value) override {
+            if (nextWrite) nextWrite->write(addr, value);
+            else memory.poke(addr, value);
+            debugger.watchAccess(addr, value, Access::Write);
+        }
+    };
+
+    Debugger::Debugger(CPU& cpu) : cpu(cpu), watched(0x10000) {
+        cpu.setBreakpoints(&breakpoints);
+    }
+
+    Debugger::~Debugger() {
+        cpu.setBreakpoints(nullptr);
+
+        auto& memory = cpu.getMemory();
+        for (int page = 0; page < 256; ++page) {
+            if (const auto& handler = handlers[page]) {
+                memory.mapRead(page, handler->previousRead());
+                memory.mapWrite(page, handler->previousWrite());
+            }
+        }
+    }
+
+    void Debugger::addBreakpoint(const address addr, std::string condition) {
+        breakpoints.add(addr);
+        if (condition.empty()) conditions.erase(addr);
+        else conditions[addr] = std::move(condition);
+    }
+
+    void Debugger::removeBreakpoint(const address addr) {
+        breakpoints.remove(addr);
+        conditions.erase(addr);
+    }
+
+    void Debugger::addWatchpoint(const address first, const address last, const Access access) {
+        for (unsigned addr = first; addr <= last; ++addr) {
+            watched[addr] |= static_cast<byte>(access);
+        }
+        for (unsigned page = first >> 8; page <= last >> 8; ++page) {
+            updatePage(page);
+        }
+    }
+
+    void Debugger::removeWatchpoint(const address first, const address last, const Access access) {
+        for (unsigned addr = first; addr <= last; ++addr) {
+            watched[addr] &= ~static_cast<byte>(access);
+        }
+        for (unsigned page = first >> 8; page <= last >> 8; ++page) {
+            updatePage(page);
+        }
+    }
+
+    // maps a watch handler over the page while any of its addresses is watched, restores the page otherwise
+    void Debugger::updatePage(const byte page) {
+        auto& memory = cpu.getMemory();
+        const auto begin = watched.begin() + (page << 8);
+        const bool anyWatched = std::any_of(begin, begin + 256, [](const byte access) { return access != 0; });
+
+        auto& handler = handlers[page];
+        if (anyWatched && !handler) {
+            handler = std::make_unique<WatchHandler>(*this, memory, memory.readHandler(page), memory.writeHandler(page));
+            memory.mapRead(page, handler.get());
+            memory.mapWrite(page, handler.get());
+        } else if (!anyWatched && handler) {
+            memory.mapRead(page, handler->previousRead());
+            memory.mapWrite(page, handler->previousWrite());
+            handler.reset();
+        }
+    }
+
+    void Debugger::watchAccess(const address addr, const byte value, const Access access) {
+        if (!(watched[addr] & static_cast<byte>(access))) return;
+
+        trap = {StopReason::Watchpoint, addr, value, access};
+        trapped = true;
+        cpu.requestStop(StopReason::Watchpoint);
+    }
+
+    std::int64_t Debugger::evaluate(const std::string& expression) const {
+        const auto registers = cpu.getRegisters();
+        auto resolve = [&registers](const std::string_view name) -> std::optional<std::int64_t> {
+            if (name == "pc") return registers.pc;
+            if (name == "sp") return registers.sp;
+            if (name == "a" || name == "ac") return registers.ac;
+            if (name == "x") return registers.x;
+            if (name == "y") return registers.y;
+            if (name == "sr" || name == "p") return registers.sr;
+
+            constexpr std::string_view flags = "czidb-vn";
+            if (name.size() == 1 && name != "-" && flags.find(name[0]) != std::string_view::npos) {
+                return (registers.sr >> flags.find(name[0])) & 1;
+            }
+            return std::nullopt;
+        };
+
+        const auto value = mos6502::evaluate(expression, resolve);
+        if (!value.known) expressionError("unknown register", expression);
+        return value.value;
+    }
+
+    bool Debugger::conditionHolds(const address addr) const {
+        const auto condition = conditions.find(addr);
+        return condition == conditions.end() || evaluate(condition->second) != 0;
+    }
+
+    RunResult Debugger::step() {
+        if (cpu.isHalted()) return {StopReason::Halted, 0, 0};
+
+        trapped = false;
+        const auto start = cpu.getCycleCount();
+        cpu.step();
+
+        const auto reason = trapped ? StopReason::Watchpoint : cpu.isHalted() ? StopReason::Halted : StopReason::Budget;
+        return {reason, cpu.getCycleCount() - start, 1};
+    }
+
+    RunResult Debugger::run(const std::uint64_t budget) {
+        RunResult total{StopReason::Budget, 0, 0};
+
+        while (total.cycles < budget) {
+            // step off the breakpoint we are stopped at, it already fired or its condition did not hold
+            if (breakpoints.at(cpu.getRegisters().pc)) {
+                const auto result = step();
+                total.cycles += result.cycles;
+                total.instructions += result.instructions;
+                if (result.reason != StopReason::Budget) {
+                    total.reason = result.reason;
+                    return total;
+                }
+                continue;
+            }
+
+            trapped = false;
+            const auto result = cpu.run(budget - total.cycles);
+            total.cycles += result.cycles;
+            total.instructions += result.instructions;
+            total.reason = result.reason;
+
+            if (result.reason == StopReason::Breakpoint) {
+                const auto pc = cpu.getRegisters().pc;
+                if (conditionHolds(pc)) {
+                    trap = {StopReason::Breakpoint, pc, 0, Access::Read};
+                    return total;
+                }
+            } else {
+                return total;
+            }
+        }
+        return total;
+    }
+
+} // mos6502
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cpu.h"
+#include "breakpoints.h"
+
+namespace mos6502 {
+
+    enum class Access : byte {
+        Read = 1,
+        Write = 2,
+        ReadWrite = Read | Write,
+    };
+
+    /*
+     * Breakpoints, conditional breakpoints and watchpoints for a CPU.
+     *
+     * PC breakpoints are checked by the CPU run loop through a per-page bitmap, so pages without
+     * breakpoints cost a single table lookup per instruction. Watchpoints install page handlers only
+     * on the pages they cover and leave every other page on the plain RAM path.
+     *
+     * Conditions are expressions over the registers (pc, sp, a, x, y, sr) and flags (c, z, i, d, v, n),
+     * e.g. "x == $10 && !c"; they are only evaluated when the CPU stops at their address.
+     *
+     * Attach after mapping devices: watchpoint handlers forward to the handlers they replace.
+     */
+    class Debugger {
+    public:
+        struct Trap {
+            StopReason reason = StopReason::Budget;
+            address addr = 0;   // breakpoint or watched address
+            byte value = 0;     // byte read or written, for watchpoints
+            Access access = Access::Read;
+        };
+
+        explicit Debugger(CPU& cpu);
+        ~Debugger();
+
+        Debugger(const Debugger&) = delete;
+        Debugger& operator=(const Debugger&) = delete;
+
+        void addBreakpoint(address addr, std::string condition = {});
+        void removeBreakpoint(address addr);
+
+        void addWatchpoint(address first, address last, Access access);
+        void removeWatchpoint(address first, address last, Access access = Access::ReadWrite); // clears only `access`
+
+        // runs until a breakpoint whose condition holds or a watchpoint fires, or the budget is spent
+        RunResult run(std::uint64_t budget);
+
+        // executes one instruction, reports a watchpoint hit by it
+        RunResult step();
+
+        [[nodiscard]] const Trap& lastTrap() const { return trap; }
+
+        // evaluates `expression` against the current registers
+        [[nodiscard]] std::int64_t evaluate(const std::string& expression) const;
+
+    private:
+        class WatchHandler;
+
+        CPU& cpu;
+        Breakpoints breakpoints;
+        std::unordered_map<address, std::string> conditions;
+
+        std::vector<byte> watched;                                 // Access bits per address
+        std::array<std::unique_ptr<WatchHandler>, 256> handlers{}; // per watched page
+        Trap trap;
+        bool trapped = false;
+
+        void watchAccess(address addr, byte value, Access access);
+        void updatePage(byte page);
+        [[nodiscard]] bool conditionHolds(address addr) const;
+    };
+
+} // mos6502
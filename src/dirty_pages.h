@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.h"
+#include "memory.h"
+
+namespace mos6502 {
+
+    // Snapshots memory and tracks which pages are written afterwards, so restore() only copies those back.
+    // A page's hook unmaps itself on the first write, every later write to it runs at plain RAM speed.
+    // Pages that already have a write handler (devices) are left alone and never restored.
+    class DirtyPages final : public PageHandler {
+        Memory& memory;
+        std::vector<byte> snapshot;
+        std::array<bool, 256> hooked{};
+        std::vector<byte> dirty;
+
+        void hook() {
+            for (int page = 0; page < 256; ++page) {
+                if (hooked[page]) memory.mapWrite(page, this);
+            }
+        }
+
+    public:
+        explicit DirtyPages(Memory& memory) : memory(memory), snapshot(0x10000) {
+            dirty.reserve(256);
+            for (int page = 0; page < 256; ++page) {
+                hooked[page] = memory.writeHandler(page) == nullptr;
+            }
+            capture();
+        }
+
+        ~DirtyPages() override {
+            for (int page = 0; page < 256; ++page) {
+                if (hooked[page] && memory.writeHandler(page) == this) memory.mapWrite(page, nullptr);
+            }
+        }
+
+        DirtyPages(const DirtyPages&) = delete;
+        DirtyPages& operator=(const DirtyPages&) = delete;
+
+        // takes the current contents as the state restore() returns to
+        void capture() {
+            for (int addr = 0; addr < 0x10000; ++addr) {
+                snapshot[addr] = memory.peek(addr);
+            }
+            dirty.clear();
+            hook();
+        }
+
+        // copies back the pages written since the last capture() or restore()
+        void restore() {
+            for (const byte page : dirty) {
+                const int start = page << 8;
+                for (int addr = start; addr < start + 256; ++addr) {
+                    memory.poke(addr, snapshot[addr]);
+                }
+                memory.mapWrite(page, this);
+            }
+            dirty.clear();
+        }
+
+        [[nodiscard]] const std::vector<byte>& pages() const { return dirty; }
+
+        byte read(const address addr) override {
+            return memory.peek(addr);
+        }
+
+        void write(const address addr, const byte value) override {
+            const byte page = addr >> 8;
+            memory.mapWrite(page, nullptr);
+            dirty.push_back(page);
+            memory.poke(addr, value);
+        }
+    };
+
+} // mos6502
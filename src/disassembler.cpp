@@ -0,0 +1,146 @@
+#include "disassembler.h"
+
+#include <algorithm>
+#include <array>
+
+#include "opcodes.h"
+
+namespace mos6502 {
+
+namespace {
+
+    constexpr char hexDigits[] = "0123456789ABCDEF";
+
+    char* hexByte(char* out, const byte value) {
+        *out++ = hexDigits[value >> 4];
+        *out++ = hexDigits[value & 0xF];
+        return out;
+    }
+
+    char* hexWord(char* out, const word value) {
+        out = hexByte(out, value >> 8);
+        return hexByte(out, value & 0xFF);
+    }
+
+    char* append(char* out, const std::string_view text) {
+        for (const char c : text) *out++ = c;
+        return out;
+    }
+
+} // namespace
+
+    char* disassemble(char* out, const address pc, const byte* bytes) {
+        const auto& info = opcodes[bytes[0]];
+
+        if (info.mnemonic == Mnemonic::Illegal) {
+            out = append(out, ".byte $");
+            return hexByte(out, bytes[0]);
+        }
+
+        out = append(out, name(info.mnemonic));
+
+        const byte operand = info.length > 1 ? bytes[1] : 0;
+        const word operandWord = info.length > 2 ? operand | bytes[2] << 8 : operand;
+
+        switch (info.mode) {
+            case Mode::Implied:
+                return out;
+            case Mode::Accumulator:
+                return append(out, " A");
+            case Mode::Immediate:
+                return hexByte(append(out, " #$"), operand);
+            case Mode::ZeroPage:
+                return hexByte(append(out, " $"), operand);
+            case Mode::ZeroPageX:
+                return append(hexByte(append(out, " $"), operand), ",X");
+            case Mode::ZeroPageY:
+                return append(hexByte(append(out, " $"), operand), ",Y");
+            case Mode::Absolute:
+                return hexWord(append(out, " $"), operandWord);
+            case Mode::AbsoluteX:
+                return append(hexWord(append(out, " $"), operandWord), ",X");
+            case Mode::AbsoluteY:
+                return append(hexWord(append(out, " $"), operandWord), ",Y");
+            case Mode::Indirect:
+                return append(hexWord(append(out, " ($"), operandWord), ")");
+            case Mode::IndirectX:
+                return append(hexByte(append(out, " ($"), operand), ",X)");
+            case Mode::IndirectY:
+                return append(hexByte(append(out, " ($"), operand), "),Y");
+            case Mode::Relative:
+                return hexWord(append(out, " $"), pc + 2 + static_cast<signed char>(operand));
+        }
+        return out;
+    }
+
+namespace {
+
+    // copies the bytes of the instruction at `pc` so that operands wrap around the address space like the CPU does,
+    // peeking, so that listing code has no side effects on devices, watchpoints or access counts
+    std::array<byte, 3> instructionBytes(const Memory& memory, const address pc) {
+        return {memory.peek(pc), memory.peek(pc + 1), memory.peek(pc + 2)};
+    }
+
+    // "0200  4C 04 02  JMP $0204\n"
+    char* listingLine(char* out, const address pc, const byte* bytes, const byte length) {
+        out = append(hexWord(out, pc), "  ");
+        for (byte i = 0; i < 3; ++i) {
+            out = i < length ? append(hexByte(out, bytes[i]), " ") : append(out, "   ");
+        }
+        out = disassemble(append(out, " "), pc, bytes);
+        *out++ = '\n';
+        return out;
+    }
+
+    constexpr std::size_t maxLineLength = 16 + maxInstructionLength + 1;
+
+} // namespace
+
+    std::string disassemble(const Memory& memory, const address pc) {
+        char text[maxInstructionLength];
+        const auto bytes = instructionBytes(memory, pc);
+        return {text, disassemble(text, pc, bytes.data())};
+    }
+
+    std::string disassemble(const Memory& memory, address pc, const std::size_t count) {
+        std::string listing;
+        listing.reserve(count * maxLineLength);
+
+        char line[maxLineLength];
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto bytes = instructionBytes(memory, pc);
+            const auto length = opcodes[bytes[0]].length;
+            listing.append(line, listingLine(line, pc, bytes.data(), length));
+            pc += length;
+        }
+        return listing;
+    }
+
+    std::string disassemble(const std::span<const byte> code, const address origin) {
+        std::string listing;
+        listing.reserve(code.size() * maxLineLength);
+
+        char line[maxLineLength];
+        std::size_t offset = 0;
+        while (offset < code.size()) {
+            std::array<byte, 3> bytes{};
+            const auto available = std::min<std::size_t>(3, code.size() - offset);
+            std::copy_n(code.begin() + offset, available, bytes.begin());
+
+            const auto pc = static_cast<address>(origin + offset);
+            auto length = opcodes[bytes[0]].length;
+            char* end;
+            if (length <= available) {
+                end = listingLine(line, pc, bytes.data(), length);
+            } else {
+                // an instruction cut off by the end of the block is listed as a raw byte
+                end = append(hexByte(append(hexByte(append(hexWord(line, pc), "  "), bytes[0]), "        .byte $"), bytes[0]), "\n");
+                length = 1;
+            }
+            listing.append(line, end);
+            offset += length;
+        }
+        return listing;
+    }
+
+} // mos6502
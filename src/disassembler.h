@@ -0,0 +1,29 @@
+#pragma once
+
+#include <span>
+#include <string>
+
+#include "types.h"
+#include "memory.h"
+
+namespace mos6502 {
+
+    // longest text disassemble(char*, ...) writes for a single instruction, e.g. "LDA ($12),Y"
+    constexpr std::size_t maxInstructionLength = 16;
+
+    /*
+     * Writes the instruction at `pc`, whose opcode and operands start at `bytes`, and returns the end of the text.
+     * Does not allocate or format through fmt, so it can annotate traces of billions of instructions.
+     * The output is valid input for the assembler, illegal opcodes are written as .byte.
+     */
+    char* disassemble(char* out, address pc, const byte* bytes);
+
+    [[nodiscard]] std::string disassemble(const Memory& memory, address pc);
+
+    // listing of `count` instructions starting at `pc`, one "address  bytes  instruction" line each
+    [[nodiscard]] std::string disassemble(const Memory& memory, address pc, std::size_t count);
+
+    // listing of a whole code block loaded at `origin`
+    [[nodiscard]] std::string disassemble(std::span<const byte> code, address origin);
+
+} // mos6502
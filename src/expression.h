@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace mos6502 {
+
+    struct Value {
+        std::int64_t value = 0;
+        bool known = true; // false if the value depends on a symbol that is not defined (yet)
+    };
+
+    [[noreturn]] inline void expressionError(const std::string_view message, const std::string_view text) {
+        throw std::runtime_error(std::string(message) + " in expression '" + std::string(text) + "'");
+    }
+
+    constexpr bool isIdentifierStart(const char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.' || c == '@';
+    }
+
+    constexpr bool isIdentifierChar(const char c) {
+        return isIdentifierStart(c) || (c >= '0' && c <= '9');
+    }
+
+    /*
+     * Integer expression evaluator shared by the assembler and the debugger.
+     *
+     * Operators, loosest binding first:
+     *   ||   &&   |   ^   &   == !=   < <= > >=   << >>   + -   * / %
+     * Unary: - ~ ! < (low byte) > (high byte)
+     * Operands: 42, $2A, 0x2A, %101010, 'c', symbols, * (current location), (...)
+     *
+     * Symbols are looked up through `resolve`, a callable taking a std::string_view
+     * and returning std::optional<std::int64_t>; an empty optional marks the value as unknown.
+     */
+    template <typename Resolver>
+    class Expression {
+        std::string_view text;
+        std::size_t pos = 0;
+        std::int64_t location;
+        Resolver& resolve;
+
+        constexpr void skipSpaces() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) ++pos;
+        }
+
+        constexpr bool accept(const std::string_view token) {
+            skipSpaces();
+            if (text.substr(pos, token.size()) == token) {
+                pos += token.size();
+                return true;
+            }
+            return false;
+        }
+
+        // accepts `token` only if it is not the prefix of a longer operator
+        constexpr bool acceptOperator(const std::string_view token, const std::string_view notFollowedBy = {}) {
+            skipSpaces();
+            if (text.substr(pos, token.size()) != token) return false;
+            const auto next = pos + token.size();
+            if (next < text.size() && notFollowedBy.find(text[next]) != std::string_view::npos) return false;
+            pos = next;
+            return true;
+        }
+
+        constexpr Value binary(const int level) {
+            if (level == 10) return unary();
+
+            Value lhs = binary(level + 1);
+            while (true) {
+                const auto op = matchOperator(level);
+                if (op.empty()) return lhs;
+
+                const Value rhs = binary(level + 1);
+                lhs = {apply(op, lhs.value, rhs.value, rhs.known), lhs.known && rhs.known};
+            }
+        }
+
+        constexpr std::string_view matchOperator(const int level) {
+            switch (level) {
+                case 0: if (accept("||")) return "||"; break;
+                case 1: if (accept("&&")) return "&&"; break;
+                case 2: if (acceptOperator("|", "|")) return "|"; break;
+                case 3: if (accept("^")) return "^"; break;
+                case 4: if (acceptOperator("&", "&")) return "&"; break;
+                case 5:
+                    if (accept("==")) return "==";
+                    if (accept("!=")) return "!=";
+                    break;
+                case 6:
+                    if (accept("<=")) return "<=";
+                    if (accept(">=")) return ">=";
+                    if (acceptOperator("<", "<")) return "<";
+                    if (acceptOperator(">", ">")) return ">";
+                    break;
+                case 7:
+                    if (accept("<<")) return "<<";
+                    if (accept(">>")) return ">>";
+                    break;
+                case 8:
+                    if (accept("+")) return "+";
+                    if (accept("-")) return "-";
+                    break;
+                case 9:
+                    if (accept("*")) return "*";
+                    if (accept("/")) return "/";
+                    if (accept("%")) return "%";
+                    break;
+                default:
+                    break;
+            }
+            return {};
+        }
+
+        constexpr std::int64_t apply(const std::string_view op, const std::int64_t a, const std::int64_t b, const bool bKnown) const {
+            if (op == "||") return a || b;
+            if (op == "&&") return a && b;
+            if (op == "|") return a | b;
+            if (op == "^") return a ^ b;
+            if (op == "&") return a & b;
+            if (op == "==") return a == b;
+            if (op == "!=") return a != b;
+            if (op == "<=") return a <= b;
+            if (op == ">=") return a >= b;
+            if (op == "<") return a < b;
+            if (op == ">") return a > b;
+            if (op == "<<") return a << (b & 63);
+            if (op == ">>") return a >> (b & 63);
+            if (op == "+") return a + b;
+            if (op == "-") return a - b;
+            if (op == "*") return a * b;
+            if (b == 0) {
+                if (!bKnown) return 0;
+                expressionError("division by zero", text);
+            }
+            return op == "/" ? a / b : a % b;
+        }
+
+        constexpr Value unary() {
+            if (accept("-")) { const auto v = unary(); return {-v.value, v.known}; }
+            if (accept("~")) { const auto v = unary(); return {~v.value, v.known}; }
+            if (accept("!")) { const auto v = unary(); return {!v.value, v.known}; }
+            if (accept("<")) { const auto v = unary(); return {v.value & 0xFF, v.known}; }
+            if (accept(">")) { const auto v = unary(); return {(v.value >> 8) & 0xFF, v.known}; }
+            return primary();
+        }
+
+        constexpr Value primary() {
+            skipSpaces();
+            if (pos >= text.size()) expressionError("unexpected end", text);
+
+            const char c = text[pos];
+            if (c == '(') {
+                ++pos;
+                const auto v = binary(0);
+                if (!accept(")")) expressionError("missing ')'", text);
+                return v;
+            }
+            if (c == '*') {
+                ++pos;
+                return {location};
+            }
+            if (c == '\'') {
+                if (pos + 2 >= text.size() || text[pos + 2] != '\'') expressionError("bad character literal", text);
+                pos += 3;
+                return {static_cast<unsigned char>(text[pos - 2])};
+            }
+            if (c == '$') {
+                ++pos;
+                return {number(16)};
+            }
+            if (c == '%') {
+                ++pos;
+                return {number(2)};
+            }
+            if (c == '0' && pos + 1 < text.size() && (text[pos + 1] == 'x' || text[pos + 1] == 'X')) {
+                pos += 2;
+                return {number(16)};
+            }
+            if (c >= '0' && c <= '9') {
+                return {number(10)};
+            }
+            if (isIdentifierStart(c)) {
+                const auto start = pos;
+                while (pos < text.size() && isIdentifierChar(text[pos])) ++pos;
+                const auto value = resolve(text.substr(start, pos - start));
+                return value ? Value{*value} : Value{0, false};
+            }
+            expressionError("unexpected character", text);
+        }
+
+        constexpr std::int64_t number(const int base) {
+            std::int64_t value = 0;
+            const auto start = pos;
+            while (pos < text.size()) {
+                const char c = text[pos];
+                int digit;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                else break;
+                if (digit >= base) break;
+                value = value * base + digit;
+                ++pos;
+            }
+            if (pos == start) expressionError("malformed number", text);
+            return value;
+        }
+
+    public:
+        constexpr Expression(const std::string_view text, Resolver& resolve, const std::int64_t location = 0)
+            : text(text), location(location), resolve(resolve) {}
+
+        constexpr Value evaluate() {
+            const auto value = binary(0);
+            skipSpaces();
+            if (pos != text.size()) expressionError("unexpected trailing input", text);
+            return value;
+        }
+    };
+
+    template <typename Resolver>
+    constexpr Value evaluate(const std::string_view text, Resolver&& resolve, const std::int64_t location = 0) {
+        return Expression<std::remove_reference_t<Resolver>>(text, resolve, location).evaluate();
+    }
+
+} // mos6502
@@ -0,0 +1,442 @@
+#include "gdb_stub.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace mos6502 {
+
+namespace {
+
+    constexpr char hexDigits[] = "0123456789abcdef";
+
+    constexpr std::string_view targetDescription =
+        R"(<?xml version="1.0"?><!DOCTYPE target SYSTEM "gdb-target.dtd">)"
+        R"(<target version="1.0"><feature name="org.mos6502.core">)"
+        R"(<reg name="pc" bitsize="16" type="code_ptr" regnum="0"/>)"
+        R"(<reg name="sp" bitsize="8" type="uint8"/>)"
+        R"(<reg name="a" bitsize="8" type="uint8"/>)"
+        R"(<reg name="x" bitsize="8" type="uint8"/>)"
+        R"(<reg name="y" bitsize="8" type="uint8"/>)"
+        R"(<reg name="sr" bitsize="8" type="uint8"/>)"
+        R"(</feature></target>)";
+
+    void appendHex(std::string& out, const byte value) {
+        out += hexDigits[value >> 4];
+        out += hexDigits[value & 0xF];
+    }
+
+    // parses a hex number at the start of `text` and drops it from the view
+    std::uint32_t parseHex(std::string_view& text) {
+        std::uint32_t value = 0;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+        if (error != std::errc{}) throw std::runtime_error("malformed packet");
+        text.remove_prefix(end - text.data());
+        return value;
+    }
+
+    void expect(std::string_view& text, const char c) {
+        if (text.empty() || text.front() != c) throw std::runtime_error("malformed packet");
+        text.remove_prefix(1);
+    }
+
+    byte hexByte(std::string_view& text) {
+        if (text.size() < 2) throw std::runtime_error("malformed packet");
+        std::string_view digits = text.substr(0, 2);
+        const auto value = static_cast<byte>(parseHex(digits));
+        text.remove_prefix(2);
+        return value;
+    }
+
+    std::string frame(const std::string_view payload) {
+        byte checksum = 0;
+        for (const char c : payload) checksum += static_cast<byte>(c);
+
+        std::string packet = "$";
+        packet += payload;
+        packet += '#';
+        appendHex(packet, checksum);
+        return packet;
+    }
+
+    bool sendAll(const int socket, const std::string_view data) {
+        std::size_t sent = 0;
+        while (sent < data.size()) {
+            const auto n = ::send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += n;
+        }
+        return true;
+    }
+
+} // namespace
+
+    GdbStub::GdbStub(CPU& cpu, Debugger& debugger) : cpu(cpu), debugger(debugger) {}
+
+    GdbStub::~GdbStub() {
+        stopping = true;
+        if (connection.joinable()) connection.join();
+        if (listener != -1) ::close(listener);
+        if (!unixPath.empty()) ::unlink(unixPath.c_str());
+    }
+
+    void GdbStub::listenTcp(const std::uint16_t port) {
+        const int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (socket == -1) throw std::runtime_error("cannot create socket");
+
+        const int reuse = 1;
+        ::setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(socket, reinterpret_cast<sockaddr*>(&addr), sizeof addr) == -1) {
+            ::close(socket);
+            throw std::runtime_error("cannot bind port " + std::to_string(port));
+        }
+        start(socket);
+    }
+
+    void GdbStub::listenUnix(const std::string& path) {
+        const int socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket == -1) throw std::runtime_error("cannot create socket");
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof addr.sun_path) throw std::runtime_error("socket path too long");
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        ::unlink(path.c_str());
+        if (::bind(socket, reinterpret_cast<sockaddr*>(&addr), sizeof addr) == -1) {
+            ::close(socket);
+            throw std::runtime_error("cannot bind " + path);
+        }
+        unixPath = path;
+        start(socket);
+    }
+
+    void GdbStub::start(const int socket) {
+        if (::listen(socket, 1) == -1) {
+            ::close(socket);
+            throw std::runtime_error("cannot listen");
+        }
+        listener = socket;
+        connection = std::thread(&GdbStub::transport, this);
+    }
+
+#pragma region Connection thread
+
+    void GdbStub::transport() {
+        while (!stopping) {
+            pollfd fd{listener, POLLIN, 0};
+            if (::poll(&fd, 1, 100) <= 0) continue;
+
+            const int client = ::accept(listener, nullptr, nullptr);
+            if (client == -1) continue;
+
+            exchange(client);
+            ::close(client);
+        }
+    }
+
+    // frames packets between the socket and the queues until the client disconnects
+    void GdbStub::exchange(const int client) {
+        std::string input;
+        bool acknowledge = true;
+
+        while (!stopping) {
+            while (auto payload = replies.pop()) {
+                if (!sendAll(client, frame(*payload))) return;
+            }
+
+            pollfd fd{client, POLLIN, 0};
+            if (::poll(&fd, 1, 1) <= 0) continue;
+
+            char buffer[4096];
+            const auto received = ::recv(client, buffer, sizeof buffer, 0);
+            if (received <= 0) {
+                while (!requests.push("D")) std::this_thread::yield();
+                return;
+            }
+            input.append(buffer, received);
+
+            while (!input.empty()) {
+                if (input.front() == '\x03') {
+                    while (!requests.push("\x03")) std::this_thread::yield();
+                    input.erase(0, 1);
+                    continue;
+                }
+                if (input.front() != '$') {
+                    // acknowledgements and noise
+                    input.erase(0, 1);
+                    continue;
+                }
+
+                const auto hash = input.find('#');
+                if (hash == std::string::npos || input.size() < hash + 3) break;
+
+                std::string payload = input.substr(1, hash - 1);
+                input.erase(0, hash + 3);
+
+                if (acknowledge && !sendAll(client, "+")) return;
+
+                if (payload == "QStartNoAckMode") {
+                    sendAll(client, frame("OK"));
+                    acknowledge = false;
+                    continue;
+                }
+                while (!requests.push(std::move(payload))) std::this_thread::yield();
+            }
+        }
+    }
+
+#pragma endregion
+#pragma region Emulation thread
+
+    void GdbStub::reply(std::string payload) {
+        while (!replies.push(std::move(payload))) std::this_thread::yield();
+    }
+
+    void GdbStub::service() {
+        while (auto packet = requests.pop()) {
+            std::optional<std::string> response;
+            try {
+                response = handle(*packet);
+            } catch (const std::exception&) {
+                response = "E01";
+            }
+            if (response) reply(std::move(*response));
+        }
+    }
+
+    void GdbStub::serve(const std::uint64_t slice) {
+        while (!detached) {
+            service();
+
+            if (running) {
+                const auto result = debugger.run(slice);
+                if (result.reason != StopReason::Budget) reportStop(result);
+            } else if (!detached) {
+                requests.wait();
+            }
+        }
+    }
+
+    void GdbStub::reportStop(const RunResult& result) {
+        running = false;
+        reply(stopReply(result));
+    }
+
+    std::string GdbStub::stopReply(const RunResult& result) const {
+        switch (result.reason) {
+            case StopReason::Halted:
+                return "W00";
+            case StopReason::Watchpoint: {
+                const auto& trap = debugger.lastTrap();
+                std::string packet = trap.access == Access::Write ? "T05watch:" : "T05rwatch:";
+                appendHex(packet, trap.addr >> 8);
+                appendHex(packet, trap.addr & 0xFF);
+                return packet + ";";
+            }
+            case StopReason::Requested:
+                return "S02";
+            default:
+                return "S05";
+        }
+    }
+
+    std::optional<std::string> GdbStub::handle(const std::string_view packet) {
+        if (packet.empty()) return "";
+
+        const auto arguments = packet.substr(1);
+        switch (packet.front()) {
+            case '\x03':
+                running = false;
+                return "S02";
+            case '?':
+                return "S05";
+            case 'g':
+                return readRegisters();
+            case 'G': {
+                auto data = arguments;
+                Registers registers{};
+                registers.pc = hexByte(data);
+                registers.pc |= hexByte(data) << 8;
+                registers.sp = hexByte(data);
+                registers.ac = hexByte(data);
+                registers.x = hexByte(data);
+                registers.y = hexByte(data);
+                registers.sr = hexByte(data);
+                cpu.setRegisters(registers);
+                return "OK";
+            }
+            case 'p': {
+                auto data = arguments;
+                const auto number = parseHex(data);
+                const auto registers = readRegisters();
+                if (number > 5) return "E00";
+                return number == 0 ? registers.substr(0, 4) : registers.substr(2 + number * 2, 2);
+            }
+            case 'P':
+                return writeRegister(arguments);
+            case 'm':
+                return readMemory(arguments);
+            case 'M':
+                return writeMemory(arguments);
+            case 'c':
+            case 's': {
+                if (!arguments.empty()) {
+                    auto data = arguments;
+                    auto registers = cpu.getRegisters();
+                    registers.pc = parseHex(data);
+                    cpu.setRegisters(registers);
+                }
+                if (packet.front() == 's') return stopReply(debugger.step());
+                running = true;
+                return std::nullopt;
+            }
+            case 'k':
+                detached = true;
+                return std::nullopt;
+            case 'D':
+                detached = true;
+                running = false;
+                return "OK";
+            case 'Z':
+            case 'z':
+                return point(arguments, packet.front() == 'Z');
+            case 'H':
+                return "OK";
+            default:
+                break;
+        }
+
+        if (packet.starts_with("qSupported")) return "PacketSize=1000;qXfer:features:read+;QStartNoAckMode+";
+        if (packet == "qAttached") return "1";
+        if (packet == "qC") return "QC1";
+        if (packet == "qfThreadInfo") return "m1";
+        if (packet == "qsThreadInfo") return "l";
+
+        constexpr std::string_view features = "qXfer:features:read:target.xml:";
+        if (packet.starts_with(features)) {
+            auto data = packet.substr(features.size());
+            const auto offset = parseHex(data);
+            expect(data, ',');
+            const auto length = parseHex(data);
+            if (offset >= targetDescription.size()) return "l";
+
+            const auto chunk = targetDescription.substr(offset, length);
+            return (offset + chunk.size() < targetDescription.size() ? "m" : "l") + std::string(chunk);
+        }
+
+        return "";
+    }
+
+    std::string GdbStub::readRegisters() const {
+        const auto registers = cpu.getRegisters();
+        std::string out;
+        appendHex(out, registers.pc & 0xFF);
+        appendHex(out, registers.pc >> 8);
+        appendHex(out, registers.sp);
+        appendHex(out, registers.ac);
+        appendHex(out, registers.x);
+        appendHex(out, registers.y);
+        appendHex(out, registers.sr);
+        return out;
+    }
+
+    std::string GdbStub::writeRegister(std::string_view arguments) {
+        const auto number = parseHex(arguments);
+        expect(arguments, '=');
+
+        auto registers = cpu.getRegisters();
+        const byte low = hexByte(arguments);
+        switch (number) {
+            case 0: registers.pc = low | hexByte(arguments) << 8; break;
+            case 1: registers.sp = low; break;
+            case 2: registers.ac = low; break;
+            case 3: registers.x = low; break;
+            case 4: registers.y = low; break;
+            case 5: registers.sr = low; break;
+            default: return "E00";
+        }
+        cpu.setRegisters(registers);
+        return "OK";
+    }
+
+    // memory is accessed with peek/poke, so the debugger does not trigger device side effects or watchpoints
+    std::string GdbStub::readMemory(std::string_view arguments) const {
+        const auto addr = parseHex(arguments);
+        expect(arguments, ',');
+        const auto length = parseHex(arguments);
+
+        const auto& memory = cpu.getMemory();
+        std::string out;
+        out.reserve(length * 2);
+        for (std::uint32_t i = 0; i < length; ++i) {
+            appendHex(out, memory.peek(static_cast<address>(addr + i)));
+        }
+        return out;
+    }
+
+    std::string GdbStub::writeMemory(std::string_view arguments) {
+        const auto addr = parseHex(arguments);
+        expect(arguments, ',');
+        const auto length = parseHex(arguments);
+        expect(arguments, ':');
+
+        auto& memory = cpu.getMemory();
+        for (std::uint32_t i = 0; i < length; ++i) {
+            memory.poke(static_cast<address>(addr + i), hexByte(arguments));
+        }
+        return "OK";
+    }
+
+    std::string GdbStub::point(std::string_view arguments, const bool insert) {
+        const auto type = parseHex(arguments);
+        expect(arguments, ',');
+        const auto addr = static_cast<address>(parseHex(arguments));
+        expect(arguments, ',');
+        const auto kind = std::max<std::uint32_t>(parseHex(arguments), 1);
+        if (kind > 0x10000) return "E01";
+        const auto last = static_cast<address>(addr + kind - 1);
+
+        switch (type) {
+            case 0:
+            case 1:
+                if (insert) debugger.addBreakpoint(addr);
+                else debugger.removeBreakpoint(addr);
+                return "OK";
+            case 2:
+            case 3:
+            case 4: {
+                const auto access = type == 2 ? Access::Write : type == 3 ? Access::Read : Access::ReadWrite;
+                const auto watch = [&](const address first, const address end) {
+                    if (insert) debugger.addWatchpoint(first, end, access);
+                    else debugger.removeWatchpoint(first, end, access);
+                };
+                // a range running past $FFFF wraps around to the zero page, like the CPU's addressing
+                if (last < addr) {
+                    watch(addr, 0xFFFF);
+                    watch(0, last);
+                } else {
+                    watch(addr, last);
+                }
+                return "OK";
+            }
+            default:
+                return "";
+        }
+    }
+
+#pragma endregion
+
+} // mos6502
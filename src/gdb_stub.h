@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "cpu.h"
+#include "debugger.h"
+#include "spsc_queue.h"
+
+namespace mos6502 {
+
+    /*
+     * GDB remote serial protocol server for a CPU.
+     *
+     * The socket is served by a thread of its own that only frames packets; the packets travel to the
+     * emulation thread through lock-free queues and are interpreted there by serve(), between slices of
+     * execution, so the CPU never blocks on the connection.
+     *
+     * Registers, in `g` packet order: pc (16 bit), sp, a, x, y, sr.
+     * Supported: ? g G p P m M c s k D Z0/z0 Z1/z1 (breakpoints) Z2-Z4/z2-z4 (watchpoints), Ctrl-C.
+     */
+    class GdbStub {
+    public:
+        GdbStub(CPU& cpu, Debugger& debugger);
+        ~GdbStub();
+
+        GdbStub(const GdbStub&) = delete;
+        GdbStub& operator=(const GdbStub&) = delete;
+
+        // start accepting a debugger connection, on 127.0.0.1:port or on a Unix socket
+        void listenTcp(std::uint16_t port);
+        void listenUnix(const std::string& path);
+
+        // runs the CPU under control of the connected debugger, in slices of `slice` cycles, until it detaches
+        void serve(std::uint64_t slice = 10000);
+
+        // applies the pending commands without blocking, to call between slices of a custom run loop
+        void service();
+
+        [[nodiscard]] bool isRunning() const { return running; }
+        [[nodiscard]] bool isDetached() const { return detached; }
+
+        // to call when a slice of a custom run loop stops early
+        void reportStop(const RunResult& result);
+
+    private:
+        CPU& cpu;
+        Debugger& debugger;
+
+        // packet payloads, Ctrl-C travels as "\x03"
+        SpscQueue<std::string, 64> requests;
+        SpscQueue<std::string, 64> replies;
+
+        std::thread connection;
+        std::atomic<bool> stopping{false};
+        int listener = -1;
+        std::string unixPath;
+
+        bool running = false;
+        bool detached = false;
+
+        void start(int socket);
+        void transport();
+        void exchange(int client);
+
+        void reply(std::string payload);
+        [[nodiscard]] std::optional<std::string> handle(std::string_view packet);
+        [[nodiscard]] std::string stopReply(const RunResult& result) const;
+        [[nodiscard]] std::string readRegisters() const;
+        [[nodiscard]] std::string readMemory(std::string_view arguments) const;
+        [[nodiscard]] std::string writeMemory(std::string_view arguments);
+        [[nodiscard]] std::string writeRegister(std::string_view arguments);
+        [[nodiscard]] std::string point(std::string_view arguments, bool insert);
+    };
+
+} // mos6502
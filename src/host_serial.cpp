@@ -0,0 +1,124 @@
+#include "host_serial.h"
+
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace mos6502 {
+
+    HostSerial::HostSerial(const int input, const int output, std::function<void()> onInput)
+        : input(input), output(output), onInput(std::move(onInput)) {
+        start();
+    }
+
+    HostSerial::HostSerial(const std::string& path, std::function<void()> onInput) : onInput(std::move(onInput)) {
+        owned = ::open(path.c_str(), O_RDWR | O_NOCTTY);
+        if (owned == -1) throw std::runtime_error("cannot open " + path);
+        input = output = owned;
+        start();
+    }
+
+    HostSerial::~HostSerial() {
+        stopping = true;
+        reader.join();
+
+        while (!batch.empty() && !send()) std::this_thread::yield();
+        while (!batches.push({})) std::this_thread::yield();
+        writer.join();
+
+        if (owned != -1) ::close(owned);
+    }
+
+    void HostSerial::start() {
+        batch.reserve(batchSize);
+        reader = std::thread(&HostSerial::receive, this);
+        writer = std::thread(&HostSerial::transmit, this);
+    }
+
+#pragma region Emulation thread
+
+    bool HostSerial::write(const byte value) {
+        if (batch.size() + queued.load(std::memory_order_relaxed) >= maxQueued) {
+            if (!batch.empty()) (void)send(); // the writer may have caught up with what it was given
+            if (batch.size() + queued.load(std::memory_order_relaxed) >= maxQueued) return false;
+        }
+        batch.push_back(value);
+        if (batch.size() >= batchSize) (void)send();
+        return true;
+    }
+
+    void HostSerial::poll() {
+        if (!batch.empty() && batch.size() == lastPoll) (void)send();
+        lastPoll = batch.size();
+    }
+
+    void HostSerial::flush() {
+        if (!batch.empty()) (void)send();
+    }
+
+    // hands the batch to the writer, false if its queue is full and the batch was kept
+    bool HostSerial::send() {
+        if (batches.full()) return false;
+
+        queued.fetch_add(batch.size(), std::memory_order_relaxed);
+        (void)batches.push(std::move(batch));
+        batch = {};
+        batch.reserve(batchSize);
+        lastPoll = 0;
+        return true;
+    }
+
+#pragma endregion
+
+#pragma region Host threads
+
+    void HostSerial::receive() {
+        byte buffer[256];
+        while (!stopping) {
+            pollfd fd{input, POLLIN, 0};
+            if (::poll(&fd, 1, 100) <= 0) continue;
+
+            const auto count = ::read(input, buffer, sizeof buffer);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) {
+                closed.store(true, std::memory_order_release);
+                if (onInput) onInput();
+                return;
+            }
+
+            for (ssize_t i = 0; i < count; ++i) {
+                // a full ring waits for the guest to catch up, the host's own buffers take the rest
+                while (!received.push(buffer[i])) {
+                    if (stopping) return;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            if (onInput) onInput();
+        }
+    }
+
+    void HostSerial::transmit() {
+        bool failed = false; // after a write error output is dropped, so the guest is not held up forever
+        while (true) {
+            batches.wait();
+            while (auto chunk = batches.pop()) {
+                if (chunk->empty()) return;
+
+                for (std::size_t done = 0; !failed && done < chunk->size();) {
+                    const auto count = ::write(output, chunk->data() + done, chunk->size() - done);
+                    if (count < 0 && errno == EINTR) continue;
+                    if (count <= 0) failed = true;
+                    else done += count;
+                }
+                queued.fetch_sub(chunk->size(), std::memory_order_relaxed);
+            }
+        }
+    }
+
+#pragma endregion
+
+} // mos6502
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+#include "spsc_queue.h"
+
+namespace mos6502 {
+
+    /*
+     * The host end of an emulated serial line, on a pair of file descriptors such as stdin and stdout, a pipe or
+     * a pty.
+     *
+     * Neither side ever blocks the emulation thread. A reader thread moves input into a lock-free ring as it
+     * arrives; output is collected into batches of up to batchSize bytes that a writer thread hands to write(),
+     * so a guest sending at any baud rate costs one syscall per batch rather than per byte. A batch is also sent
+     * once output goes quiet, at the first poll() that finds it has not grown since the previous one. write()
+     * refuses bytes while maxQueued are waiting for the host, which is the guest's backpressure.
+     *
+     * Only the emulation thread may call read(), write(), poll() and flush().
+     */
+    class HostSerial {
+    public:
+        static constexpr std::size_t batchSize = 4096;
+        static constexpr std::size_t maxQueued = 64 * 1024;
+
+        // `onInput` is called on the reader thread whenever input arrives or the input ends
+        HostSerial(int input, int output, std::function<void()> onInput = {});
+
+        // opens `path` for both directions, a FIFO or a pty for example
+        explicit HostSerial(const std::string& path, std::function<void()> onInput = {});
+
+        // sends what is left and waits for it to be written
+        ~HostSerial();
+
+        HostSerial(const HostSerial&) = delete;
+        HostSerial& operator=(const HostSerial&) = delete;
+
+        [[nodiscard]] std::optional<byte> read() { return received.pop(); }
+        [[nodiscard]] bool inputPending() const { return !received.empty(); }
+
+        // the input has ended and everything in it has been read
+        [[nodiscard]] bool inputClosed() const { return closed.load(std::memory_order_acquire) && received.empty(); }
+
+        // false, and the byte is not taken, while the host side is full
+        [[nodiscard]] bool write(byte value);
+
+        void poll();
+        void flush();
+
+    private:
+        int input{};
+        int output{};
+        int owned = -1; // descriptor opened by the constructor
+        std::function<void()> onInput;
+
+        SpscQueue<byte, 4096> received;
+        std::atomic<bool> closed{false};
+
+        std::vector<byte> batch;        // being filled by write()
+        std::size_t lastPoll = 0;       // batch size at the previous poll()
+        SpscQueue<std::vector<byte>, 16> batches; // an empty batch stops the writer
+        std::atomic<std::size_t> queued{0};      // bytes handed to the writer and not yet written
+
+        std::atomic<bool> stopping{false};
+        std::thread reader;
+        std::thread writer;
+
+        void start();
+        bool send();
+        void receive();
+        void transmit();
+    };
+
+} // mos6502
@@ -0,0 +1,170 @@
+#include "host_services.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace mos6502 {
+
+    HostServices::HostServices(CPU& cpu, std::FILE* output, std::filesystem::path root)
+        : cpu(cpu), memory(cpu.getMemory()), output(output), root(std::move(root)) {}
+
+    HostServices::~HostServices() {
+        if (mapped && memory.writeHandler(port >> 8) == this) memory.mapWrite(port >> 8, previous);
+    }
+
+    void HostServices::mapPort(const address port) {
+        if (mapped) memory.mapWrite(this->port >> 8, previous);
+        this->port = port;
+        previous = memory.mapWrite(port >> 8, this);
+        mapped = true;
+    }
+
+    cycles HostServices::call(CPU& caller, const byte service) {
+        auto registers = caller.getRegisters();
+        const address block = registers.x | registers.y << 8;
+
+        Error error;
+        switch (service) {
+            case PutChar:
+                std::fputc(registers.x, output);
+                error = Ok;
+                break;
+            case Print: error = print(block); break;
+            case Copy: error = copy(block); break;
+            case Fill: error = fill(block); break;
+            case ReadFile: error = readFile(block); break;
+            case WriteFile: error = writeFile(block); break;
+            default: error = UnknownService; break;
+        }
+
+        registers.ac = error;
+        registers.sr = (registers.sr & ~0b00000001) | (error != Ok);
+        caller.setRegisters(registers);
+        return 0;
+    }
+
+    // the port page is only mapped for writes
+    byte HostServices::read(const address addr) {
+        return memory.peek(addr);
+    }
+
+    void HostServices::write(const address addr, const byte value) {
+        if (addr == port) {
+            (void)call(cpu, value);
+            return;
+        }
+        if (previous) previous->write(addr, value);
+        else memory.poke(addr, value);
+    }
+
+    word HostServices::readWord(const address addr) const {
+        return memory.peek(addr) | memory.peek(static_cast<address>(addr + 1)) << 8;
+    }
+
+    void HostServices::writeWord(const address addr, const word value) {
+        memory.poke(addr, value & 0xFF);
+        memory.poke(static_cast<address>(addr + 1), value >> 8);
+    }
+
+    HostServices::Error HostServices::print(address string) {
+        // one fwrite per run of bytes up to the end of the address space or the terminator
+        char buffer[256];
+        std::size_t length = 0;
+        for (int count = 0; count < 0x10000; ++count, ++string) {
+            const byte c = memory.peek(string);
+            if (c == 0) break;
+            buffer[length++] = static_cast<char>(c);
+            if (length == sizeof buffer) {
+                std::fwrite(buffer, 1, length, output);
+                length = 0;
+            }
+        }
+        std::fwrite(buffer, 1, length, output);
+        return Ok;
+    }
+
+    HostServices::Error HostServices::copy(const address block) {
+        const address source = readWord(block);
+        const address destination = readWord(block + 2);
+        const word length = readWord(block + 4);
+
+        // backwards when the destination starts inside the source, like memmove
+        if (static_cast<address>(destination - source) < length) {
+            for (int i = length - 1; i >= 0; --i) {
+                memory.poke(static_cast<address>(destination + i), memory.peek(static_cast<address>(source + i)));
+            }
+        } else {
+            for (int i = 0; i < length; ++i) {
+                memory.poke(static_cast<address>(destination + i), memory.peek(static_cast<address>(source + i)));
+            }
+        }
+        return Ok;
+    }
+
+    HostServices::Error HostServices::fill(const address block) {
+        const address destination = readWord(block);
+        const word length = readWord(block + 2);
+        const byte value = memory.peek(block + 4);
+        for (int i = 0; i < length; ++i) memory.poke(static_cast<address>(destination + i), value);
+        return Ok;
+    }
+
+    HostServices::Error HostServices::readFile(const address block) {
+        std::filesystem::path path;
+        if (!resolve(readWord(block), path)) return NoAccess;
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return IoError;
+
+        const address buffer = readWord(block + 2);
+        std::vector<char> data(readWord(block + 4));
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        const auto count = static_cast<word>(file.gcount());
+
+        for (word i = 0; i < count; ++i) memory.poke(static_cast<address>(buffer + i), data[i]);
+        writeWord(block + 4, count);
+        return Ok;
+    }
+
+    HostServices::Error HostServices::writeFile(const address block) {
+        std::filesystem::path path;
+        if (!resolve(readWord(block), path)) return NoAccess;
+
+        const address buffer = readWord(block + 2);
+        std::vector<char> data(readWord(block + 4));
+        for (std::size_t i = 0; i < data.size(); ++i) data[i] = static_cast<char>(memory.peek(static_cast<address>(buffer + i)));
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), static_cast<std::streamsize>(data.size()))) return IoError;
+        return Ok;
+    }
+
+    bool HostServices::resolve(address name, std::filesystem::path& path) const {
+        if (root.empty()) return false;
+
+        std::string text;
+        for (byte c; (c = memory.peek(name)) != 0 && text.size() < 255; ++name) text += static_cast<char>(c);
+
+        const std::filesystem::path relative(text);
+        if (text.empty() || relative.is_absolute() || relative.has_root_name()) return false;
+        for (const auto& part : relative) {
+            if (part == "..") return false;
+        }
+
+        // links inside the directory may point out of it, so the path is checked as the file system resolves it
+        std::error_code error;
+        const auto base = std::filesystem::canonical(root, error);
+        if (error) return false;
+        const auto resolved = std::filesystem::weakly_canonical(base / relative, error);
+        if (error || std::ranges::mismatch(base, resolved).in1 != base.end()) return false;
+        // what is left unresolved does not exist, unless it is a dangling link, which a write would follow
+        if (std::filesystem::is_symlink(std::filesystem::symlink_status(resolved, error))) return false;
+
+        path = resolved;
+        return true;
+    }
+
+} // mos6502
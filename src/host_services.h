@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+
+#include "types.h"
+#include "cpu.h"
+#include "memory.h"
+
+namespace mos6502 {
+
+    /*
+     * Standard host services for guest programs, reached either through the CPU's host call trap
+     *
+     *           .byte $02, 2        ; host call opcode, then the service number
+     *
+     * or by writing the service number to a port address mapped with mapPort() (STA port). Arguments are in X,
+     * or in a parameter block whose address is in X (low) and Y (high). On return A is 0 and carry is clear on
+     * success, A holds an error code and carry is set on failure. Memory is accessed directly, bypassing page
+     * handlers, so a service runs at host speed however much it moves.
+     *
+     *   PutChar    X = character
+     *   Print      XY -> zero-terminated string
+     *   Copy       XY -> {source, destination, length}, overlapping ranges are fine
+     *   Fill       XY -> {destination, length, value (byte)}
+     *   ReadFile   XY -> {name, buffer, length}, length is set to the bytes read
+     *   WriteFile  XY -> {name, buffer, length}, the file is replaced
+     *
+     * Words in parameter blocks are little endian. File names are zero-terminated and relative to the
+     * directory given to the constructor; without one, or with absolute or ".." names, or names that lead out of
+     * it through a symbolic link, file services fail.
+     */
+    class HostServices final : public HostCallHandler, public PageHandler {
+    public:
+        enum Service : byte {
+            PutChar = 1,
+            Print = 2,
+            Copy = 3,
+            Fill = 4,
+            ReadFile = 5,
+            WriteFile = 6,
+        };
+
+        enum Error : byte {
+            Ok = 0,
+            UnknownService = 1,
+            NoAccess = 2,
+            IoError = 3,
+        };
+
+        explicit HostServices(CPU& cpu, std::FILE* output = stdout, std::filesystem::path root = {});
+        ~HostServices() override;
+
+        HostServices(const HostServices&) = delete;
+        HostServices& operator=(const HostServices&) = delete;
+
+        // makes writes to `port` call the service written, the rest of its page keeps working as before
+        void mapPort(address port);
+
+        cycles call(CPU& cpu, byte service) override;
+
+        byte read(address addr) override;
+        void write(address addr, byte value) override;
+
+    private:
+        CPU& cpu;
+        Memory& memory;
+        std::FILE* output;
+        std::filesystem::path root;
+
+        bool mapped = false;
+        address port = 0;
+        PageHandler* previous{}; // the port page's write handler before mapPort()
+
+        [[nodiscard]] word readWord(address addr) const;
+        void writeWord(address addr, word value);
+
+        [[nodiscard]] Error print(address string);
+        [[nodiscard]] Error copy(address block);
+        [[nodiscard]] Error fill(address block);
+        [[nodiscard]] Error readFile(address block);
+        [[nodiscard]] Error writeFile(address block);
+        [[nodiscard]] bool resolve(address name, std::filesystem::path& path) const;
+    };
+
+} // mos6502
@@ -1,32 +1,482 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
 #include "cpu.h"
+#include "access_stats.h"
+#include "acia6551.h"
+#include "aot_core.h"
+#include "assembler.h"
+#include "bank_switch.h"
+#include "debugger.h"
+#include "host_serial.h"
+#include "host_services.h"
+#include "options.h"
+#include "pacer.h"
+#include "profiler.h"
+#include "save_state.h"
+#include "scheduler.h"
+#include "tick_core.h"
+#include "tracer.h"
+#include "via6522.h"
+
+#ifdef __unix__
+#include <unistd.h>
+
+#include "gdb_stub.h"
+#endif
+
+namespace {
+
+    using namespace mos6502;
+
+    constexpr auto fill = assemble<R"(
+            .org $0200
+            LDX #$00
+            STX $00
+
+    loop:   CPX #$0A
+            BEQ exit
+            TXA
+            STA $10,X
+            INX
+            JMP loop
+
+    exit:   BRK
+    )">();
+
+    struct Instance {
+        std::unique_ptr<CPU> cpu = std::make_unique<CPU>();
+        std::unique_ptr<TickCore> tick;           // drives cpu with --backend tick
+        std::unique_ptr<Scheduler::Event> input; // notified when input arrives for a blocked instance
+        std::unique_ptr<Pacer> pacer;             // with --clock
+        std::unique_ptr<HostServices> host;       // with --host-trap or --host-port
+        std::unique_ptr<BankSwitch> banks;        // with --bank-window
+        std::unique_ptr<Via6522> via;             // with --via
+        std::unique_ptr<Acia6551> acia;           // with --acia
+        std::unique_ptr<AotCore> aot;             // drives cpu with --backend aot, after the devices it forwards writes to
+        HostSerial* serial{};                     // the ACIA's host side, instance 0 only
+        std::unique_ptr<AccessStats> stats;       // with --access-stats, instance 0 only
+        RunResult result{StopReason::Budget, 0, 0};
+        bool repeated{};                          // stopped by --stop-on-repeat
+        std::string error;
+    };
+
+    // Notices when the states a run passes through start to repeat, by Brent's algorithm: it keeps one state
+    // and replaces it with the current one whenever twice as many states as the last time have gone by, so a
+    // single hash is enough to catch a cycle within a few times its length.
+    class RepeatDetector {
+        std::uint64_t kept{};
+        bool keeping = false;
+        std::uint64_t seen = 0;
+        std::uint64_t interval = 1;
+
+    public:
+        bool repeated(const std::uint64_t state) {
+            if (keeping && state == kept) return true;
+            if (++seen >= interval) {
+                kept = state;
+                keeping = true;
+                seen = 0;
+                interval *= 2;
+            }
+            return false;
+        }
+    };
+
+    Program loadProgram(const Options& options) {
+        if (options.rom.empty()) return fill.program();
+
+        std::ifstream file(options.rom, std::ios::binary);
+        if (!file) throw std::runtime_error("cannot open " + options.rom);
+        std::vector<byte> contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+        if (options.rom.ends_with(".s") || options.rom.ends_with(".asm")) {
+            auto program = assemble(std::string_view(reinterpret_cast<const char*>(contents.data()), contents.size()));
+            if (options.load) program.origin = *options.load;
+            if (options.entry) program.entryPoint = *options.entry;
+            return program;
+        }
+
+        if (*options.load + contents.size() > 0x10000) throw std::runtime_error("ROM does not fit in memory");
+        return Program(std::move(contents), options.entry.value_or(*options.load), *options.load);
+    }
+
+    // the devices of an instance that go into its save state
+    std::vector<StatefulDevice*> statefulDevices(const Instance& instance) {
+        std::vector<StatefulDevice*> devices;
+        if (instance.banks) devices.push_back(instance.banks.get());
+        if (instance.via) devices.push_back(instance.via.get());
+        if (instance.acia) devices.push_back(instance.acia.get());
+        return devices;
+    }
+
+    // loads the physical image, then the program over it, and attaches what the options ask for; devices are
+    // mapped after loading, so the program's own bytes are not taken for their registers. A restored state
+    // takes the place of both, once the devices it covers are attached.
+    void prepare(Instance& instance, const Program& program, const Options& options) {
+        CPU& cpu = *instance.cpu;
+        if (!options.physicalImage.empty()) {
+            std::ifstream file(options.physicalImage, std::ios::binary);
+            if (!file) throw std::runtime_error("cannot open " + options.physicalImage);
+            const auto size = cpu.getMemory().physicalSize();
+            file.read(reinterpret_cast<char*>(cpu.getMemory().physical()), static_cast<std::streamsize>(size));
+            if (file.peek() != std::ifstream::traits_type::eof()) {
+                throw std::runtime_error(options.physicalImage + " does not fit in physical memory");
+            }
+        }
+        if (options.restoreState.empty()) cpu.load(program);
+        if (instance.stats) cpu.getMemory().setAccessStats(instance.stats.get());
+
+        if (options.hostTrap || options.hostPort) {
+            instance.host = std::make_unique<HostServices>(cpu, stdout, options.hostDirectory);
+            if (options.hostTrap) cpu.setHostCall(instance.host.get(), *options.hostTrap);
+            if (options.hostPort) instance.host->mapPort(*options.hostPort);
+        }
+        if (options.clock) instance.pacer = std::make_unique<Pacer>(options.clock, options.clock / 1000);
+
+        if (options.bankWindow) {
+            instance.banks = std::make_unique<BankSwitch>(cpu.getMemory(), *options.bankWindow, options.bankSize, *options.bankRegister);
+        }
+        if (options.via) instance.via = std::make_unique<Via6522>(cpu, *options.via);
+        if (options.acia) {
+            const auto clock = options.clock ? options.clock : 1'000'000;
+            instance.acia = std::make_unique<Acia6551>(cpu, *options.acia, instance.serial, clock);
+            // a scheduled instance waiting for input gives up its thread until the host has some
+            if (instance.serial && instance.input) instance.acia->setBlockWhenIdle(256);
+        }
+
+        if (!options.restoreState.empty()) restoreState(options.restoreState, cpu, statefulDevices(instance));
+        if (options.stateHash) cpu.getMemory().setHashing(true);
+
+        if (options.backend == Backend::Aot) {
+#ifdef MOS6502_AOT
+            instance.aot = std::make_unique<AotCore>(cpu, AotCore::recompiled());
+#else
+            throw std::runtime_error("--backend aot needs the 6502_aot build, see MOS6502_AOT_ROM");
+#endif
+        }
+    }
+
+    // runs at full speed in as few slices as the limits allow, `core` is the CPU itself or a TickCore driving it
+    template <typename Core>
+    RunResult runLimited(Core& core, const std::uint64_t cycleLimit, const std::uint64_t instructionLimit) {
+        constexpr auto unlimited = std::numeric_limits<std::uint64_t>::max();
+        RunResult total{StopReason::Budget, 0, 0};
+
+        while (total.cycles < cycleLimit && total.instructions < instructionLimit) {
+            // every instruction takes at least 2 cycles, so this budget cannot overshoot the instruction limit
+            const auto remaining = instructionLimit - total.instructions;
+            const auto budget = std::min(cycleLimit - total.cycles, remaining > unlimited / 2 ? unlimited : 2 * remaining - 1);
+
+            const auto result = core.run(budget);
+            total.cycles += result.cycles;
+            total.instructions += result.instructions;
+            if (result.reason != StopReason::Budget) {
+                total.reason = result.reason;
+                break;
+            }
+        }
+        return total;
+    }
+
+    // one instruction at a time, feeding the tracer and profiler
+    template <typename Core>
+    RunResult runObserved(CPU& cpu, Core& core, const Options& options, Tracer* tracer, Profiler* profiler, Pacer* pacer) {
+        RunResult total{StopReason::Budget, 0, 0};
+        std::uint64_t paced = 0;
+
+        while (total.cycles < options.cycleLimit && total.instructions < options.instructionLimit) {
+            const auto pc = cpu.getRegisters().pc;
+            const auto opcode = cpu.getMemory().peek(pc);
 
-int main() {
+            if (tracer) tracer->record(cpu);
+            const auto elapsed = core.step();
+            if (cpu.isHalted()) {
+                total.reason = StopReason::Halted;
+                break;
+            }
+            if (profiler) profiler->record(pc, opcode, elapsed);
+
+            total.cycles += elapsed;
+            ++total.instructions;
+
+            if (pacer && total.cycles - paced >= pacer->sliceCycles()) {
+                pacer->sleep(total.cycles);
+                paced = total.cycles;
+            }
+        }
+        return total;
+    }
+
+    // one instance as a scheduler task: a quantum or pacing slice at a time, yielding in between and sleeping
+    // while blocked
+    Scheduler::Task runScheduled(Scheduler& scheduler, Instance& instance, const Program& program, const Options& options) {
+        auto& total = instance.result;
+        RepeatDetector repeats;
+        try {
+            prepare(instance, program, options);
+
+            while (total.cycles < options.cycleLimit && total.instructions < options.instructionLimit) {
+                const auto slice = instance.pacer ? instance.pacer->sliceCycles() : options.quantum;
+                const auto budget = std::min(slice, options.cycleLimit - total.cycles);
+                const auto limit = options.instructionLimit - total.instructions;
+                const auto result = instance.tick ? runLimited(*instance.tick, budget, limit)
+                    : instance.aot ? runLimited(*instance.aot, budget, limit)
+                    : runLimited(*instance.cpu, budget, limit);
+                total.cycles += result.cycles;
+                total.instructions += result.instructions;
+
+                if (result.reason == StopReason::Blocked) {
+                    co_await instance.input->wait();
+                } else if (result.reason != StopReason::Budget) {
+                    total.reason = result.reason;
+                    break;
+                } else if (options.stopOnRepeat && repeats.repeated(instance.cpu->stateHash())) {
+                    // with nothing outside the CPU and memory, the run would go round the same states forever
+                    instance.repeated = true;
+                    break;
+                } else if (instance.pacer) {
+                    co_await scheduler.sleepUntil(instance.pacer->next(total.cycles));
+                    instance.pacer->resumed();
+                } else {
+                    co_await scheduler.yield();
+                }
+            }
+        } catch (const std::exception& e) {
+            instance.error = e.what();
+        }
+    }
+
+    // the traced or profiled instance, on the calling thread
+    void runInstance(Instance& instance, const Program& program, const Options& options, Tracer* tracer, Profiler* profiler) {
+        try {
+            prepare(instance, program, options);
+            const auto run = [&](auto& core) {
+                return runObserved(*instance.cpu, core, options, tracer, profiler, instance.pacer.get());
+            };
+            instance.result = instance.tick ? run(*instance.tick) : instance.aot ? run(*instance.aot) : run(*instance.cpu);
+        } catch (const std::exception& e) {
+            instance.error = e.what();
+        }
+    }
+
+#ifdef __unix__
+    // the host side of instance 0's ACIA, stdin and stdout unless --serial names something else
+    std::unique_ptr<HostSerial> openSerial(const Options& options, Instance& instance) {
+        if (!options.acia) return nullptr;
+
+        auto onInput = [input = instance.input.get()] {
+            if (input) input->notify();
+        };
+        auto serial = options.serial.empty()
+            ? std::make_unique<HostSerial>(STDIN_FILENO, STDOUT_FILENO, onInput)
+            : std::make_unique<HostSerial>(options.serial, onInput);
+        instance.serial = serial.get();
+        return serial;
+    }
+
+    void runUnderGdb(Instance& instance, const Program& program, const Options& options) {
+        prepare(instance, program, options);
+
+        Debugger debugger(*instance.cpu);
+        GdbStub stub(*instance.cpu, debugger);
+        if (options.gdbPort) stub.listenTcp(*options.gdbPort);
+        else stub.listenUnix(options.gdbSocket);
+
+        fmt::println(stderr, "waiting for GDB on {}",
+            options.gdbPort ? fmt::format("127.0.0.1:{}", *options.gdbPort) : options.gdbSocket);
+        stub.serve();
+
+        instance.result = {instance.cpu->isHalted() ? StopReason::Halted : StopReason::Requested,
+                           instance.cpu->getCycleCount(), 0};
+    }
+#endif
+
+    const char* name(const StopReason reason) {
+        switch (reason) {
+            case StopReason::Budget: return "limit";
+            case StopReason::Halted: return "halted";
+            case StopReason::Breakpoint: return "breakpoint";
+            case StopReason::Watchpoint: return "watchpoint";
+            case StopReason::Requested: return "requested";
+            case StopReason::Blocked: return "blocked";
+        }
+        return "?";
+    }
+
+    std::string escape(const std::string_view text) {
+        std::string escaped;
+        for (const char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            if (static_cast<unsigned char>(c) < 0x20) escaped += fmt::format("\\u{:04x}", c);
+            else escaped += c;
+        }
+        return escaped;
+    }
+
+    void writeJson(std::FILE* out, const Options& options, const std::vector<Instance>& instances, const double seconds) {
+        std::uint64_t cycles = 0;
+        std::uint64_t instructions = 0;
+        for (const auto& instance : instances) {
+            cycles += instance.result.cycles;
+            instructions += instance.result.instructions;
+        }
+
+        fmt::print(out, "{{\n");
+        fmt::print(out, "  \"backend\": \"{}\",\n", name(options.backend));
+        fmt::print(out, "  \"instances\": {},\n", instances.size());
+        fmt::print(out, "  \"seconds\": {:.6f},\n", seconds);
+        fmt::print(out, "  \"cycles\": {},\n", cycles);
+        fmt::print(out, "  \"instructions\": {},\n", instructions);
+        fmt::print(out, "  \"mhz\": {:.3f},\n", seconds > 0 ? cycles / seconds / 1e6 : 0.0);
+        fmt::print(out, "  \"results\": [");
+
+        for (std::size_t i = 0; i < instances.size(); ++i) {
+            const auto& [cpu, tick, input, pacer, host, banks, via, acia, aot, serial, stats, result, repeated, error] = instances[i];
+            const auto registers = cpu->getRegisters();
+            const char* stop = !error.empty() ? "error" : repeated ? "repeated" : name(result.reason);
+            fmt::print(out, "{}\n    {{\"stop\": \"{}\", \"cycles\": {}, \"instructions\": {}, ",
+                i ? "," : "", stop, result.cycles, result.instructions);
+            fmt::print(out, "\"registers\": {{\"pc\": {}, \"sp\": {}, \"a\": {}, \"x\": {}, \"y\": {}, \"sr\": {}}}",
+                registers.pc, registers.sp, registers.ac, registers.x, registers.y, registers.sr);
+            if (options.stateHash) fmt::print(out, ", \"state_hash\": \"{:016x}\"", cpu->stateHash());
+            if (pacer) {
+                const auto stats = pacer->stats();
+                fmt::print(out, ", \"pacing\": {{\"mhz\": {:.6f}, \"slices\": {}, \"late_slices\": {}, "
+                    "\"mean_lateness_us\": {:.1f}, \"max_lateness_us\": {:.1f}, \"resyncs\": {}}}",
+                    stats.mhz, stats.slices, stats.lateSlices, stats.meanLateness.count() / 1e3,
+                    stats.maxLateness.count() / 1e3, stats.resyncs);
+            }
+            if (!error.empty()) fmt::print(out, ", \"error\": \"{}\"", escape(error));
+            fmt::print(out, "}}");
+        }
+        fmt::print(out, "\n  ]\n}}\n");
+    }
+
+    std::FILE* openOutput(const std::string& path) {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) throw std::runtime_error("cannot write " + path);
+        return file;
+    }
+
+} // namespace
+
+int main(const int argc, const char* const* argv) {
     using namespace mos6502;
 
-    const Program fill{
-        {
-            0xA2, 0x00, // LDX #$00
-            0x86, 0x00, // STX $00
+    Options options;
+    try {
+        options = parseArguments(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        fmt::println(stderr, "{}\n\n{}", e.what(), usage(argv[0]));
+        return 2;
+    }
+
+    if (options.help) {
+        fmt::print("{}", usage(argv[0]));
+        return 0;
+    }
+
+    try {
+        const auto program = loadProgram(options);
+        std::vector<Instance> instances(options.instances);
+        if (options.physicalMemory != 0x10000) {
+            for (auto& instance : instances) instance.cpu = std::make_unique<CPU>(256, options.physicalMemory);
+        }
+        if (options.backend == Backend::Tick) {
+            for (auto& instance : instances) instance.tick = std::make_unique<TickCore>(*instance.cpu);
+        }
+        if (!options.accessStats.empty()) instances.front().stats = std::make_unique<AccessStats>();
+
+        const auto start = std::chrono::steady_clock::now();
+
+        if (options.gdbPort || !options.gdbSocket.empty()) {
+#ifdef __unix__
+            const auto serial = openSerial(options, instances.front());
+            runUnderGdb(instances.front(), program, options);
+#else
+            throw std::runtime_error("GDB support needs a Unix platform");
+#endif
+        } else {
+            std::unique_ptr<Tracer> tracer;
+            std::FILE* traceFile = nullptr;
+            if (!options.trace.empty()) {
+                traceFile = openOutput(options.trace);
+                tracer = std::make_unique<Tracer>(traceFile);
+            }
+            auto profiler = options.profile.empty() ? nullptr : std::make_unique<Profiler>();
+
+            // an observed instance runs here one instruction at a time, all others share the scheduler's threads
+            const bool observed = tracer || profiler;
+            const auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+            Scheduler scheduler(std::min<std::size_t>(threads, instances.size() - observed));
+            for (std::size_t i = observed; i < instances.size(); ++i) {
+                instances[i].input = std::make_unique<Scheduler::Event>(scheduler);
+            }
+#ifdef __unix__
+            auto serial = openSerial(options, instances.front());
+#else
+            if (options.acia) throw std::runtime_error("the ACIA needs a Unix platform");
+#endif
+            for (std::size_t i = observed; i < instances.size(); ++i) {
+                scheduler.spawn(runScheduled(scheduler, instances[i], program, options));
+            }
+            if (observed) runInstance(instances.front(), program, options, tracer.get(), profiler.get());
+            scheduler.wait();
+#ifdef __unix__
+            serial.reset(); // its output goes out before the results
+#endif
+
+            tracer.reset();
+            if (traceFile) std::fclose(traceFile);
+
+            if (profiler) {
+                std::FILE* profileFile = openOutput(options.profile);
+                profiler->write(profileFile, instances.front().cpu->getMemory());
+                std::fclose(profileFile);
+            }
+        }
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-            // loop
-            0xE0, 0x0A, // CPX #$0A
-            0xF0, 0x07, // BEQ exit
-            0x8A,       // TXA
-            0x95, 0x10, // STA $10,X
-            0xE8,       // INX
-            0x4C, 0x04, 0x02, // JMP loop
+        if (const auto& stats = instances.front().stats) {
+            std::FILE* statsFile = openOutput(options.accessStats);
+            if (options.accessStats.ends_with(".png")) stats->writePng(statsFile);
+            else stats->writeBinary(statsFile);
+            std::fclose(statsFile);
+        }
 
-            // exit
-            0x00
+        if (!options.saveState.empty()) {
+            const auto& first = instances.front();
+            saveState(options.saveState, *first.cpu, statefulDevices(first));
+        }
 
-        }, 0x0200};
+        for (const auto page : options.dumpPages) {
+            std::fputs(instances.front().cpu->getMemory().dump(page).c_str(), stderr);
+        }
 
-    CPU cpu;
-    cpu.run(fill);
-    const auto& mem = cpu.getMemory();
+        std::FILE* out = options.json.empty() ? stdout : openOutput(options.json);
+        writeJson(out, options, instances, elapsed.count());
+        if (out != stdout) std::fclose(out);
 
-    mem.print(0);
-    mem.print(2);
+        for (const auto& instance : instances) {
+            if (!instance.error.empty()) return 1;
+        }
+    } catch (const std::exception& e) {
+        fmt::println(stderr, "error: {}", e.what());
+        return 1;
+    }
 
     return 0;
 }
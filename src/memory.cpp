@@ -1,55 +1,214 @@
 #include "memory.h"
 
+#include <algorithm>
+#include <cstring>
 #include <ranges>
+#include <stdexcept>
+#include <utility>
 
 #include <fmt/core.h>
 
 namespace mos6502 {
 
-    Memory::Memory(const byte pages) {
-        memory = std::vector<byte>(pages * 256);
+    Memory::Memory(const word pages, const std::size_t physicalSize)
+        : storageSize(std::max<std::size_t>(0x10000, (physicalSize + 0xFF) & ~std::size_t{0xFF})),
+          storage(new byte[storageSize](), ReleaseStore{}), pageCount(pages) {
+        if (pages == 0 || pages > 256) throw std::invalid_argument("memory must have between 1 and 256 pages");
+        mapPhysical(0, 256, 0);
     }
 
-    byte Memory::read(const address addr) const {
-        return memory[addr];
+    void Memory::ReleaseStore::operator()(byte* store) const {
+        if (release) release(store, size);
+        else delete[] store;
     }
 
-    [[nodiscard]] word Memory::readWord(const address addr) const {
-        return memory[addr] | (memory[addr + 1] << 8);
+    void Memory::adoptStore(byte* store, const std::size_t size, const StoreRelease release) {
+        if (size < 0x10000 || size % 256) {
+            release(store, size);
+            throw std::invalid_argument("a physical store must be whole pages and at least 64 KiB");
+        }
+        storage = std::unique_ptr<byte[], ReleaseStore>(store, ReleaseStore{release, size});
+        storageSize = size;
+        mapPhysical(0, 256, 0);
+        if (hashing) hash = computeHash();
+    }
+
+    byte Memory::slowRead(const address addr, const bool opcode) const {
+        if (stats) ++(opcode ? stats->executes : stats->reads)[addr];
+        const byte value = readHandlers[addr >> 8] ? readHandlers[addr >> 8]->read(addr) : peek(addr);
+#ifdef MOS6502_BUS_LOG
+        if (busLog) busLog->push_back({addr, value, false});
+#endif
+        return value;
+    }
+
+    void Memory::slowWrite(const address addr, const byte value) {
+        if (stats) ++stats->writes[addr];
+#ifdef MOS6502_BUS_LOG
+        if (busLog) busLog->push_back({addr, value, true});
+#endif
+        if (PageHandler* handler = writeHandlers[addr >> 8]) handler->write(addr, value);
+        else if (!readOnly[addr >> 8]) poke(addr, value);
     }
 
-    void Memory::write(const address addr, const byte value) {
-        memory[addr] = value;
+    // the high byte of a word at $FFFF comes from $0000
+    [[nodiscard]] word Memory::readWord(const address addr) const {
+        const byte low = read(addr);
+        return low | (read(static_cast<address>(addr + 1)) << 8);
     }
 
     void Memory::writeWord(const address addr, const word value) {
-        memory[addr] = value & 0xFF;
-        memory[addr + 1] = value >> 8;
+        write(addr, value & 0xFF);
+        write(static_cast<address>(addr + 1), value >> 8);
     }
 
     void Memory::write(const address addr, const std::vector<byte>& data) {
         for (auto [i, b] : data | std::views::enumerate) {
-            write(addr + i, b);
+            write(static_cast<address>(addr + i), b);
+        }
+    }
+
+namespace {
+
+    // the length of the run from `offset` that stays within one page on both sides
+    std::uint32_t runLength(const address a, const address b, const std::uint32_t offset, const std::uint32_t count) {
+        const auto toPageEnd = [offset](const address base) { return 0x100u - ((base + offset) & 0xFF); };
+        return std::min({toPageEnd(a), toPageEnd(b), count - offset});
+    }
+
+    // where byte `offset` from `base` is in the store, nullptr unless its page goes straight there
+    byte* direct(const std::array<byte*, 256>& table, const address base, const std::uint32_t offset) {
+        const auto addr = static_cast<address>(base + offset);
+        byte* page = table[addr >> 8];
+        return page ? page + (addr & 0xFF) : nullptr;
+    }
+
+} // namespace
+
+    bool Memory::copy(const address to, const address from, const word count) {
+        for (std::uint32_t i = 0; i < count; i += runLength(to, from, i, count)) {
+            if (!direct(readable, from, i) || !direct(writable, to, i)) return false;
+        }
+
+        // a byte written before it is read would be copied twice over, which a bulk copy does not do
+        for (std::uint32_t i = 0; i < count; i += runLength(to, to, i, count)) {
+            const byte* written = direct(writable, to, i);
+            const auto writtenLength = runLength(to, to, i, count);
+            for (std::uint32_t j = 0; j < count; j += runLength(from, from, j, count)) {
+                const byte* read = direct(readable, from, j);
+                if (read < written + writtenLength && written < read + runLength(from, from, j, count)) return false;
+            }
+        }
+
+        for (std::uint32_t i = 0; i < count; i += runLength(to, from, i, count)) {
+            std::memcpy(direct(writable, to, i), direct(readable, from, i), runLength(to, from, i, count));
         }
+        return true;
     }
 
-    [[nodiscard]] byte Memory::getSize() const {
-        return memory.size();
+    bool Memory::fill(const address to, const byte value, const word count) {
+        for (std::uint32_t i = 0; i < count; i += runLength(to, to, i, count)) {
+            if (!direct(writable, to, i)) return false;
+        }
+        for (std::uint32_t i = 0; i < count; i += runLength(to, to, i, count)) {
+            std::memset(direct(writable, to, i), value, runLength(to, to, i, count));
+        }
+        return true;
     }
 
-    [[nodiscard]] byte Memory::getPageCount() const {
-        return memory.size() / 256;
+    PageHandler* Memory::mapRead(const byte page, PageHandler* handler) {
+        const auto previous = std::exchange(readHandlers[page], handler);
+        updateDirect(page);
+        return previous;
     }
 
-    void Memory::print(byte page) const  {
+    PageHandler* Memory::mapWrite(const byte page, PageHandler* handler) {
+        const auto previous = std::exchange(writeHandlers[page], handler);
+        updateDirect(page);
+        return previous;
+    }
+
+    void Memory::mapPhysical(const byte first, const word count, const std::size_t physical, const bool writable) {
+        if (physical & 0xFF) throw std::invalid_argument("physical address must be page aligned");
+        if (first + count > 256 || physical + count * 256 > storageSize) {
+            throw std::out_of_range("mapping runs past the end of memory");
+        }
+        for (word i = 0; i < count; ++i) {
+            const auto page = static_cast<byte>(first + i);
+            if (hashing) hash ^= pageKey(page, physicalOffset(page), readOnly[page]) ^ pageKey(page, physical + i * 256, !writable);
+            pages[page] = storage.get() + physical + i * 256;
+            readOnly[page] = !writable;
+            updateDirect(page);
+        }
+    }
+
+    void Memory::setHashing(const bool enabled) {
+        hashing = enabled;
+        if (hashing) hash = computeHash();
+        updateDirect();
+    }
+
+    std::uint64_t Memory::computeHash() const {
+        std::uint64_t result = 0;
+        for (std::size_t offset = 0; offset < storageSize; ++offset) result ^= byteKey(offset, storage[offset]);
+        for (int page = 0; page < 256; ++page) result ^= pageKey(page, physicalOffset(page), readOnly[page]);
+        return result;
+    }
+
+    void Memory::setAccessStats(AccessStats* counters) {
+        stats = counters;
+        updateDirect();
+    }
+
+#ifdef MOS6502_BUS_LOG
+    void Memory::setBusLog(std::vector<BusCycle>* log) {
+        busLog = log;
+        updateDirect();
+    }
+#endif
+
+    void Memory::updateDirect(const byte page) {
+        bool observed = stats;
+#ifdef MOS6502_BUS_LOG
+        observed = observed || busLog;
+#endif
+        readable[page] = observed || readHandlers[page] ? nullptr : pages[page];
+        writable[page] = observed || hashing || writeHandlers[page] || readOnly[page] ? nullptr : pages[page];
+        readInPlace[page] = readable[page] == storage.get() + page * 256;
+        writeInPlace[page] = writable[page] == storage.get() + page * 256;
+    }
+
+    void Memory::updateDirect() {
+        for (int page = 0; page < 256; ++page) updateDirect(static_cast<byte>(page));
+    }
+
+    [[nodiscard]] std::size_t Memory::getSize() const {
+        return pageCount * 256;
+    }
+
+    [[nodiscard]] word Memory::getPageCount() const {
+        return pageCount;
+    }
+
+    std::string Memory::dump(const byte page) const {
+        constexpr char hexDigits[] = "0123456789ABCDEF";
         const word start = page << 8;
 
-        fmt::print("{:-^47}\n", fmt::format(" 0x{:02X} ", page));
+        std::string text = fmt::format("{:-^47}\n", fmt::format(" 0x{:02X} ", page));
+        text.reserve(text.size() + 16 * 49);
         for (byte line = 0; line < 16; ++line) {
             for (byte i = 0; i < 16; ++i) {
-                fmt::print("{:02X} ", read(start + line * 16 + i));
+                const byte value = peek(start + line * 16 + i);
+                text += hexDigits[value >> 4];
+                text += hexDigits[value & 0xF];
+                text += ' ';
             }
-            fmt::print("\n");
+            text += '\n';
         }
+        return text;
+    }
+
+    void Memory::print(const byte page) const {
+        fmt::print("{}", dump(page));
     }
 } // mos6502
\ No newline at end of file
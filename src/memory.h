@@ -1,27 +1,247 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "types.h"
+#include "access_stats.h"
 
 namespace mos6502 {
 
+    // Takes over the accesses to the pages it is mapped to, in place of plain RAM.
+    class PageHandler {
+    public:
+        virtual ~PageHandler() = default;
+
+        virtual byte read(address addr) = 0;
+        virtual void write(address addr, byte value) = 0;
+    };
+
+    // one cycle of bus activity, as recorded when built with MOS6502_BUS_LOG
+    struct BusCycle {
+        address addr;
+        byte value;
+        bool write;
+
+        bool operator==(const BusCycle&) const = default;
+    };
+
+    // splitmix64's finalizer, which the state hashes of Memory and CPU are made of
+    [[nodiscard]] constexpr std::uint64_t mixHash(std::uint64_t value) {
+        value = (value ^ value >> 30) * 0xBF58476D1CE4E5B9;
+        value = (value ^ value >> 27) * 0x94D049BB133111EB;
+        return value ^ value >> 31;
+    }
+
+    /*
+     * The CPU's 64 KiB address space, over a physical store that may be larger.
+     *
+     * Each of the 256 CPU pages shows one 256-byte page of the store, the identity mapping to begin with;
+     * mapPhysical() points pages elsewhere, so a bank switch rewrites a few table entries and nothing else.
+     * Accesses look their page up in `readable` or `writable`, which hold the page's storage where an access
+     * needs nothing more than a load or store, and nullptr where it takes the slow path: a handler is mapped,
+     * the page is read-only, or access statistics or the bus log are attached.
+     *
+     * While hashing, writes take the slow path too, so the state hash follows every byte that changes: it is the
+     * XOR of a key for each nonzero byte of the store and for each page's mapping, and a write exchanges the key
+     * of the old value for that of the new one.
+     *
+     * Pages still showing their own place in the store skip the pointer as well and index the store by address,
+     * so the common case does not wait on a table load before it can load the byte it wants.
+     */
     class Memory {
-        std::vector<byte> memory;
+    public:
+        // how adoptStore() gives a store back, `size` being the size it was adopted with
+        using StoreRelease = void (*)(byte* store, std::size_t size);
+
+    private:
+        struct ReleaseStore {
+            StoreRelease release{}; // nullptr for a store allocated with new[]
+            std::size_t size{};
+
+            void operator()(byte* store) const;
+        };
+
+        std::size_t storageSize;
+        std::unique_ptr<byte[], ReleaseStore> storage;
+        word pageCount;
+
+        std::array<byte*, 256> pages{};      // the storage each CPU page shows
+        std::array<bool, 256> readOnly{};    // writes to these pages are dropped, unless a handler takes them
+        std::array<byte*, 256> readable{};   // pages[] where a read can go straight to storage, nullptr otherwise
+        std::array<byte*, 256> writable{};   // the same for writes
+        std::array<bool, 256> readInPlace{}; // readable and showing its own 256 bytes at the start of the store
+        std::array<bool, 256> writeInPlace{};
+
+        // accesses to a page with a handler go through it instead of the storage
+        std::array<PageHandler*, 256> readHandlers{};
+        std::array<PageHandler*, 256> writeHandlers{};
+
+        AccessStats* stats{}; // counters while attached, see setAccessStats()
+        bool hashing{};
+        std::uint64_t hash{}; // the state hash while hashing, see setHashing()
+
+#ifdef MOS6502_BUS_LOG
+        std::vector<BusCycle>* busLog{};
+#endif
+
+        void updateDirect(byte page);
+        void updateDirect();
+
+        // what a byte of the store and a page's mapping add to the state hash, zero bytes nothing
+        [[nodiscard]] static std::uint64_t byteKey(const std::size_t offset, const byte value) {
+            return value ? mixHash(offset << 8 | value) : 0;
+        }
+
+        [[nodiscard]] static std::uint64_t pageKey(const byte page, const std::size_t offset, const bool readOnly) {
+            return mixHash(std::uint64_t{1} << 63 | std::uint64_t{page} << 48 | offset | readOnly);
+        }
+
+        [[nodiscard]] std::uint64_t computeHash() const;
+
+        [[nodiscard]] byte slowRead(address addr, bool opcode) const;
+        void slowWrite(address addr, byte value);
+
+        // pages mapped elsewhere in the store, or not accessible directly at all
+        [[nodiscard]] byte remappedRead(const address addr, const bool opcode) const {
+            if (const byte* page = readable[addr >> 8]) return page[addr & 0xFF];
+            return slowRead(addr, opcode);
+        }
+
+        void remappedWrite(const address addr, const byte value) {
+            if (byte* page = writable[addr >> 8]) page[addr & 0xFF] = value;
+            else slowWrite(addr, value);
+        }
 
     public:
-        explicit Memory(byte pages = 255);
+        // the whole 64 KiB address space is always backed, so no address can run off the end of the storage;
+        // `pages` is the amount of RAM the machine reports and `physicalSize`, rounded up to whole pages, the
+        // size of the store behind it
+        explicit Memory(word pages = 256, std::size_t physicalSize = 0x10000);
+
+        // the tables point into the storage
+        Memory(const Memory&) = delete;
+        Memory& operator=(const Memory&) = delete;
+
+        [[nodiscard]] byte read(const address addr) const {
+            if (readInPlace[addr >> 8]) [[likely]] return storage[addr];
+            return remappedRead(addr, false);
+        }
+
+        // the read of an opcode, which access statistics count as an execution
+        [[nodiscard]] byte fetchOpcode(const address addr) const {
+            if (readInPlace[addr >> 8]) [[likely]] return storage[addr];
+            return remappedRead(addr, true);
+        }
 
-        [[nodiscard]] byte read(address addr) const;
         [[nodiscard]] word readWord(address addr) const;
 
-        void write(address addr, byte value);
+        void write(const address addr, const byte value) {
+            if (writeInPlace[addr >> 8]) [[likely]] storage[addr] = value;
+            else remappedWrite(addr, value);
+        }
+
         void writeWord(address addr, word value);
         void write(address addr, const std::vector<byte>& data);
 
-        [[nodiscard]] byte getSize() const;
-        [[nodiscard]] byte getPageCount() const;
+        // `count` bytes at once, as the same number of read() and write() calls in ascending order would; only
+        // where every page involved goes straight to storage and the two sides do not share any of it, otherwise
+        // they return false and change nothing
+        bool copy(address to, address from, word count);
+        bool fill(address to, byte value, word count);
+
+        // zero page and stack accesses take a byte offset, so they wrap within their page like the hardware's
+        [[nodiscard]] byte readZeroPage(const byte offset) const {
+            if (readInPlace[0]) [[likely]] return storage[offset];
+            return remappedRead(offset, false);
+        }
+
+        void writeZeroPage(const byte offset, const byte value) {
+            if (writeInPlace[0]) [[likely]] storage[offset] = value;
+            else remappedWrite(offset, value);
+        }
+
+        // a pointer in the zero page, the high byte of one at $FF comes from $00
+        [[nodiscard]] word readZeroPageWord(const byte offset) const {
+            const byte low = readZeroPage(offset);
+            return low | readZeroPage(static_cast<byte>(offset + 1)) << 8;
+        }
+
+        [[nodiscard]] byte readStack(const byte offset) const {
+            if (readInPlace[1]) [[likely]] return storage[0x100 | offset];
+            return remappedRead(0x100 | offset, false);
+        }
+
+        void writeStack(const byte offset, const byte value) {
+            if (writeInPlace[1]) [[likely]] storage[0x100 | offset] = value;
+            else remappedWrite(0x100 | offset, value);
+        }
+
+        // access to the mapped storage that bypasses the page handlers, read-only pages included
+        [[nodiscard]] byte peek(const address addr) const { return pages[addr >> 8][addr & 0xFF]; }
+        void poke(const address addr, const byte value) {
+            byte& cell = pages[addr >> 8][addr & 0xFF];
+            if (hashing) [[unlikely]] {
+                const std::size_t offset = &cell - storage.get();
+                hash ^= byteKey(offset, cell) ^ byteKey(offset, value);
+            }
+            cell = value;
+        }
+
+        // installs a handler (nullptr for plain RAM) for reads or writes of a page, returns the previous one
+        PageHandler* mapRead(byte page, PageHandler* handler);
+        PageHandler* mapWrite(byte page, PageHandler* handler);
+
+        // makes `count` CPU pages from `first` show the store from byte `physical` on, which must be page aligned;
+        // writes to them are dropped unless `writable`
+        void mapPhysical(byte first, word count, std::size_t physical, bool writable = true);
+
+        // the physical store, to load bank contents that are not mapped
+        [[nodiscard]] std::size_t physicalSize() const { return storageSize; }
+        [[nodiscard]] byte* physical() { return storage.get(); }
+        [[nodiscard]] const byte* physical() const { return storage.get(); }
+
+        // where in the store a CPU page is mapped, see mapPhysical()
+        [[nodiscard]] std::size_t physicalOffset(const byte page) const { return pages[page] - storage.get(); }
+
+        // replaces the physical store with `size` bytes at `store`, such as a file mapping, which `release` is
+        // given back once the memory is done with it, or right away if it is not whole pages of at least 64 KiB;
+        // every page goes back to the identity mapping, writable, and handlers stay where they are
+        void adoptStore(byte* store, std::size_t size, StoreRelease release);
+
+        // keeps a hash of the store and the page mappings up to date as they change, so getHash() costs nothing;
+        // turning it on hashes the whole store once. Writes made straight to physical() are not seen, turn it on
+        // again after them
+        void setHashing(bool enabled);
+        [[nodiscard]] bool isHashing() const { return hashing; }
+
+        // equal for equal stores and mappings, and unequal otherwise but for collisions; hashes the store
+        // from scratch while hashing is off
+        [[nodiscard]] std::uint64_t getHash() const { return hashing ? hash : computeHash(); }
+
+        // counts the accesses made through read(), fetchOpcode() and write() into `counters` while set
+        void setAccessStats(AccessStats* counters);
+        [[nodiscard]] AccessStats* getAccessStats() const { return stats; }
+
+#ifdef MOS6502_BUS_LOG
+        // records every read and write made through read() and write() into `log` while set
+        void setBusLog(std::vector<BusCycle>* log);
+        [[nodiscard]] std::vector<BusCycle>* getBusLog() const { return busLog; }
+#endif
+
+        [[nodiscard]] PageHandler* readHandler(const byte page) const { return readHandlers[page]; }
+        [[nodiscard]] PageHandler* writeHandler(const byte page) const { return writeHandlers[page]; }
+        [[nodiscard]] bool isReadOnly(const byte page) const { return readOnly[page]; }
+
+        [[nodiscard]] std::size_t getSize() const;
+        [[nodiscard]] word getPageCount() const;
 
+        // hex dump of a page, formatted in a single buffer
+        [[nodiscard]] std::string dump(byte page) const;
         void print(byte page) const;
     };
 
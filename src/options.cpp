@@ -0,0 +1,225 @@
+#include "options.h"
+
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include "expression.h"
+
+namespace mos6502 {
+
+namespace {
+
+    // numbers are expressions, so $C000, 0xC000, 49152 and 1<<20 all work
+    std::int64_t parseNumber(const std::string_view option, const std::string_view text) {
+        auto noSymbols = [](std::string_view) -> std::optional<std::int64_t> { return std::nullopt; };
+        try {
+            const auto value = evaluate(text, noSymbols);
+            if (value.known && value.value >= 0) return value.value;
+        } catch (const std::runtime_error&) {
+        }
+        throw std::invalid_argument(fmt::format("{}: expected a number, got '{}'", option, text));
+    }
+
+    address parseAddress(const std::string_view option, const std::string_view text) {
+        const auto value = parseNumber(option, text);
+        if (value > 0xFFFF) throw std::invalid_argument(fmt::format("{}: address out of range", option));
+        return static_cast<address>(value);
+    }
+
+    Backend parseBackend(const std::string_view text) {
+        for (const auto backend : {Backend::Interpreter, Backend::Tick, Backend::Aot}) {
+            if (text == name(backend)) return backend;
+        }
+        throw std::invalid_argument(fmt::format("--backend: unknown backend '{}'", text));
+    }
+
+} // namespace
+
+    const char* name(const Backend backend) {
+        switch (backend) {
+            case Backend::Interpreter: return "interpreter";
+            case Backend::Tick: return "tick";
+            case Backend::Aot: return "aot";
+        }
+        return "?";
+    }
+
+    Options parseArguments(const int argc, const char* const* argv) {
+        Options options;
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view argument = argv[i];
+
+            const auto value = [&]() -> std::string_view {
+                if (i + 1 >= argc) throw std::invalid_argument(fmt::format("{}: missing value", argument));
+                return argv[++i];
+            };
+
+            if (argument == "-h" || argument == "--help") {
+                options.help = true;
+            } else if (argument == "--load") {
+                options.load = parseAddress(argument, value());
+            } else if (argument == "--entry") {
+                options.entry = parseAddress(argument, value());
+            } else if (argument == "--cycles") {
+                options.cycleLimit = parseNumber(argument, value());
+            } else if (argument == "--instructions") {
+                options.instructionLimit = parseNumber(argument, value());
+            } else if (argument == "--backend") {
+                options.backend = parseBackend(value());
+            } else if (argument == "--instances") {
+                const auto instances = parseNumber(argument, value());
+                if (instances < 1 || instances > 4096) throw std::invalid_argument("--instances: expected 1 to 4096");
+                options.instances = static_cast<unsigned>(instances);
+            } else if (argument == "--threads") {
+                const auto threads = parseNumber(argument, value());
+                if (threads > 4096) throw std::invalid_argument("--threads: expected 0 to 4096");
+                options.threads = static_cast<unsigned>(threads);
+            } else if (argument == "--quantum") {
+                options.quantum = parseNumber(argument, value());
+                if (options.quantum == 0) throw std::invalid_argument("--quantum: must not be 0");
+            } else if (argument == "--clock") {
+                options.clock = parseNumber(argument, value());
+            } else if (argument == "--host-trap") {
+                const auto opcode = parseNumber(argument, value());
+                if (opcode > 0xFF) throw std::invalid_argument("--host-trap: opcode out of range");
+                options.hostTrap = static_cast<byte>(opcode);
+            } else if (argument == "--host-port") {
+                options.hostPort = parseAddress(argument, value());
+            } else if (argument == "--host-dir") {
+                options.hostDirectory = value();
+            } else if (argument == "--physical-memory") {
+                options.physicalMemory = parseNumber(argument, value());
+                if (options.physicalMemory < 0x10000 || options.physicalMemory > 0x10000000) {
+                    throw std::invalid_argument("--physical-memory: expected 64 KiB to 256 MiB");
+                }
+            } else if (argument == "--physical-image") {
+                options.physicalImage = value();
+            } else if (argument == "--bank-window") {
+                options.bankWindow = parseAddress(argument, value());
+            } else if (argument == "--bank-size") {
+                options.bankSize = parseNumber(argument, value());
+            } else if (argument == "--bank-register") {
+                options.bankRegister = parseAddress(argument, value());
+            } else if (argument == "--save-state") {
+                options.saveState = value();
+            } else if (argument == "--restore-state") {
+                options.restoreState = value();
+            } else if (argument == "--state-hash") {
+                options.stateHash = true;
+            } else if (argument == "--stop-on-repeat") {
+                options.stateHash = options.stopOnRepeat = true;
+            } else if (argument == "--via") {
+                options.via = parseAddress(argument, value());
+            } else if (argument == "--acia") {
+                options.acia = parseAddress(argument, value());
+            } else if (argument == "--serial") {
+                options.serial = value();
+            } else if (argument == "--trace") {
+                options.trace = value();
+            } else if (argument == "--profile") {
+                options.profile = value();
+            } else if (argument == "--access-stats") {
+                options.accessStats = value();
+            } else if (argument == "--json") {
+                options.json = value();
+            } else if (argument == "--dump") {
+                const auto page = parseNumber(argument, value());
+                if (page > 0xFF) throw std::invalid_argument("--dump: page out of range");
+                options.dumpPages.push_back(static_cast<byte>(page));
+            } else if (argument == "--gdb") {
+                const auto port = parseNumber(argument, value());
+                if (port == 0 || port > 0xFFFF) throw std::invalid_argument("--gdb: port out of range");
+                options.gdbPort = static_cast<std::uint16_t>(port);
+            } else if (argument == "--gdb-socket") {
+                options.gdbSocket = value();
+            } else if (argument.starts_with("-")) {
+                throw std::invalid_argument(fmt::format("unknown option '{}'", argument));
+            } else if (options.rom.empty()) {
+                options.rom = argument;
+            } else {
+                throw std::invalid_argument("only one ROM can be given");
+            }
+        }
+
+        if (!options.serial.empty() && !options.acia) throw std::invalid_argument("--serial needs --acia");
+        if (options.bankWindow.has_value() != options.bankRegister.has_value()) {
+            throw std::invalid_argument("--bank-window and --bank-register go together");
+        }
+        // recompiled code is checked against memory once, banking would swap it out from under the blocks
+        if (options.backend == Backend::Aot && options.bankWindow) {
+            throw std::invalid_argument("--backend aot cannot be combined with --bank-window");
+        }
+        // host calls copy and load into memory past the write hook, so stale blocks would keep running
+        if (options.backend == Backend::Aot && (options.hostTrap || options.hostPort)) {
+            throw std::invalid_argument("--backend aot cannot be combined with host calls");
+        }
+
+        if (!options.restoreState.empty() && (!options.rom.empty() || !options.physicalImage.empty())) {
+            throw std::invalid_argument("--restore-state replaces the ROM and --physical-image");
+        }
+
+        // the hash covers the CPU and memory, a repeat says nothing about the state kept elsewhere
+        if (options.stopOnRepeat && (options.via || options.acia || options.hostTrap || options.hostPort)) {
+            throw std::invalid_argument("--stop-on-repeat cannot be combined with --via, --acia or host calls");
+        }
+
+        if (!options.rom.empty() && !options.load) {
+            const bool source = options.rom.ends_with(".s") || options.rom.ends_with(".asm");
+            if (!source) throw std::invalid_argument("--load is required for binary ROMs");
+        }
+
+        return options;
+    }
+
+    std::string usage(const char* program) {
+        return fmt::format(
+            "usage: {} [options] [rom]\n"
+            "\n"
+            "Runs a raw binary ROM, or assembly source (*.s, *.asm), until it reaches a 0x00 opcode or a limit.\n"
+            "Without a ROM the built-in fill demo runs. Final state and statistics are written as JSON.\n"
+            "\n"
+            "  --load ADDR          load address of a binary ROM (source uses .org)\n"
+            "  --entry ADDR         entry point, defaults to the load address\n"
+            "  --cycles N           stop after N cycles\n"
+            "  --instructions N     stop after N instructions\n"
+            "  --backend NAME       execution backend: interpreter, tick, aot (6502_aot builds only)\n"
+            "  --instances N        run N independent instances in parallel\n"
+            "  --threads N          threads the instances are scheduled on, default one per core\n"
+            "  --quantum CYCLES     cycles an instance runs before yielding its thread, default 100000\n"
+            "  --clock HZ           hold every instance to HZ cycles per second, in 1 ms slices\n"
+            "  --host-trap OPCODE   make an undefined opcode a host call, followed by the service number\n"
+            "  --host-port ADDR     make writes to ADDR host calls, the value written is the service number\n"
+            "  --host-dir DIR       let host calls read and write files in DIR\n"
+            "  --physical-memory N  back the address space with N bytes of physical memory, default 64 KiB\n"
+            "  --physical-image F   load raw file F at the start of physical memory, before the program\n"
+            "  --bank-window ADDR   bank-switch the window at ADDR, see --bank-size and --bank-register\n"
+            "  --bank-size N        size of the window and of a bank, default 16 KiB\n"
+            "  --bank-register ADDR writing N here maps physical bytes N * bank size onwards into the window\n"
+            "  --save-state FILE    save instance 0's CPU, memory and devices to FILE at the end\n"
+            "  --restore-state FILE start every instance from a saved state instead of a ROM, the machine options\n"
+            "                       must match the saved machine's\n"
+            "  --state-hash         hash each instance's registers and memory as they change, reported as\n"
+            "                       state_hash, equal for runs that end in the same state\n"
+            "  --stop-on-repeat     stop an instance once it is back in a state it was in between two quanta,\n"
+            "                       as it would then repeat forever; implies --state-hash\n"
+            "  --via ADDR           attach a 6522 VIA at ADDR, its IRQ is wired to the CPU\n"
+            "  --acia ADDR          attach a 6551 ACIA at ADDR, instance 0's talks to stdin and stdout\n"
+            "  --serial PATH        connect the ACIA to PATH, such as a FIFO or pty, instead\n"
+            "  --trace FILE         write a per-instruction trace of instance 0\n"
+            "  --profile FILE       write an execution profile of instance 0 as JSON\n"
+            "  --access-stats FILE  count the reads, writes and executions of each address of instance 0 and\n"
+            "                       write them to FILE, as a heatmap if it ends in .png, see src/access_stats.h\n"
+            "  --json FILE          write the results to FILE instead of stdout\n"
+            "  --dump PAGE          print a memory page of instance 0 to stderr, may be repeated\n"
+            "  --gdb PORT           wait for a GDB connection on 127.0.0.1:PORT\n"
+            "  --gdb-socket PATH    wait for a GDB connection on a Unix socket\n"
+            "\n"
+            "Numbers may be written as 49152, $C000, 0xC000 or %1100000000000000.\n",
+            program);
+    }
+
+} // mos6502
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace mos6502 {
+
+    enum class Backend : byte {
+        Interpreter,
+        Tick, // cycle-stepped, see TickCore
+        Aot,  // recompiled ahead of time, see AotCore; only in the 6502_aot build
+    };
+
+    struct Options {
+        std::string rom; // raw binary, or assembly source if it ends in .s or .asm; the built-in demo when empty
+        std::optional<address> load;
+        std::optional<address> entry;
+
+        std::uint64_t cycleLimit = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t instructionLimit = std::numeric_limits<std::uint64_t>::max();
+
+        Backend backend = Backend::Interpreter;
+        unsigned instances = 1;
+        unsigned threads = 0;             // scheduler threads, 0 for one per core
+        std::uint64_t quantum = 100'000; // cycles an instance runs before the next one on its thread gets a turn
+        std::uint64_t clock = 0;          // real-time pacing to this many cycles per second, 0 for full speed
+
+        std::optional<byte> hostTrap;    // opcode of the host call trap, see HostServices
+        std::optional<address> hostPort; // address whose writes make host calls
+        std::string hostDirectory;       // root of the files host calls may read and write, none when empty
+
+        std::size_t physicalMemory = 0x10000; // bytes of physical memory behind the address space
+        std::string physicalImage;            // raw image loaded at the start of physical memory
+        std::optional<address> bankWindow;    // start of the bank-switched window
+        std::size_t bankSize = 0x4000;        // its size, and the size of a bank
+        std::optional<address> bankRegister;  // the bank select register
+
+        std::string saveState;    // where instance 0's state goes at the end, see save_state.h
+        std::string restoreState; // the state every instance starts from, in place of the ROM
+
+        bool stateHash = false;    // keep and report each instance's CPU::stateHash()
+        bool stopOnRepeat = false; // stop a scheduled instance once its state repeats between quanta
+
+        std::optional<address> via;  // base address of a 6522 VIA
+        std::optional<address> acia; // base address of a 6551 ACIA, connected for instance 0
+        std::string serial;          // file or device the ACIA talks to, stdin and stdout when empty
+
+        std::string trace;       // per-instruction trace of instance 0
+        std::string profile;     // execution profile of instance 0, as JSON
+        std::string accessStats; // per-address access counts of instance 0, a PNG heatmap if it ends in .png
+        std::string json;        // final state and statistics, stdout when empty
+        std::vector<byte> dumpPages;
+
+        std::optional<std::uint16_t> gdbPort;
+        std::string gdbSocket;
+
+        bool help = false;
+    };
+
+    // throws std::invalid_argument on malformed command lines
+    [[nodiscard]] Options parseArguments(int argc, const char* const* argv);
+
+    [[nodiscard]] std::string usage(const char* program);
+
+    [[nodiscard]] const char* name(Backend backend);
+
+} // mos6502
@@ -0,0 +1,70 @@
+#include "pacer.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef __unix__
+#include <cerrno>
+#include <ctime>
+#endif
+
+namespace mos6502 {
+
+    Pacer::Pacer(const std::uint64_t hz, const std::uint64_t slice) : hz(hz), slice(std::max<std::uint64_t>(1, slice)) {}
+
+    Pacer::clock::time_point Pacer::next(const std::uint64_t cycles) {
+        this->cycles = cycles;
+        lastSlice = clock::now();
+
+        // whole seconds and the remainder separately, so the product cannot overflow
+        const auto seconds = std::chrono::seconds(cycles / hz);
+        const auto rest = std::chrono::nanoseconds((cycles % hz) * 1'000'000'000 / hz);
+        deadline = origin + seconds + rest;
+
+        if (lastSlice - deadline > maxLag) {
+            origin += lastSlice - deadline;
+            deadline = lastSlice;
+            ++resyncs;
+        }
+        return deadline;
+    }
+
+    void Pacer::resumed() {
+        const auto lateness = std::max(clock::now() - deadline, clock::duration::zero());
+        ++slices;
+        totalLateness += lateness;
+        maxLateness = std::max(maxLateness, lateness);
+        if (lateness * hz > std::chrono::seconds(slice)) ++lateSlices;
+    }
+
+    void Pacer::sleep(const std::uint64_t cycles) {
+        const auto until = next(cycles);
+#ifdef __unix__
+        // steady_clock is CLOCK_MONOTONIC, so its time points can be handed to the kernel as they are
+        const auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(until.time_since_epoch());
+        timespec time{};
+        time.tv_sec = static_cast<std::time_t>(sinceEpoch.count() / 1'000'000'000);
+        time.tv_nsec = static_cast<long>(sinceEpoch.count() % 1'000'000'000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) {}
+#else
+        std::this_thread::sleep_until(until);
+#endif
+        resumed();
+    }
+
+    Pacer::Stats Pacer::stats() const {
+        using std::chrono::duration_cast, std::chrono::nanoseconds;
+
+        const std::chrono::duration<double> elapsed = lastSlice - start;
+        const auto meanLateness = slices ? totalLateness / static_cast<clock::rep>(slices) : clock::duration{};
+        return {
+            elapsed.count() > 0 ? cycles / elapsed.count() / 1e6 : 0.0,
+            slices,
+            lateSlices,
+            duration_cast<nanoseconds>(meanLateness),
+            duration_cast<nanoseconds>(maxLateness),
+            resyncs,
+        };
+    }
+
+} // mos6502
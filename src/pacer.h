@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace mos6502 {
+
+    /*
+     * Holds an emulated machine to a target clock frequency.
+     *
+     * The machine runs in slices at full speed; after each, next() gives the time at which the total cycle count
+     * is due and the caller sleeps until then. Deadlines are measured from a fixed origin rather than from the
+     * previous wakeup, so oversleeping in one slice is made up in the next instead of accumulating. A machine
+     * that falls further behind than maxLag, because the host stalled, is moved forward rather than let run
+     * unpaced until it has caught up.
+     */
+    class Pacer {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        static constexpr auto maxLag = std::chrono::milliseconds(50);
+
+        struct Stats {
+            double mhz;                          // achieved clock rate
+            std::uint64_t slices;
+            std::uint64_t lateSlices;            // resumed more than a slice's worth of time after their deadline
+            std::chrono::nanoseconds meanLateness;
+            std::chrono::nanoseconds maxLateness;
+            std::uint64_t resyncs;               // times the machine fell more than maxLag behind
+        };
+
+        // `hz` cycles per second, with deadlines checked every `slice` cycles
+        Pacer(std::uint64_t hz, std::uint64_t slice);
+
+        [[nodiscard]] std::uint64_t sliceCycles() const { return slice; }
+
+        // the time `cycles` cycles after the start are due, remembered for resumed()
+        [[nodiscard]] clock::time_point next(std::uint64_t cycles);
+
+        // records how late the machine got going again after the deadline returned by next()
+        void resumed();
+
+        // next() and resumed() around an absolute clock_nanosleep
+        void sleep(std::uint64_t cycles);
+
+        [[nodiscard]] Stats stats() const;
+
+    private:
+        std::uint64_t hz;
+        std::uint64_t slice;
+
+        clock::time_point start = clock::now();
+        clock::time_point origin = start; // when cycle 0 was due, moved forward by resyncs
+        clock::time_point deadline = start;
+        clock::time_point lastSlice = start;
+        std::uint64_t cycles = 0;
+
+        std::uint64_t slices = 0;
+        std::uint64_t lateSlices = 0;
+        std::uint64_t resyncs = 0;
+        clock::duration totalLateness{};
+        clock::duration maxLateness{};
+    };
+
+} // mos6502
@@ -0,0 +1,71 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <fmt/core.h>
+
+#include "disassembler.h"
+#include "opcodes.h"
+
+namespace mos6502 {
+
+    Profiler::Profiler() : executions(0x10000), cyclesSpent(0x10000), opcodeCounts(256), pairCounts(0x10000) {}
+
+    void Profiler::record(const address pc, const byte opcode, const cycles elapsed) {
+        ++executions[pc];
+        cyclesSpent[pc] += elapsed;
+        ++opcodeCounts[opcode];
+        if (previous != -1) ++pairCounts[previous << 8 | opcode];
+        previous = opcode;
+    }
+
+namespace {
+
+    // indices of the `count` largest non-zero entries, largest first
+    std::vector<std::size_t> hottest(const std::vector<std::uint64_t>& counts, const std::size_t count) {
+        std::vector<std::size_t> indices(counts.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        const auto end = std::partition(indices.begin(), indices.end(), [&](const std::size_t i) { return counts[i] != 0; });
+        const auto n = std::min<std::size_t>(count, end - indices.begin());
+        std::partial_sort(indices.begin(), indices.begin() + n, end, [&](const std::size_t a, const std::size_t b) {
+            return counts[a] > counts[b];
+        });
+        indices.resize(n);
+        return indices;
+    }
+
+} // namespace
+
+    void Profiler::write(std::FILE* out, const Memory& memory, const std::size_t top) const {
+        const auto total = std::accumulate(opcodeCounts.begin(), opcodeCounts.end(), std::uint64_t{0});
+
+        fmt::print(out, "{{\n  \"instructions\": {},\n  \"addresses\": [", total);
+        const char* separator = "\n";
+        for (const auto pc : hottest(executions, top)) {
+            fmt::print(out, "{}    {{\"pc\": {}, \"instruction\": \"{}\", \"executions\": {}, \"cycles\": {}}}",
+                separator, pc, disassemble(memory, pc), executions[pc], cyclesSpent[pc]);
+            separator = ",\n";
+        }
+
+        fmt::print(out, "\n  ],\n  \"opcodes\": [");
+        separator = "\n";
+        for (const auto opcode : hottest(opcodeCounts, 256)) {
+            const auto& info = opcodes[opcode];
+            fmt::print(out, "{}    {{\"opcode\": {}, \"mnemonic\": \"{}\", \"count\": {}}}",
+                separator, opcode, name(info.mnemonic), opcodeCounts[opcode]);
+            separator = ",\n";
+        }
+
+        fmt::print(out, "\n  ],\n  \"pairs\": [");
+        separator = "\n";
+        for (const auto pair : hottest(pairCounts, top)) {
+            fmt::print(out, "{}    {{\"first\": {}, \"second\": {}, \"mnemonics\": \"{} {}\", \"count\": {}}}",
+                separator, pair >> 8, pair & 0xFF, name(opcodes[pair >> 8].mnemonic), name(opcodes[pair & 0xFF].mnemonic),
+                pairCounts[pair]);
+            separator = ",\n";
+        }
+        fmt::print(out, "\n  ]\n}}\n");
+    }
+
+} // mos6502
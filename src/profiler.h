@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "types.h"
+#include "memory.h"
+
+namespace mos6502 {
+
+    // Execution counts and cycles per address, per opcode and per pair of consecutive opcodes.
+    class Profiler {
+        std::vector<std::uint64_t> executions;    // per address
+        std::vector<std::uint64_t> cyclesSpent;   // per address
+        std::vector<std::uint64_t> opcodeCounts;  // per opcode
+        std::vector<std::uint64_t> pairCounts;    // previous opcode << 8 | opcode
+        int previous = -1;
+
+    public:
+        Profiler();
+
+        void record(address pc, byte opcode, cycles elapsed);
+
+        // hottest addresses, opcode mix and opcode pairs, the latter being the candidates for fused handlers
+        void write(std::FILE* out, const Memory& memory, std::size_t top = 32) const;
+    };
+
+} // mos6502
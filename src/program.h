@@ -9,9 +9,13 @@ namespace mos6502 {
     struct Program {
         std::vector<byte> code;
         word entryPoint;
+        word origin; // address the code is loaded at
 
         explicit Program(std::vector<byte> code, const word entryPoint)
-            : code(std::move(code)), entryPoint(entryPoint) {}
+            : code(std::move(code)), entryPoint(entryPoint), origin(entryPoint) {}
+
+        explicit Program(std::vector<byte> code, const word entryPoint, const word origin)
+            : code(std::move(code)), entryPoint(entryPoint), origin(origin) {}
     };
 
-} // mos6502
\ No newline at end of file
+} // mos6502
@@ -0,0 +1,467 @@
+#include "recompiler.h"
+
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include "disassembler.h"
+#include "opcodes.h"
+
+namespace mos6502 {
+
+namespace {
+
+    using enum Mnemonic;
+    using enum Mode;
+
+    // the register an instruction loads, stores, transfers or counts, as named in CPU
+    std::string_view target(const Mnemonic mnemonic) {
+        switch (mnemonic) {
+            case LDX: case STX: case CPX: case INX: case DEX: case TAX: case TSX: return "x";
+            case LDY: case STY: case CPY: case INY: case DEY: case TAY: return "y";
+            default: return "ac";
+        }
+    }
+
+    std::string setFlags(const std::string_view value) {
+        return fmt::format("c.sr.z = {0} == 0; c.sr.n = {0} & 0x80;", value);
+    }
+
+    std::string_view condition(const Mnemonic mnemonic) {
+        switch (mnemonic) {
+            case BCC: return "!c.sr.c";
+            case BCS: return "c.sr.c";
+            case BEQ: return "c.sr.z";
+            case BMI: return "c.sr.n";
+            case BNE: return "!c.sr.z";
+            case BPL: return "!c.sr.n";
+            case BVC: return "!c.sr.v";
+            default: return "c.sr.v";
+        }
+    }
+
+    std::string_view shift(const Mnemonic mnemonic) {
+        switch (mnemonic) {
+            case ASL: return "asl_";
+            case LSR: return "lsr_";
+            case ROL: return "rol_";
+            default: return "ror_";
+        }
+    }
+
+    // nothing after it in the block can run
+    bool endsBlock(const Opcode& info) {
+        return info.mode == Relative || info.mnemonic == JMP || info.mnemonic == JSR || info.mnemonic == RTS;
+    }
+
+    // touches memory that a page handler may be mapped to, anything but the zero page and the stack
+    bool reachesDevices(const Opcode& info) {
+        switch (info.mode) {
+            case Absolute: return info.mnemonic != JMP && info.mnemonic != JSR;
+            case AbsoluteX: case AbsoluteY: case Indirect: case IndirectX: case IndirectY: return true;
+            default: return false;
+        }
+    }
+
+    // writes memory, which may hold compiled code
+    bool writesMemory(const Opcode& info) {
+        switch (info.mnemonic) {
+            case STA: case STX: case STY: case INC: case DEC: case PHA: case PHP: return true;
+            case ASL: case LSR: case ROL: case ROR: return info.mode != Accumulator;
+            default: return false;
+        }
+    }
+
+} // namespace
+
+    Recompiler::Recompiler(const Program& rom) : begin(rom.origin), end(rom.origin + rom.code.size()) {
+        if (end > 0x10000) throw std::invalid_argument("ROM does not fit in memory");
+        std::ranges::copy(rom.code, image.begin() + begin);
+        addEntry(rom.entryPoint);
+    }
+
+    void Recompiler::addEntry(const address entry) {
+        entries.push_back(entry);
+    }
+
+    void Recompiler::addVectors() {
+        for (const address vector : {0xFFFA, 0xFFFC, 0xFFFE}) {
+            if (!contains(vector, 2)) continue;
+            const address target = image[vector] | image[vector + 1] << 8;
+            if (contains(target, 1)) addEntry(target);
+        }
+    }
+
+    bool Recompiler::contains(const std::uint32_t addr, const std::uint32_t length) const {
+        return addr >= begin && addr + length <= end;
+    }
+
+    // inside the ROM and an instruction blocks are made of, the rest is left to the interpreter
+    bool Recompiler::translatable(const address addr) const {
+        const auto& info = opcodes[image[addr]];
+        return contains(addr, info.length) && info.mnemonic != Illegal && info.mnemonic != BRK && info.mnemonic != RTI;
+    }
+
+    void Recompiler::analyse() {
+        discover();
+
+        found.clear();
+        for (int addr = 0; addr < 0x10000; ++addr) {
+            if (leaders[addr] && translatable(addr)) found.emplace(addr, collect(addr));
+        }
+
+        codePages.fill(false);
+        for (const auto& block : found | std::views::values) {
+            for (address pc = block.start; pc != block.next; ++pc) codePages[pc >> 8] = true;
+        }
+    }
+
+    // marks every address a block has to start at: entry points, branch, jump and call targets, the
+    // instructions after branches and calls, and after BRK, which returns two bytes on
+    void Recompiler::discover() {
+        std::vector<bool> visited(0x10000);
+        std::vector<address> pending(entries);
+        for (const auto entry : entries) leaders[entry] = true;
+
+        const auto lead = [&](const address addr) {
+            leaders[addr] = true;
+            pending.push_back(addr);
+        };
+
+        while (!pending.empty()) {
+            address pc = pending.back();
+            pending.pop_back();
+
+            while (contains(pc, 1) && !visited[pc]) {
+                visited[pc] = true;
+                const auto& info = opcodes[image[pc]];
+                if (info.mnemonic == BRK) lead(pc + 2);
+                if (!translatable(pc)) break;
+
+                const address next = pc + info.length;
+                const address operand = image[static_cast<address>(pc + 1)] | image[static_cast<address>(pc + 2)] << 8;
+
+                if (info.mode == Relative) {
+                    lead(next + static_cast<signed char>(image[pc + 1]));
+                    lead(next);
+                    break;
+                }
+                if (info.mnemonic == JMP) {
+                    if (info.mode == Absolute) lead(operand);
+                    break;
+                }
+                if (info.mnemonic == JSR) {
+                    lead(operand);
+                    lead(next);
+                    break;
+                }
+                if (info.mnemonic == RTS) break;
+                pc = next;
+            }
+        }
+    }
+
+    Recompiler::Block Recompiler::collect(const address start) const {
+        Block block{start, {}, start, 0};
+        address pc = start;
+
+        while (true) {
+            const auto& info = opcodes[image[pc]];
+            block.instructions.push_back(pc);
+            block.maxCycles += info.cycles + (info.mode == Relative ? 2 : info.penalty);
+            pc += info.length;
+
+            if (endsBlock(info)) break;
+            if (leaders[pc] || !translatable(pc) || block.instructions.size() == maxInstructions) break;
+        }
+        block.next = pc;
+        return block;
+    }
+
+    std::string Recompiler::emit(const std::string_view source) const {
+        std::string out;
+        auto it = std::back_inserter(out);
+
+        fmt::format_to(it, "// Generated by 6502_recompile from {}, do not edit.\n\n", source);
+        fmt::format_to(it, "#include \"aot_core.h\"\n\nnamespace mos6502 {{\n");
+
+        for (const auto& block : found | std::views::values) emitBlock(out, block);
+
+        fmt::format_to(it, "\n    std::span<const AotCore::Block> AotCore::recompiled() {{\n");
+        for (const auto& [start, block] : found) {
+            fmt::format_to(it, "        static constexpr byte code{:04X}[] = {{", start);
+            for (address pc = start; pc != block.next; ++pc) fmt::format_to(it, "{}0x{:02X}", pc == start ? "" : ", ", image[pc]);
+            fmt::format_to(it, "}};\n");
+        }
+        fmt::format_to(it, "\n        static constexpr Block blocks[] = {{\n");
+        for (const auto& [start, block] : found) {
+            fmt::format_to(it, "            {{0x{0:04X}, code{0:04X}, {1}, &block<0x{0:04X}>}},\n", start, block.maxCycles);
+        }
+        if (found.empty()) fmt::format_to(it, "            {{0, {{}}, 0, nullptr}},\n");
+        fmt::format_to(it, "        }};\n        return {{blocks, {}}};\n    }}\n\n}} // mos6502\n", found.size());
+        return out;
+    }
+
+    void Recompiler::emitBlock(std::string& out, const Block& block) const {
+        auto it = std::back_inserter(out);
+        fmt::format_to(it, "\n    template <>\n    unsigned AotCore::block<0x{:04X}>(CPU& c) {{\n", block.start);
+
+        // cycles of the instructions so far that are not in c.cycleCount yet
+        cycles pending = 0;
+        for (std::size_t i = 0; i < block.instructions.size(); ++i) {
+            const address pc = block.instructions[i];
+            const bool last = i + 1 == block.instructions.size();
+
+            char text[maxInstructionLength];
+            const std::string_view instruction(text, disassemble(text, pc, &image[pc]) - text);
+            fmt::format_to(it, "        // ${:04X}  {}\n", pc, instruction);
+
+            out += emitInstruction(pc, i + 1, last, pending);
+        }
+
+        if (!endsBlock(opcodes[image[block.instructions.back()]])) {
+            if (pending) fmt::format_to(it, "        c.cycleCount += {};\n", pending);
+            fmt::format_to(it, "        c.pc = 0x{:04X};\n        return {};\n", block.next, block.instructions.size());
+        }
+        fmt::format_to(it, "    }}\n");
+    }
+
+    // the statements for the instruction at `pc`, as in its handler in cpu_instructions.cpp; exits return `count`,
+    // the instructions executed up to and including this one
+    std::string Recompiler::emitInstruction(const address pc, const std::size_t count, const bool last, cycles& pending) const {
+        const auto& info = opcodes[image[pc]];
+        const byte low = image[static_cast<address>(pc + 1)];
+        const word operand = low | image[static_cast<address>(pc + 2)] << 8;
+        const address next = pc + info.length;
+        const auto reg = target(info.mnemonic);
+
+        std::string out;
+        auto it = std::back_inserter(out);
+        const auto line = [&](const std::string_view statement) { fmt::format_to(it, "        {}\n", statement); };
+        const auto flush = [&](const cycles extra = 0) {
+            if (pending + extra) line(fmt::format("c.cycleCount += {};", pending + extra));
+            pending = 0;
+        };
+
+        const bool device = reachesDevices(info);
+        if (device) flush(); // devices read the cycle count at the start of the instruction
+        // a zero page or stack write into compiled code drops blocks, possibly this one, see AotCore::invalidate()
+        const bool patchesCode = !device && writesMemory(info) && codePages[info.mnemonic == PHA || info.mnemonic == PHP];
+
+        // single-byte instructions read the byte after the opcode and ignore it, see CPU::execute()
+        if (info.length == 1) line(fmt::format("c.dummyRead(0x{:04X});", next));
+        const auto body = out.size();
+
+        const std::string zp = fmt::format("0x{:02X}", low);
+        const std::string abs = fmt::format("0x{:04X}", operand);
+        const std::string zpIndexed = fmt::format("static_cast<byte>({} + c.{})", zp, info.mode == ZeroPageY ? "y" : "x");
+        const std::string_view index = info.mode == AbsoluteX || info.mode == ZeroPageX || info.mode == IndirectX ? "x" : "y";
+
+        // the value a reading instruction works on, after any statements that compute its address
+        const auto operandValue = [&]() -> std::string {
+            switch (info.mode) {
+                case Immediate: return fmt::format("0x{:02X}", low);
+                case ZeroPage: return fmt::format("c.memory.readZeroPage({})", zp);
+                case ZeroPageX:
+                case ZeroPageY:
+                    line(fmt::format("c.dummyRead({});", zp));
+                    return fmt::format("c.memory.readZeroPage({})", zpIndexed);
+                case Absolute: return fmt::format("c.memory.read({})", abs);
+                case AbsoluteX:
+                case AbsoluteY: return fmt::format("c.readIndexed({}, c.{})", abs, index);
+                case IndirectX:
+                    line(fmt::format("c.dummyRead({});", zp));
+                    return fmt::format("c.memory.read(c.memory.readZeroPageWord({}))", zpIndexed);
+                default: // IndirectY
+                    line(fmt::format("const address base = c.memory.readZeroPageWord({});", zp));
+                    return fmt::format("c.readIndexed(base, c.{})", index);
+            }
+        };
+
+        // the address a writing or read-modify-write instruction works on
+        const auto operandAddress = [&]() -> std::string {
+            switch (info.mode) {
+                case ZeroPage: return zp;
+                case ZeroPageX:
+                case ZeroPageY:
+                    line(fmt::format("c.dummyRead({});", zp));
+                    return zpIndexed;
+                case Absolute: return abs;
+                case AbsoluteX:
+                case AbsoluteY: return fmt::format("c.indexedForWrite({}, c.{})", abs, index);
+                case IndirectX:
+                    line(fmt::format("c.dummyRead({});", zp));
+                    return fmt::format("c.memory.readZeroPageWord({})", zpIndexed);
+                default: // IndirectY
+                    return fmt::format("c.indexedForWrite(c.memory.readZeroPageWord({}), c.{})", zp, index);
+            }
+        };
+
+        // indexed reads take a cycle more when the index carries into the high byte
+        const auto penalty = [&] {
+            if (!info.penalty) return;
+            if (info.mode == IndirectY) line(fmt::format("c.cycleCount += (base & 0xFF) + c.{} > 0xFF;", index));
+            else line(fmt::format("c.cycleCount += 0x{:02X} + c.{} > 0xFF;", low, index));
+        };
+
+        switch (info.mnemonic) {
+            case LDA: case LDX: case LDY:
+                line(fmt::format("c.{} = {}; {}", reg, operandValue(), setFlags(fmt::format("c.{}", reg))));
+                penalty();
+                break;
+            case AND: line(fmt::format("c.ac &= {}; {}", operandValue(), setFlags("c.ac"))); penalty(); break;
+            case EOR: line(fmt::format("c.ac ^= {}; {}", operandValue(), setFlags("c.ac"))); penalty(); break;
+            case ORA: line(fmt::format("c.ac |= {}; {}", operandValue(), setFlags("c.ac"))); penalty(); break;
+            case ADC: line(fmt::format("c.adc({});", operandValue())); penalty(); break;
+            case SBC: line(fmt::format("c.sbc({});", operandValue())); penalty(); break;
+            case CMP: case CPX: case CPY:
+                line(fmt::format("c.cmp_(c.{}, {});", reg, operandValue()));
+                penalty();
+                break;
+            case BIT:
+                line(fmt::format("const byte value = {};", operandValue()));
+                line("c.sr.z = (c.ac & value) == 0; c.sr.v = value & 0x40; c.sr.n = value & 0x80;");
+                break;
+
+            case STA: case STX: case STY:
+                if (info.mode == ZeroPage || info.mode == ZeroPageX || info.mode == ZeroPageY) {
+                    line(fmt::format("c.memory.writeZeroPage({}, c.{});", operandAddress(), reg));
+                } else {
+                    line(fmt::format("c.memory.write({}, c.{});", operandAddress(), reg));
+                }
+                break;
+
+            case ASL: case LSR: case ROL: case ROR:
+                if (info.mode == Accumulator) {
+                    line(fmt::format("c.ac = c.{}(c.ac);", shift(info.mnemonic)));
+                } else if (info.mode == ZeroPage || info.mode == ZeroPageX) {
+                    line(fmt::format("const byte addr = {};", operandAddress()));
+                    line(fmt::format("c.memory.writeZeroPage(addr, c.{}(c.readModifyZeroPage(addr)));", shift(info.mnemonic)));
+                } else {
+                    line(fmt::format("const address addr = {};", operandAddress()));
+                    line(fmt::format("c.memory.write(addr, c.{}(c.readModify(addr)));", shift(info.mnemonic)));
+                }
+                break;
+            case INC: case DEC:
+                if (info.mode == ZeroPage || info.mode == ZeroPageX) {
+                    line(fmt::format("const byte addr = {};", operandAddress()));
+                    line(fmt::format("const byte value = c.readModifyZeroPage(addr) {} 1;", info.mnemonic == INC ? "+" : "-"));
+                    line("c.memory.writeZeroPage(addr, value);");
+                } else {
+                    line(fmt::format("const address addr = {};", operandAddress()));
+                    line(fmt::format("const byte value = c.readModify(addr) {} 1;", info.mnemonic == INC ? "+" : "-"));
+                    line("c.memory.write(addr, value);");
+                }
+                line(setFlags("value"));
+                break;
+
+            case INX: case INY: line(fmt::format("++c.{}; {}", reg, setFlags(fmt::format("c.{}", reg)))); break;
+            case DEX: case DEY: line(fmt::format("--c.{}; {}", reg, setFlags(fmt::format("c.{}", reg)))); break;
+            case TAX: case TAY: line(fmt::format("c.{} = c.ac; {}", reg, setFlags(fmt::format("c.{}", reg)))); break;
+            case TSX: line(fmt::format("c.x = c.sp; {}", setFlags("c.x"))); break;
+            case TXA: line(fmt::format("c.ac = c.x; {}", setFlags("c.ac"))); break;
+            case TYA: line(fmt::format("c.ac = c.y; {}", setFlags("c.ac"))); break;
+            case TXS: line("c.sp = c.x;"); break;
+
+            case CLC: line("c.sr.c = false;"); break;
+            case SEC: line("c.sr.c = true;"); break;
+            case CLI: line("c.sr.i = false;"); break;
+            case SEI: line("c.sr.i = true;"); break;
+            case CLD: line("c.sr.d = false;"); break;
+            case SED: line("c.sr.d = true;"); break;
+            case CLV: line("c.sr.v = false;"); break;
+            case NOP: break;
+
+            case PHA: line("c.memory.writeStack(c.sp--, c.ac);"); break;
+            case PHP: line("c.memory.writeStack(c.sp--, c.status() | 0b00110000);"); break;
+            case PLA:
+                line("c.dummyRead(0x100 | c.sp);");
+                line(fmt::format("c.ac = c.memory.readStack(++c.sp); {}", setFlags("c.ac")));
+                break;
+            case PLP:
+                line("c.dummyRead(0x100 | c.sp);");
+                line("c.setStatus(c.memory.readStack(++c.sp) & 0b11001111);");
+                break;
+
+            case BCC: case BCS: case BEQ: case BMI: case BNE: case BPL: case BVC: case BVS: {
+                const address taken = next + static_cast<signed char>(low);
+                const bool crossed = next >> 8 != taken >> 8;
+                line(fmt::format("if ({}) {{", condition(info.mnemonic)));
+                line(fmt::format("    c.dummyRead(0x{:04X});", next));
+                if (crossed) line(fmt::format("    c.dummyRead(0x{:04X});", (next & 0xFF00) | (taken & 0xFF)));
+                line(fmt::format("    c.cycleCount += {};", pending + info.cycles + 1 + crossed));
+                line(fmt::format("    c.pc = 0x{:04X};", taken));
+                line(fmt::format("    c.recordEdge(0x{:04X});", taken));
+                line(fmt::format("    return {};", count));
+                line("}");
+                flush(info.cycles);
+                line(fmt::format("c.pc = 0x{:04X};", next));
+                line(fmt::format("c.recordEdge(0x{:04X});", next));
+                line(fmt::format("return {};", count));
+                return out;
+            }
+            case JMP:
+                if (info.mode == Absolute) {
+                    flush(info.cycles);
+                    line(fmt::format("c.pc = {};", abs));
+                } else {
+                    // the pointer's high byte is read without carrying into the page, as in CPU::jmp_ind()
+                    line("{");
+                    line(fmt::format("const byte low = c.memory.read({});", abs));
+                    line(fmt::format("c.pc = low | c.memory.read(0x{:04X}) << 8;", (operand & 0xFF00) | ((operand + 1) & 0xFF)));
+                    line("}");
+                    line(fmt::format("c.cycleCount += {};", info.cycles));
+                }
+                line("c.recordEdge(c.pc);");
+                line(fmt::format("return {};", count));
+                return out;
+            case JSR:
+                // the return address pushed is the last byte of the JSR
+                line("c.dummyRead(0x100 | c.sp);");
+                line(fmt::format("c.memory.writeStack(c.sp--, 0x{:02X});", (pc + 2) >> 8 & 0xFF));
+                line(fmt::format("c.memory.writeStack(c.sp--, 0x{:02X});", (pc + 2) & 0xFF));
+                flush(info.cycles);
+                line(fmt::format("c.pc = {};", abs));
+                line("c.recordEdge(c.pc);");
+                line(fmt::format("return {};", count));
+                return out;
+            case RTS:
+                line("c.dummyRead(0x100 | c.sp);");
+                line("{");
+                line("const byte low = c.memory.readStack(++c.sp);");
+                line("const address returnAddress = low | c.memory.readStack(++c.sp) << 8;");
+                line("c.dummyRead(returnAddress);");
+                line("c.pc = returnAddress + 1;");
+                line("}");
+                flush(info.cycles);
+                line("c.recordEdge(c.pc);");
+                line(fmt::format("return {};", count));
+                return out;
+
+            default:
+                throw std::logic_error(fmt::format("cannot translate opcode ${:02X}", image[pc]));
+        }
+        // statements that declare locals get a scope of their own
+        if (out.find("        const ", body) != std::string::npos) {
+            std::string scoped = "        {\n";
+            for (std::size_t at = body; at < out.size();) {
+                const auto eol = out.find('\n', at) + 1;
+                scoped += "    " + out.substr(at, eol - at);
+                at = eol;
+            }
+            out.replace(body, std::string::npos, scoped + "        }\n");
+        }
+
+        pending += info.cycles;
+        if ((device || patchesCode) && !last) {
+            // a device may have scheduled an event, raised an IRQ or asked to stop, or the write changed code
+            flush();
+            line(fmt::format("if (c.cycleCount >= c.deadline) [[unlikely]] {{ c.pc = 0x{:04X}; return {}; }}", next, count));
+        }
+        return out;
+    }
+
+} // mos6502
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types.h"
+#include "program.h"
+
+namespace mos6502 {
+
+    /*
+     * Translates the code of a ROM into C++ for AotCore, ahead of time.
+     *
+     * analyse() follows the code from the entry points through branches, jumps and calls, using the opcode
+     * table for lengths and modes, and splits it into basic blocks at every target. A block also ends before any
+     * instruction that is left to the interpreter (BRK, RTI, illegal opcodes), after JMP ($nnnn) and RTS, whose
+     * targets are only known at run time, and where it would leave the ROM.
+     *
+     * emit() writes one AotCore::block<start> specialisation per block, doing what the handlers in
+     * cpu_instructions.cpp do with the operands the ROM holds, and AotCore::recompiled() listing them all.
+     */
+    class Recompiler {
+    public:
+        struct Block {
+            address start;
+            std::vector<address> instructions;
+            address next;     // where execution continues when the block does not end in a control transfer
+            cycles maxCycles; // with every page crossing and taken branch
+        };
+
+        // blocks longer than this end early and continue in the next one, bounding how long a block holds off
+        // device events
+        static constexpr std::size_t maxInstructions = 64;
+
+        explicit Recompiler(const Program& rom);
+
+        void addEntry(address entry);
+
+        // the reset, NMI and IRQ vectors, for those the ROM covers and that point into it
+        void addVectors();
+
+        void analyse();
+
+        [[nodiscard]] const std::map<address, Block>& blocks() const { return found; }
+
+        // a complete translation unit for the 6502_aot target; `source` names the ROM in its header comment
+        [[nodiscard]] std::string emit(std::string_view source) const;
+
+    private:
+        std::array<byte, 0x10000> image{};
+        std::uint32_t begin;
+        std::uint32_t end;
+
+        std::vector<address> entries;
+        std::vector<bool> leaders = std::vector<bool>(0x10000);
+        std::map<address, Block> found;
+        std::array<bool, 256> codePages{}; // pages some block is compiled from
+
+        [[nodiscard]] bool contains(std::uint32_t addr, std::uint32_t length) const;
+        [[nodiscard]] bool translatable(address addr) const;
+
+        void discover();
+        [[nodiscard]] Block collect(address start) const;
+
+        void emitBlock(std::string& out, const Block& block) const;
+        [[nodiscard]] std::string emitInstruction(address pc, std::size_t count, bool last, cycles& pending) const;
+    };
+
+} // mos6502
@@ -0,0 +1,219 @@
+#include "save_state.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+#include <fmt/core.h>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace mos6502 {
+
+namespace {
+
+    constexpr std::array<byte, 8> magic{'6', '5', '0', '2', 'S', 'A', 'V', 'E'};
+    constexpr std::size_t headerSize = 72 + 256 * 4 + 256;
+    constexpr std::uint64_t storeAlignment = 0x10000; // a multiple of the page size of every host we map on
+
+    struct Header {
+        std::uint64_t devicesOffset;
+        std::uint64_t devicesSize;
+        std::uint64_t storeOffset;
+        std::uint64_t storeSize;
+        CPU::State cpu;
+        word pageCount;
+        std::array<std::uint32_t, 256> pages; // physical page numbers
+        std::array<bool, 256> readOnly;
+    };
+
+    struct DeviceRecord {
+        std::string_view name;
+        std::span<const byte> state;
+    };
+
+    Header parseHeader(const std::span<const byte> bytes) {
+        StateReader in(bytes);
+        const auto signature = in.take(magic.size());
+        if (!std::equal(magic.begin(), magic.end(), signature.begin())) throw std::runtime_error("not a save state");
+        if (const auto version = in.get<std::uint32_t>(); version != saveStateVersion) {
+            throw std::runtime_error(fmt::format("save state version {} is not supported, expected {}", version, saveStateVersion));
+        }
+        if (in.get<std::uint32_t>() != headerSize) throw std::runtime_error("save state header has the wrong size");
+
+        Header header{};
+        header.devicesOffset = in.get<std::uint64_t>();
+        header.devicesSize = in.get<std::uint64_t>();
+        header.storeOffset = in.get<std::uint64_t>();
+        header.storeSize = in.get<std::uint64_t>();
+
+        auto& [registers, cycleCount, irqLines, halted] = header.cpu;
+        registers.pc = in.get<word>();
+        registers.sp = in.get<byte>();
+        registers.ac = in.get<byte>();
+        registers.x = in.get<byte>();
+        registers.y = in.get<byte>();
+        registers.sr = in.get<byte>();
+        halted = in.get<byte>();
+        cycleCount = in.get<std::uint64_t>();
+        irqLines = in.get<std::uint32_t>();
+        header.pageCount = in.get<word>();
+        in.take(2);
+
+        for (auto& page : header.pages) page = in.get<std::uint32_t>();
+        for (auto& readOnly : header.readOnly) readOnly = in.get<byte>();
+
+        if (header.storeOffset % storeAlignment || header.storeSize % 256) throw std::runtime_error("save state store is misaligned");
+        // every sum in 64 bits and written so that it cannot wrap, the numbers come straight from the file
+        if (header.devicesOffset < headerSize || header.devicesOffset > header.storeOffset ||
+            header.devicesSize > header.storeOffset - header.devicesOffset) {
+            throw std::runtime_error("save state sections overlap");
+        }
+        for (const auto page : header.pages) {
+            if ((std::uint64_t{page} + 1) * 256 > header.storeSize) throw std::runtime_error("save state maps a page past its store");
+        }
+        return header;
+    }
+
+    std::vector<DeviceRecord> parseDevices(const std::span<const byte> bytes) {
+        std::vector<DeviceRecord> records;
+        StateReader in(bytes);
+        while (!in.done()) {
+            const auto name = in.take(in.get<word>());
+            const auto state = in.take(in.get<std::uint32_t>());
+            records.push_back({{reinterpret_cast<const char*>(name.data()), name.size()}, state});
+        }
+        return records;
+    }
+
+#ifdef __unix__
+    // the store as a private mapping of the file, written pages are copied on the first write
+    byte* mapStore(const std::string& path, const Header& header) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("cannot open " + path);
+        void* store = ::mmap(nullptr, header.storeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast<off_t>(header.storeOffset));
+        ::close(fd);
+        if (store == MAP_FAILED) throw std::runtime_error("cannot map " + path);
+        return static_cast<byte*>(store);
+    }
+
+    void unmapStore(byte* store, const std::size_t size) {
+        ::munmap(store, size);
+    }
+#endif
+
+} // namespace
+
+    void saveState(const std::string& path, const CPU& cpu, const std::span<StatefulDevice* const> devices) {
+        const Memory& memory = cpu.getMemory();
+
+        StateWriter records;
+        for (const auto* device : devices) {
+            const std::string_view name = device->stateName();
+            const auto state = device->saveState();
+            records.put<word>(static_cast<word>(name.size())).put({reinterpret_cast<const byte*>(name.data()), name.size()});
+            records.put<std::uint32_t>(static_cast<std::uint32_t>(state.size())).put(state);
+        }
+
+        const auto recordsSize = records.size();
+        const std::uint64_t storeOffset = (headerSize + recordsSize + storeAlignment - 1) / storeAlignment * storeAlignment;
+        const auto [registers, cycleCount, irqLines, halted] = cpu.getState();
+
+        StateWriter header;
+        header.put(magic);
+        header.put<std::uint32_t>(saveStateVersion).put<std::uint32_t>(headerSize);
+        header.put<std::uint64_t>(headerSize).put<std::uint64_t>(recordsSize);
+        header.put<std::uint64_t>(storeOffset).put<std::uint64_t>(memory.physicalSize());
+        header.put(registers.pc).put(registers.sp).put(registers.ac).put(registers.x).put(registers.y).put(registers.sr);
+        header.put<byte>(halted).put(cycleCount).put(irqLines);
+        header.put(memory.getPageCount()).put<word>(0);
+        for (int page = 0; page < 256; ++page) header.put(static_cast<std::uint32_t>(memory.physicalOffset(page) / 256));
+        for (int page = 0; page < 256; ++page) header.put<byte>(memory.isReadOnly(page));
+
+        // the state goes to a file of its own that then replaces `path`, which may be the file the store is
+        // mapped from, and which is left as it was if the write fails
+        const std::string temporary = path + ".tmp";
+        std::ofstream file(temporary, std::ios::binary);
+        if (!file) throw std::runtime_error("cannot write " + temporary);
+        const auto write = [&file](const std::span<const byte> bytes) {
+            file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        };
+        write(std::move(header).bytes());
+        write(std::move(records).bytes());
+        write(std::vector<byte>(storeOffset - headerSize - recordsSize));
+        write({memory.physical(), memory.physicalSize()});
+        file.close();
+
+        std::error_code error;
+        if (file) std::filesystem::rename(temporary, path, error);
+        if (!file || error) {
+            std::filesystem::remove(temporary, error);
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+
+    void restoreState(const std::string& path, CPU& cpu, const std::span<StatefulDevice* const> devices) {
+        Memory& memory = cpu.getMemory();
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error("cannot open " + path);
+        std::vector<byte> prefix(headerSize);
+        if (!file.read(reinterpret_cast<char*>(prefix.data()), headerSize)) throw std::runtime_error("save state is truncated");
+        const auto header = parseHeader(prefix);
+
+        if (const auto size = std::filesystem::file_size(path); size < header.storeOffset || size - header.storeOffset < header.storeSize) {
+            throw std::runtime_error("save state is truncated");
+        }
+        if (header.storeSize != memory.physicalSize() || header.pageCount != memory.getPageCount()) {
+            throw std::runtime_error(fmt::format("save state is of a machine with {} bytes of physical memory and {} pages of RAM",
+                header.storeSize, header.pageCount));
+        }
+
+        std::vector<byte> deviceBytes(header.devicesSize);
+        file.seekg(static_cast<std::streamoff>(header.devicesOffset));
+        if (!file.read(reinterpret_cast<char*>(deviceBytes.data()), static_cast<std::streamsize>(deviceBytes.size()))) {
+            throw std::runtime_error("save state is truncated");
+        }
+        const auto records = parseDevices(deviceBytes);
+
+        // devices of the same kind take the records with their name in order
+        std::vector<std::span<const byte>> states;
+        std::vector<bool> taken(records.size());
+        for (const auto* device : devices) {
+            const std::string_view name = device->stateName();
+            std::size_t i = 0;
+            while (i < records.size() && (taken[i] || records[i].name != name)) ++i;
+            if (i == records.size()) throw std::runtime_error(fmt::format("save state has no record for the {}", name));
+            taken[i] = true;
+            states.push_back(records[i].state);
+        }
+
+        // everything that can fail is done, from here on the machine is replaced as a whole
+#ifdef __unix__
+        memory.adoptStore(mapStore(path, header), header.storeSize, unmapStore);
+#else
+        auto store = std::make_unique<byte[]>(header.storeSize);
+        file.seekg(static_cast<std::streamoff>(header.storeOffset));
+        if (!file.read(reinterpret_cast<char*>(store.get()), static_cast<std::streamsize>(header.storeSize))) {
+            throw std::runtime_error("save state is truncated");
+        }
+        memory.adoptStore(store.release(), header.storeSize, [](byte* store, std::size_t) { delete[] store; });
+#endif
+        for (int page = 0; page < 256; ++page) {
+            memory.mapPhysical(page, 1, header.pages[page] * std::size_t{256}, !header.readOnly[page]);
+        }
+
+        cpu.setState(header.cpu);
+        for (std::size_t i = 0; i < devices.size(); ++i) devices[i]->restoreState(states[i]);
+    }
+
+} // mos6502
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+#include "cpu.h"
+
+namespace mos6502 {
+
+    // Builds a state, or a section of a save state, with every number little-endian.
+    class StateWriter {
+        std::vector<byte> out;
+
+    public:
+        template <std::integral T>
+        StateWriter& put(const T value) {
+            for (std::size_t i = 0; i < sizeof(T); ++i) out.push_back(static_cast<byte>(static_cast<std::uint64_t>(value) >> 8 * i));
+            return *this;
+        }
+
+        StateWriter& put(const std::span<const byte> bytes) {
+            out.insert(out.end(), bytes.begin(), bytes.end());
+            return *this;
+        }
+
+        [[nodiscard]] std::size_t size() const { return out.size(); }
+        [[nodiscard]] std::vector<byte> bytes() && { return std::move(out); }
+    };
+
+    // Reads what a StateWriter wrote, throwing std::runtime_error where it runs short.
+    class StateReader {
+        std::span<const byte> data;
+        std::size_t position = 0;
+
+    public:
+        explicit StateReader(const std::span<const byte> data) : data(data) {}
+
+        std::span<const byte> take(const std::size_t count) {
+            if (count > data.size() - position) throw std::runtime_error("save state is truncated");
+            const auto taken = data.subspan(position, count);
+            position += count;
+            return taken;
+        }
+
+        template <std::integral T>
+        T get() {
+            const auto bytes = take(sizeof(T));
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < sizeof(T); ++i) value |= static_cast<std::uint64_t>(bytes[i]) << 8 * i;
+            return static_cast<T>(value);
+        }
+
+        [[nodiscard]] bool done() const { return position == data.size(); }
+    };
+
+    // A device whose state goes into save states, alongside the CPU and memory.
+    class StatefulDevice {
+    public:
+        virtual ~StatefulDevice() = default;
+
+        // tells the device's record apart from the others in a file
+        [[nodiscard]] virtual const char* stateName() const = 0;
+
+        [[nodiscard]] virtual std::vector<byte> saveState() const = 0;
+
+        // called once the CPU is restored, so the device schedules its events and drives its IRQ line again;
+        // throws std::runtime_error if `state` is not one saveState() could have written
+        virtual void restoreState(std::span<const byte> state) = 0;
+    };
+
+    /*
+     * Save states: a machine's CPU, memory and device state in one versioned file.
+     *
+     * All numbers are little-endian. The file starts with a fixed header (magic "6502SAVE", the format version,
+     * where the other sections are, the CPU state, and the physical offset and read-only flag of each of the 256
+     * CPU pages), followed by the device records (a 16-bit name length, the name, a 32-bit state length and the
+     * state) and, at an offset aligned to 64 KiB, the whole physical store as it is in memory. Page handlers and
+     * the statistics of the run are not saved.
+     *
+     * The alignment lets restoreState() map the store from the file copy-on-write on Unix, so a machine starts
+     * from a saved state of any size in the time the header takes to read, and the pages it never writes are
+     * shared with every other machine started from the same file. Elsewhere the store is read in.
+     */
+    inline constexpr std::uint32_t saveStateVersion = 1;
+
+    // writes `cpu`, its memory and `devices` to `path`
+    void saveState(const std::string& path, const CPU& cpu, std::span<StatefulDevice* const> devices = {});
+
+    // puts `cpu`, its memory and `devices` back into the state saved in `path`; the machine must be built like
+    // the one that was saved, with the same physical memory and the devices attached, each of which needs a
+    // record in the file. Throws std::runtime_error for files that are not save states of such a machine.
+    void restoreState(const std::string& path, CPU& cpu, std::span<StatefulDevice* const> devices = {});
+
+} // mos6502
@@ -0,0 +1,164 @@
+#include "scheduler.h"
+
+namespace mos6502 {
+
+namespace {
+
+    // index of the worker running on this thread, none outside the pool
+    constexpr std::size_t noWorker = static_cast<std::size_t>(-1);
+    thread_local const void* currentScheduler = nullptr;
+    thread_local std::size_t currentWorker = noWorker;
+
+} // namespace
+
+    bool Scheduler::Event::Awaiter::await_suspend(const std::coroutine_handle<> handle) {
+        std::lock_guard lock(event.mutex);
+        if (event.signaled) {
+            event.signaled = false;
+            return false;
+        }
+        event.waiter = handle;
+        return true;
+    }
+
+    void Scheduler::Event::notify() {
+        std::coroutine_handle<> handle;
+        {
+            std::lock_guard lock(mutex);
+            handle = std::exchange(waiter, {});
+            if (!handle) signaled = true;
+        }
+        if (handle) scheduler.schedule(handle);
+    }
+
+    Scheduler::Scheduler(const unsigned threads) {
+        for (unsigned i = 0; i < std::max(1u, threads); ++i) workers.push_back(std::make_unique<Worker>());
+        for (std::size_t i = 0; i < workers.size(); ++i) this->threads.emplace_back([this, i] { work(i); });
+    }
+
+    Scheduler::~Scheduler() {
+        {
+            std::lock_guard lock(sleepMutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        threads.clear();
+
+        // tasks still queued or sleeping are dropped, ones waiting on an event belong to nobody and are leaked
+        for (const auto& worker : workers) {
+            for (const auto handle : worker->ready) handle.destroy();
+        }
+        for (; !timers.empty(); timers.pop()) timers.top().handle.destroy();
+    }
+
+    void Scheduler::spawn(Task task) {
+        task.handle.promise().scheduler = this;
+        {
+            std::lock_guard lock(sleepMutex);
+            ++live;
+        }
+        schedule(std::exchange(task.handle, {}));
+    }
+
+    void Scheduler::wait() {
+        std::unique_lock lock(sleepMutex);
+        finished.wait(lock, [this] { return live == 0; });
+        if (failure) std::rethrow_exception(std::exchange(failure, {}));
+    }
+
+    // the task may be running on another thread as soon as it is queued, the caller must not touch it again
+    void Scheduler::schedule(const std::coroutine_handle<> handle) {
+        // a task that yields stays on its thread, which keeps its machine's memory in that core's cache;
+        // tasks spawned or woken from outside the pool are dealt round robin
+        const auto index = currentScheduler == this ? currentWorker : nextWorker++ % workers.size();
+        {
+            std::lock_guard lock(workers[index]->mutex);
+            workers[index]->ready.push_back(handle);
+        }
+        {
+            std::lock_guard lock(sleepMutex);
+            ++queued;
+        }
+        wakeup.notify_one();
+    }
+
+    void Scheduler::scheduleAt(const std::coroutine_handle<> handle, const clock::time_point time) {
+        {
+            std::lock_guard lock(sleepMutex);
+            timers.push({time, handle});
+        }
+        // a sleeping thread may have to shorten its wait for this one
+        wakeup.notify_one();
+    }
+
+    std::coroutine_handle<> Scheduler::take(const std::size_t self) {
+        {
+            auto& own = *workers[self];
+            std::lock_guard lock(own.mutex);
+            if (!own.ready.empty()) {
+                const auto handle = own.ready.front();
+                own.ready.pop_front();
+                return handle;
+            }
+        }
+
+        // steals the most recently queued task of the first other thread that has one
+        for (std::size_t i = 1; i < workers.size(); ++i) {
+            auto& victim = *workers[(self + i) % workers.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.ready.empty()) {
+                const auto handle = victim.ready.back();
+                victim.ready.pop_back();
+                return handle;
+            }
+        }
+        return {};
+    }
+
+    void Scheduler::work(const std::size_t self) {
+        currentScheduler = this;
+        currentWorker = self;
+
+        while (true) {
+            {
+                std::unique_lock lock(sleepMutex);
+                while (true) {
+                    if (stopping) return;
+
+                    // due timers go onto this thread's queue, it is about to run one of them anyway
+                    std::size_t due = 0;
+                    while (!timers.empty() && timers.top().time <= clock::now()) {
+                        std::lock_guard own(workers[self]->mutex);
+                        workers[self]->ready.push_back(timers.top().handle);
+                        timers.pop();
+                        ++due;
+                    }
+                    queued += due;
+                    if (due > 1) wakeup.notify_all();
+
+                    if (queued > 0) break;
+                    if (timers.empty()) wakeup.wait(lock);
+                    else wakeup.wait_until(lock, timers.top().time);
+                }
+                --queued; // claims one of the queued tasks, so one is left somewhere for this thread
+            }
+
+            std::coroutine_handle<> handle;
+            do {
+                handle = take(self);
+            } while (!handle);
+
+            handle.resume();
+        }
+    }
+
+    void Scheduler::finish(const std::coroutine_handle<Task::promise_type> handle) noexcept {
+        auto exception = std::move(handle.promise().exception);
+        handle.destroy();
+
+        std::lock_guard lock(sleepMutex);
+        if (exception && !failure) failure = std::move(exception);
+        if (--live == 0) finished.notify_all();
+    }
+
+} // mos6502
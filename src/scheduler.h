@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mos6502 {
+
+    /*
+     * Runs many machines as coroutines on a fixed pool of threads.
+     *
+     * A machine is a Task that calls CPU::run() with a bounded budget and then either co_awaits yield(), to let
+     * the other machines on its thread have a turn, or co_awaits an Event when a device has no input for it.
+     * Every thread owns a queue of ready tasks; a thread whose queue runs dry steals from the others before
+     * going to sleep, and waiting tasks sit on their Event without occupying any thread. Tasks paced to real
+     * time co_await sleepUntil(), and whichever thread is idle when one is due picks it up.
+     */
+    class Scheduler {
+    public:
+        class Task {
+        public:
+            struct promise_type {
+                // hands a finished task back to its scheduler, which frees it
+                struct Finish {
+                    [[nodiscard]] bool await_ready() const noexcept { return false; }
+                    void await_suspend(const std::coroutine_handle<promise_type> handle) const noexcept {
+                        handle.promise().scheduler->finish(handle);
+                    }
+                    void await_resume() const noexcept {}
+                };
+
+                Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                Finish final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { exception = std::current_exception(); }
+
+                Scheduler* scheduler = nullptr;
+                std::exception_ptr exception;
+            };
+
+            Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+            Task& operator=(Task&&) = delete;
+            ~Task() { if (handle) handle.destroy(); }
+
+        private:
+            friend class Scheduler;
+
+            explicit Task(const std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        // a wakeup for one task, notify() before the task waits is remembered
+        class Event {
+            Scheduler& scheduler;
+            std::mutex mutex;
+            std::coroutine_handle<> waiter;
+            bool signaled = false;
+
+        public:
+            explicit Event(Scheduler& scheduler) : scheduler(scheduler) {}
+
+            struct Awaiter {
+                Event& event;
+
+                [[nodiscard]] bool await_ready() const noexcept { return false; }
+                bool await_suspend(std::coroutine_handle<> handle);
+                void await_resume() const noexcept {}
+            };
+
+            // co_await event.wait() suspends the task until the next notify(), may be called from any thread
+            [[nodiscard]] Awaiter wait() { return {*this}; }
+            void notify();
+        };
+
+        // starts `threads` workers, which sleep while no task is ready
+        explicit Scheduler(unsigned threads = std::max(1u, std::thread::hardware_concurrency()));
+        ~Scheduler();
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        // takes ownership of a task and queues it, it starts on whichever thread gets to it first
+        void spawn(Task task);
+
+        // blocks until every spawned task has finished, rethrows the first exception one of them let escape
+        void wait();
+
+        // co_await scheduler.yield() puts the task at the back of its thread's queue
+        struct Yield {
+            Scheduler& scheduler;
+
+            [[nodiscard]] bool await_ready() const noexcept { return false; }
+            void await_suspend(const std::coroutine_handle<> handle) const { scheduler.schedule(handle); }
+            void await_resume() const noexcept {}
+        };
+
+        [[nodiscard]] Yield yield() { return {*this}; }
+
+        using clock = std::chrono::steady_clock;
+
+        // co_await scheduler.sleepUntil(time) queues the task again once `time` has passed
+        struct Sleep {
+            Scheduler& scheduler;
+            clock::time_point time;
+
+            [[nodiscard]] bool await_ready() const { return time <= clock::now(); }
+            void await_suspend(const std::coroutine_handle<> handle) const { scheduler.scheduleAt(handle, time); }
+            void await_resume() const noexcept {}
+        };
+
+        [[nodiscard]] Sleep sleepUntil(const clock::time_point time) { return {*this, time}; }
+
+        [[nodiscard]] std::size_t threadCount() const { return workers.size(); }
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<std::coroutine_handle<>> ready;
+        };
+
+        struct Timer {
+            clock::time_point time;
+            std::coroutine_handle<> handle;
+
+            bool operator>(const Timer& other) const { return time > other.time; }
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::jthread> threads;
+
+        std::mutex sleepMutex;
+        std::condition_variable wakeup;   // a task became ready or the pool is stopping
+        std::condition_variable finished; // the last task finished
+        std::size_t queued = 0;           // ready tasks in all queues, guarded by sleepMutex
+        std::size_t live = 0;             // spawned tasks that have not finished, guarded by sleepMutex
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers; // guarded by sleepMutex
+        std::exception_ptr failure;
+        bool stopping = false;
+
+        std::atomic<std::size_t> nextWorker = 0;
+
+        void schedule(std::coroutine_handle<> handle);
+        void scheduleAt(std::coroutine_handle<> handle, clock::time_point time);
+        void finish(std::coroutine_handle<Task::promise_type> handle) noexcept;
+        [[nodiscard]] std::coroutine_handle<> take(std::size_t self);
+        void work(std::size_t self);
+    };
+
+} // mos6502
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+namespace mos6502 {
+
+    // Reusable lock-free barrier for a fixed number of threads. The last thread to arrive runs the completion
+    // step alone, with every other thread still waiting, then releases them all; waiters spin briefly before
+    // sleeping on the generation counter, so short phases do not pay for a wakeup.
+    class SpinBarrier {
+        const std::size_t count;
+        alignas(64) std::atomic<std::size_t> arrived{0};
+        alignas(64) std::atomic<std::uint64_t> generation{0};
+
+    public:
+        static constexpr int spins = 4096;
+
+        explicit SpinBarrier(const std::size_t count) : count(count) {}
+
+        template <typename Completion>
+        void arriveAndWait(Completion&& completion) {
+            const auto current = generation.load(std::memory_order_acquire);
+            if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+                completion();
+                arrived.store(0, std::memory_order_relaxed);
+                generation.store(current + 1, std::memory_order_release);
+                generation.notify_all();
+                return;
+            }
+
+            for (int i = 0; i < spins; ++i) {
+                if (generation.load(std::memory_order_acquire) != current) return;
+                if (i % 64 == 63) std::this_thread::yield();
+            }
+            while (generation.load(std::memory_order_acquire) == current) {
+                generation.wait(current, std::memory_order_acquire);
+            }
+        }
+    };
+
+} // mos6502
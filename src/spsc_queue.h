@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace mos6502 {
+
+    // Bounded lock-free queue for exactly one producer thread and one consumer thread.
+    template <typename T, std::size_t Capacity>
+    class SpscQueue {
+        static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+        std::array<T, Capacity> slots{};
+        alignas(64) std::atomic<std::size_t> head{0}; // next slot to pop, owned by the consumer
+        alignas(64) std::atomic<std::size_t> tail{0}; // next slot to push, owned by the producer
+
+    public:
+        // producer side, false if the queue is full
+        bool push(T value) {
+            const auto t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+
+            slots[t & (Capacity - 1)] = std::move(value);
+            tail.store(t + 1, std::memory_order_release);
+            tail.notify_one();
+            return true;
+        }
+
+        // consumer side
+        std::optional<T> pop() {
+            const auto h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) return std::nullopt;
+
+            T value = std::move(slots[h & (Capacity - 1)]);
+            head.store(h + 1, std::memory_order_release);
+            return value;
+        }
+
+        // producer side, a push() after false succeeds
+        [[nodiscard]] bool full() const {
+            return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) == Capacity;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+        // consumer side, blocks until something has been pushed
+        void wait() const {
+            const auto h = head.load(std::memory_order_relaxed);
+            tail.wait(h, std::memory_order_acquire);
+        }
+    };
+
+} // mos6502
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+#include "types.h"
+#include "alu.h"
+#include "assembler.h"
+#include "cpu.h"
+#include "opcodes.h"
+
+namespace mos6502 {
+
+    /*
+     * A 6502 that runs in constant expressions, so small routines (table generators, checksums) can run at
+     * compile time with their results embedded as constants, and what a routine does can be static_asserted.
+     *
+     * CPU cannot be made to: its memory dispatches to page handlers and may sit on a file mapping, and it
+     * dispatches through a table of member function pointers. StaticCPU keeps the 64 KiB in a std::array,
+     * decodes each opcode through the opcode table and a switch on its mnemonic, and gives the registers,
+     * memory and cycle counts CPU gives for the same program, without devices, interrupts or host calls. The ALU
+     * operations are CPU's own, see alu.h. Opcode 0x00 halts it, as it does CPU by default; an undefined opcode
+     * throws, failing the constant evaluation.
+     */
+    class StaticCPU {
+    public:
+        std::array<byte, 0x10000> memory{};
+        word pc{};
+        byte sp{};
+        byte ac{};
+        byte x{};
+        byte y{};
+        StatusFlags sr{};
+        std::uint64_t cycleCount{};
+        bool halted{};
+
+        constexpr StaticCPU() = default;
+
+        template <std::size_t Size>
+        constexpr explicit StaticCPU(const StaticProgram<Size>& program) {
+            load(program.code, program.origin, program.entryPoint);
+        }
+
+        // the state CPU::load() leaves: code in place, pc at the entry point and the stack empty
+        constexpr void load(const std::span<const byte> code, const address origin, const address entryPoint) {
+            for (std::size_t i = 0; i < code.size(); ++i) memory[static_cast<address>(origin + i)] = code[i];
+            pc = entryPoint;
+            sp = 0xFF;
+        }
+
+        [[nodiscard]] constexpr Registers getRegisters() const { return {pc, sp, ac, x, y, pack(sr)}; }
+
+        // runs until `budget` cycles have elapsed or the CPU halts, like CPU::run()
+        constexpr RunResult run(const std::uint64_t budget) {
+            if (halted) return {StopReason::Halted, 0, 0};
+
+            const auto start = cycleCount;
+            std::uint64_t instructions = 0;
+            while (cycleCount - start < budget) {
+                step();
+                if (halted) return {StopReason::Halted, cycleCount - start, instructions};
+                ++instructions;
+            }
+            return {StopReason::Budget, cycleCount - start, instructions};
+        }
+
+        // executes a single instruction, returns its cycles
+        constexpr cycles step() {
+            const byte opcode = memory[pc++];
+            if (opcode == 0x00) {
+                halted = true;
+                return 0;
+            }
+
+            const Opcode& info = opcodes[opcode];
+            cycles spent = info.cycles;
+            address ea = 0;
+
+            // the effective address, and the penalty of an indexed access that crosses a page
+            const auto indexed = [&](const address base, const byte index) {
+                ea = base + index;
+                if ((base ^ ea) & 0xFF00) spent += info.penalty;
+            };
+            switch (info.mode) {
+                case Mode::Implied:
+                case Mode::Accumulator:
+                case Mode::Relative:
+                    break;
+                case Mode::Immediate: ea = pc++; break;
+                case Mode::ZeroPage: ea = fetch(); break;
+                case Mode::ZeroPageX: ea = static_cast<byte>(fetch() + x); break;
+                case Mode::ZeroPageY: ea = static_cast<byte>(fetch() + y); break;
+                case Mode::Absolute: ea = fetchWord(); break;
+                case Mode::AbsoluteX: indexed(fetchWord(), x); break;
+                case Mode::AbsoluteY: indexed(fetchWord(), y); break;
+                case Mode::Indirect: {
+                    // the pointer's high byte does not carry into the next page
+                    const address pointer = fetchWord();
+                    ea = memory[pointer] | memory[(pointer & 0xFF00) | ((pointer + 1) & 0xFF)] << 8;
+                    break;
+                }
+                case Mode::IndirectX: ea = zeroPageWord(static_cast<byte>(fetch() + x)); break;
+                case Mode::IndirectY: indexed(zeroPageWord(fetch()), y); break;
+            }
+
+            const bool accumulator = info.mode == Mode::Accumulator;
+            const auto operand = [&] { return accumulator ? ac : memory[ea]; };
+            const auto modify = [&](const byte value) { (accumulator ? ac : memory[ea]) = value; };
+
+            using enum Mnemonic;
+            switch (info.mnemonic) {
+                case LDA: setNZ(ac = memory[ea]); break;
+                case LDX: setNZ(x = memory[ea]); break;
+                case LDY: setNZ(y = memory[ea]); break;
+                case STA: memory[ea] = ac; break;
+                case STX: memory[ea] = x; break;
+                case STY: memory[ea] = y; break;
+
+                case TAX: setNZ(x = ac); break;
+                case TAY: setNZ(y = ac); break;
+                case TXA: setNZ(ac = x); break;
+                case TYA: setNZ(ac = y); break;
+                case TSX: setNZ(x = sp); break;
+                case TXS: sp = x; break;
+
+                case PHA: push(ac); break;
+                case PHP: push(pack(sr) | 0x30); break;
+                case PLA: setNZ(ac = pop()); break;
+                case PLP: sr = unpack(pop() & 0xCF); break;
+
+                case AND: setNZ(ac &= memory[ea]); break;
+                case ORA: setNZ(ac |= memory[ea]); break;
+                case EOR: setNZ(ac ^= memory[ea]); break;
+                case ADC: ac = alu::adc(sr, ac, memory[ea]); break;
+                case SBC: ac = alu::sbc(sr, ac, memory[ea]); break;
+                case CMP: alu::compare(sr, ac, memory[ea]); break;
+                case CPX: alu::compare(sr, x, memory[ea]); break;
+                case CPY: alu::compare(sr, y, memory[ea]); break;
+                case BIT: alu::bit(sr, ac, memory[ea]); break;
+
+                case INC: setNZ(++memory[ea]); break;
+                case DEC: setNZ(--memory[ea]); break;
+                case INX: setNZ(++x); break;
+                case INY: setNZ(++y); break;
+                case DEX: setNZ(--x); break;
+                case DEY: setNZ(--y); break;
+
+                case ASL: modify(alu::asl(sr, operand())); break;
+                case LSR: modify(alu::lsr(sr, operand())); break;
+                case ROL: modify(alu::rol(sr, operand())); break;
+                case ROR: modify(alu::ror(sr, operand())); break;
+
+                case BCC: spent += branch(!sr.c); break;
+                case BCS: spent += branch(sr.c); break;
+                case BNE: spent += branch(!sr.z); break;
+                case BEQ: spent += branch(sr.z); break;
+                case BPL: spent += branch(!sr.n); break;
+                case BMI: spent += branch(sr.n); break;
+                case BVC: spent += branch(!sr.v); break;
+                case BVS: spent += branch(sr.v); break;
+
+                case JMP: pc = ea; break;
+                case JSR:
+                    // the return address pushed is the last byte of the JSR
+                    pushWord(pc - 1);
+                    pc = ea;
+                    break;
+                case RTS: pc = popWord() + 1; break;
+                case RTI:
+                    sr = unpack(pop() & 0xCF);
+                    pc = popWord();
+                    break;
+
+                case CLC: sr.c = false; break;
+                case CLD: sr.d = false; break;
+                case CLI: sr.i = false; break;
+                case CLV: sr.v = false; break;
+                case SEC: sr.c = true; break;
+                case SED: sr.d = true; break;
+                case SEI: sr.i = true; break;
+                case NOP: break;
+
+                case BRK:
+                case Illegal:
+                    throw std::runtime_error("Illegal instruction");
+            }
+
+            cycleCount += spent;
+            return spent;
+        }
+
+    private:
+        constexpr byte fetch() { return memory[pc++]; }
+
+        constexpr word fetchWord() {
+            const byte low = fetch();
+            return low | fetch() << 8;
+        }
+
+        [[nodiscard]] constexpr word zeroPageWord(const byte offset) const {
+            return memory[offset] | memory[static_cast<byte>(offset + 1)] << 8;
+        }
+
+        constexpr void push(const byte value) { memory[0x100 | sp--] = value; }
+        constexpr byte pop() { return memory[0x100 | ++sp]; }
+
+        constexpr void pushWord(const word value) {
+            push(value >> 8);
+            push(value & 0xFF);
+        }
+
+        constexpr word popWord() {
+            const byte low = pop();
+            return low | pop() << 8;
+        }
+
+        constexpr void setNZ(const byte value) { alu::setNZ(sr, value); }
+
+        // the extra cycles of a branch: one when taken, another when the target is on another page
+        constexpr cycles branch(const bool condition) {
+            const auto offset = static_cast<signed char>(fetch());
+            if (!condition) return 0;
+            const address target = pc + offset;
+            const bool pageChanged = (pc ^ target) & 0xFF00;
+            pc = target;
+            return opcodes[0x10].penalty * (1 + pageChanged);
+        }
+    };
+
+    // runs a program assembled at compile time until it halts, at compile time:
+    //     constexpr auto cpu = execute(assemble<"...">());
+    //     static_assert(cpu.memory[0x10] == 0x2A);
+    // a program that has not halted after `budget` cycles fails to compile, as does one that runs into the
+    // compiler's own limits on constant evaluation (-fconstexpr-loop-limit, -fconstexpr-steps)
+    template <std::size_t Size>
+    consteval StaticCPU execute(const StaticProgram<Size>& program, const std::uint64_t budget = 100'000) {
+        StaticCPU cpu(program);
+        if (cpu.run(budget).reason != StopReason::Halted) throw std::runtime_error("program did not halt");
+        return cpu;
+    }
+
+} // mos6502
@@ -0,0 +1,99 @@
+#include "system.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "spin_barrier.h"
+
+namespace mos6502 {
+
+    System::System(const std::size_t count, const byte firstShared, const word sharedPages, const std::uint64_t quantum)
+        : windowStart(firstShared << 8), quantum(quantum), window(sharedPages * 0x100) {
+        if (count == 0) throw std::invalid_argument("a system needs at least one CPU");
+        if (quantum == 0) throw std::invalid_argument("the quantum must not be 0");
+        if (firstShared + sharedPages > 256) throw std::out_of_range("shared window runs past the end of memory");
+
+        for (std::size_t i = 0; i < count; ++i) machines.push_back(std::make_unique<CPU>());
+    }
+
+    void System::merge() {
+        merged = window;
+        for (const auto& machine : machines) {
+            const Memory& memory = machine->getMemory();
+            for (std::size_t i = 0; i < window.size(); ++i) {
+                const byte value = memory.peek(static_cast<address>(windowStart + i));
+                if (value != window[i]) merged[i] = value;
+            }
+        }
+        window.swap(merged);
+
+        for (const auto& machine : machines) {
+            Memory& memory = machine->getMemory();
+            for (std::size_t i = 0; i < window.size(); ++i) {
+                const auto addr = static_cast<address>(windowStart + i);
+                if (memory.peek(addr) != window[i]) memory.poke(addr, window[i]);
+            }
+        }
+    }
+
+    System::Result System::run(const std::uint64_t budget) {
+        merge();
+
+        const auto count = machines.size();
+        const auto quanta = budget / quantum + (budget % quantum != 0);
+
+        Result result{std::vector<RunResult>(count, {StopReason::Budget, 0, 0}), 0};
+        std::vector<std::exception_ptr> failures(count);
+        bool stop = false; // set by the merge at a barrier, read by every thread once past it
+        SpinBarrier barrier(count);
+
+        const auto quantumDone = [&] {
+            merge();
+            ++result.quanta;
+            stop = std::ranges::any_of(failures, [](const auto& failure) { return failure != nullptr; })
+                || std::ranges::all_of(machines, [](const auto& machine) { return machine->isHalted(); })
+                || std::ranges::any_of(result.cpus, [](const RunResult& cpu) {
+                       return cpu.reason != StopReason::Budget && cpu.reason != StopReason::Halted;
+                   });
+        };
+
+        const auto work = [&](const std::size_t index) {
+            CPU& cpu = *machines[index];
+            RunResult& total = result.cpus[index];
+            const auto start = cpu.getCycleCount();
+
+            for (std::uint64_t q = 1; q <= quanta && !stop; ++q) {
+                // quantum boundaries count from the start, so overshooting one by an instruction does not drift
+                const auto span = q == quanta ? budget : q * quantum;
+                const auto end = span > std::numeric_limits<std::uint64_t>::max() - start ? std::numeric_limits<std::uint64_t>::max() : start + span;
+                try {
+                    while (cpu.getCycleCount() < end) {
+                        const auto ran = cpu.run(end - cpu.getCycleCount());
+                        total.cycles += ran.cycles;
+                        total.instructions += ran.instructions;
+                        total.reason = ran.reason;
+                        if (ran.reason != StopReason::Budget) break;
+                    }
+                } catch (...) {
+                    failures[index] = std::current_exception();
+                }
+                barrier.arriveAndWait(quantumDone);
+            }
+        };
+
+        {
+            std::vector<std::jthread> threads;
+            for (std::size_t i = 1; i < count; ++i) threads.emplace_back(work, i);
+            work(0);
+        }
+
+        for (const auto& failure : failures) {
+            if (failure) std::rethrow_exception(failure);
+        }
+        return result;
+    }
+
+} // mos6502
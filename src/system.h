@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "types.h"
+#include "cpu.h"
+
+namespace mos6502 {
+
+    /*
+     * Several CPUs, each with a Memory of its own, that share a window of RAM pages and run on a host thread each.
+     *
+     * run() advances the CPUs in quanta of `quantum` cycles. Every CPU runs its quantum on its own thread, then
+     * they all meet at a barrier, where the last to arrive merges the window: the bytes each CPU changed since
+     * the previous merge are applied in CPU order, so where two CPUs wrote the same byte the higher numbered one
+     * wins, and the result is copied back into every CPU. Within a quantum a CPU sees the window as it was at
+     * the start plus its own writes, and another CPU's writes at the next barrier. The outcome depends on the
+     * quantum alone, never on how the host schedules the threads.
+     *
+     * The window is plain RAM: the merge reads and writes it with peek() and poke(), past any handlers.
+     */
+    class System {
+    public:
+        struct Result {
+            std::vector<RunResult> cpus; // what each CPU did during this run(), with the reason it last stopped
+            std::uint64_t quanta;
+        };
+
+        // `count` CPUs sharing `sharedPages` pages from `firstShared` on
+        System(std::size_t count, byte firstShared, word sharedPages, std::uint64_t quantum);
+
+        System(const System&) = delete;
+        System& operator=(const System&) = delete;
+
+        [[nodiscard]] std::size_t size() const { return machines.size(); }
+        [[nodiscard]] CPU& cpu(const std::size_t index) { return *machines[index]; }
+
+        [[nodiscard]] std::uint64_t getQuantum() const { return quantum; }
+
+        // runs every CPU for `budget` cycles of its own, in quanta, on a thread each; stops early once all have
+        // halted, or after the quantum in which one stops for any other reason than its budget or halting.
+        // The window is merged first, so what was loaded into it before is shared too.
+        Result run(std::uint64_t budget);
+
+        // the window as of the last merge
+        [[nodiscard]] const std::vector<byte>& shared() const { return window; }
+
+    private:
+        std::vector<std::unique_ptr<CPU>> machines;
+        address windowStart;
+        std::uint64_t quantum;
+        std::vector<byte> window; // the merged contents, which every CPU's copy equals after a merge
+        std::vector<byte> merged; // the next contents while merging
+
+        void merge();
+    };
+
+} // mos6502
@@ -0,0 +1,320 @@
+#include "tick_core.h"
+
+#include <stdexcept>
+
+namespace mos6502 {
+
+    TickCore::TickCore(CPU& cpu) : cpu(cpu) {
+        restart();
+    }
+
+    TickCore::~TickCore() {
+        if (routine.handle) routine.handle.destroy();
+    }
+
+    // starts a fresh sequencer and runs it up to its first opcode fetch, which takes no cycle yet
+    void TickCore::restart() {
+        if (routine.handle) routine.handle.destroy();
+        routine = sequence();
+        routine.handle.resume();
+    }
+
+    void TickCore::tick() {
+        if (cpu.halted) return;
+
+        // device events and interrupt entry happen whole, before the opcode fetch
+        if (boundary && cpu.eventsPending()) cpu.serviceEvents();
+
+        routine.handle.resume();
+        if (const auto exception = routine.handle.promise().exception) [[unlikely]] {
+            restart();
+            std::rethrow_exception(exception);
+        }
+
+        // the fetch of a halting 0x00 does not count, as in CPU::step()
+        if (!cpu.halted) ++cpu.cycleCount;
+    }
+
+    cycles TickCore::step() {
+        const auto start = cpu.cycleCount;
+        do {
+            tick();
+        } while (!boundary && !cpu.halted);
+        return static_cast<cycles>(cpu.cycleCount - start);
+    }
+
+    RunResult TickCore::run(const std::uint64_t budget) {
+        if (cpu.halted) return {StopReason::Halted, 0, 0};
+
+        const auto start = cpu.cycleCount;
+        std::uint64_t instructions = 0;
+
+        cpu.stopReason = StopReason::Budget;
+        cpu.runEnd = budget > CPU::never - start ? CPU::never : start + budget;
+
+        // requestStop() changes the stop reason, device events and interrupts are taken by tick()
+        while (cpu.cycleCount < cpu.runEnd && cpu.stopReason == StopReason::Budget) {
+            if (cpu.breakpoints && cpu.breakpoints->at(cpu.pc)) {
+                cpu.stopReason = StopReason::Breakpoint;
+                break;
+            }
+
+            step();
+            if (cpu.halted) {
+                cpu.stopReason = StopReason::Halted;
+                break;
+            }
+            ++instructions;
+        }
+
+        return {cpu.stopReason, cpu.cycleCount - start, instructions};
+    }
+
+    TickCore::Routine TickCore::sequence() {
+        CPU& c = cpu;
+        using enum Mnemonic;
+
+        while (true) {
+            boundary = true;
+            const byte opcode = co_await OpcodeFetch{c};
+            boundary = false;
+
+            if (opcode == 0x00 && c.haltOnBrk) {
+                c.halted = true;
+                continue;
+            }
+
+            const Opcode& info = opcodes[opcode];
+            if (info.mnemonic == Illegal) {
+                if (!c.hostCall || opcode != c.hostCallOpcode) throw std::runtime_error("Illegal instruction");
+
+                const byte service = co_await read(c.pc++);
+                const cycles extra = c.hostCall->call(c, service);
+                for (cycles i = 0; i < extra; ++i) co_await Idle{};
+                continue;
+            }
+
+            if (info.mnemonic == JSR) {
+                // the high byte of the routine is fetched after the return address is pushed
+                const byte low = co_await read(c.pc++);
+                co_await read(0x100 | c.sp);
+                co_await write(0x100 | c.sp--, c.pc >> 8);
+                co_await write(0x100 | c.sp--, c.pc & 0xFF);
+                c.pc = low | (co_await read(c.pc)) << 8;
+                c.recordEdge(c.pc);
+                continue;
+            }
+
+            const bool writes = info.mnemonic == STA || info.mnemonic == STX || info.mnemonic == STY
+                             || info.mnemonic == ASL || info.mnemonic == LSR || info.mnemonic == ROL
+                             || info.mnemonic == ROR || info.mnemonic == INC || info.mnemonic == DEC;
+
+            // effective address, with the dummy cycles of the addressing mode
+            address ea = 0;
+            switch (info.mode) {
+                case Mode::Implied:
+                case Mode::Accumulator:
+                    co_await read(c.pc);
+                    break;
+                case Mode::Immediate:
+                    ea = c.pc++;
+                    break;
+                case Mode::ZeroPage:
+                    ea = co_await read(c.pc++);
+                    break;
+                case Mode::ZeroPageX:
+                case Mode::ZeroPageY: {
+                    const byte base = co_await read(c.pc++);
+                    co_await read(base);
+                    ea = static_cast<byte>(base + (info.mode == Mode::ZeroPageX ? c.x : c.y));
+                    break;
+                }
+                case Mode::Absolute:
+                case Mode::AbsoluteX:
+                case Mode::AbsoluteY:
+                case Mode::Indirect:
+                case Mode::IndirectY: {
+                    address base;
+                    if (info.mode == Mode::IndirectY) {
+                        const byte pointer = co_await read(c.pc++);
+                        const byte low = co_await read(pointer);
+                        base = low | (co_await read(static_cast<byte>(pointer + 1))) << 8;
+                    } else {
+                        const byte low = co_await read(c.pc++);
+                        base = low | (co_await read(c.pc++)) << 8;
+                    }
+
+                    if (info.mode == Mode::Absolute) {
+                        ea = base;
+                    } else if (info.mode == Mode::Indirect) {
+                        // the pointer's high byte does not carry into the next page
+                        const byte low = co_await read(base);
+                        ea = low | (co_await read((base & 0xFF00) | ((base + 1) & 0xFF))) << 8;
+                    } else {
+                        ea = base + (info.mode == Mode::AbsoluteX ? c.x : c.y);
+                        const bool pageCrossed = (base ^ ea) & 0xFF00;
+                        if (pageCrossed || writes) co_await read((base & 0xFF00) | (ea & 0xFF));
+                    }
+                    break;
+                }
+                case Mode::IndirectX: {
+                    const byte base = co_await read(c.pc++);
+                    co_await read(base);
+                    const byte pointer = base + c.x;
+                    const byte low = co_await read(pointer);
+                    ea = low | (co_await read(static_cast<byte>(pointer + 1))) << 8;
+                    break;
+                }
+                case Mode::Relative:
+                    ea = c.pc++;
+                    break;
+            }
+
+            switch (info.mnemonic) {
+                case LDA: c.lda(co_await read(ea)); break;
+                case LDX: c.ldx(co_await read(ea)); break;
+                case LDY: c.ldy(co_await read(ea)); break;
+                case STA: co_await write(ea, c.ac); break;
+                case STX: co_await write(ea, c.x); break;
+                case STY: co_await write(ea, c.y); break;
+
+                case ADC: c.adc(co_await read(ea)); break;
+                case SBC: c.sbc(co_await read(ea)); break;
+                case AND: c.and_(co_await read(ea)); break;
+                case EOR: c.eor_(co_await read(ea)); break;
+                case ORA: c.ora_(co_await read(ea)); break;
+                case CMP: c.cmp_(c.ac, co_await read(ea)); break;
+                case CPX: c.cmp_(c.x, co_await read(ea)); break;
+                case CPY: c.cmp_(c.y, co_await read(ea)); break;
+
+                case BIT: {
+                    const byte value = co_await read(ea);
+                    c.sr.z = (c.ac & value) == 0;
+                    c.sr.v = value & 0b01000000;
+                    c.sr.n = value & 0b10000000;
+                    break;
+                }
+
+                case ASL:
+                case LSR:
+                case ROL:
+                case ROR:
+                case INC:
+                case DEC: {
+                    const auto operation = [&](const byte value) -> byte {
+                        switch (info.mnemonic) {
+                            case ASL: return c.asl_(value);
+                            case LSR: return c.lsr_(value);
+                            case ROL: return c.rol_(value);
+                            case ROR: return c.ror_(value);
+                            default: {
+                                const byte result = value + (info.mnemonic == INC ? 1 : -1);
+                                c.sr.z = result == 0;
+                                c.sr.n = result & 0b10000000;
+                                return result;
+                            }
+                        }
+                    };
+                    if (info.mode == Mode::Accumulator) {
+                        c.ac = operation(c.ac);
+                    } else {
+                        const byte value = co_await read(ea);
+                        co_await write(ea, value);
+                        co_await write(ea, operation(value));
+                    }
+                    break;
+                }
+
+                case BCC: case BCS: case BEQ: case BMI: case BNE: case BPL: case BVC: case BVS: {
+                    const auto offset = static_cast<signed char>(co_await read(ea));
+                    bool taken;
+                    switch (info.mnemonic) {
+                        case BCC: taken = !c.sr.c; break;
+                        case BCS: taken = c.sr.c; break;
+                        case BEQ: taken = c.sr.z; break;
+                        case BMI: taken = c.sr.n; break;
+                        case BNE: taken = !c.sr.z; break;
+                        case BPL: taken = !c.sr.n; break;
+                        case BVC: taken = !c.sr.v; break;
+                        default: taken = c.sr.v; break;
+                    }
+                    if (taken) {
+                        co_await read(c.pc);
+                        const address target = c.pc + offset;
+                        if ((c.pc ^ target) & 0xFF00) co_await read((c.pc & 0xFF00) | (target & 0xFF));
+                        c.pc = target;
+                    }
+                    c.recordEdge(c.pc);
+                    break;
+                }
+
+                case JMP:
+                    c.pc = ea;
+                    c.recordEdge(c.pc);
+                    break;
+                case RTS: {
+                    co_await read(0x100 | c.sp);
+                    const byte low = co_await read(0x100 | ++c.sp);
+                    c.pc = low | (co_await read(0x100 | ++c.sp)) << 8;
+                    co_await read(c.pc++);
+                    c.recordEdge(c.pc);
+                    break;
+                }
+                case RTI: {
+                    co_await read(0x100 | c.sp);
+                    c.setStatus((co_await read(0x100 | ++c.sp)) & 0b11001111);
+                    const byte low = co_await read(0x100 | ++c.sp);
+                    c.pc = low | (co_await read(0x100 | ++c.sp)) << 8;
+                    break;
+                }
+                case BRK: {
+                    ++c.pc; // the padding byte was read as the byte after the opcode
+                    co_await write(0x100 | c.sp--, c.pc >> 8);
+                    co_await write(0x100 | c.sp--, c.pc & 0xFF);
+                    co_await write(0x100 | c.sp--, c.status() | 0b00110000);
+                    c.sr.i = true;
+                    const byte low = co_await read(0xFFFE);
+                    c.pc = low | (co_await read(0xFFFF)) << 8;
+                    break;
+                }
+
+                case PHA: co_await write(0x100 | c.sp--, c.ac); break;
+                case PHP: co_await write(0x100 | c.sp--, c.status() | 0b00110000); break;
+                case PLA:
+                    co_await read(0x100 | c.sp);
+                    c.lda(co_await read(0x100 | ++c.sp));
+                    break;
+                case PLP:
+                    co_await read(0x100 | c.sp);
+                    c.setStatus((co_await read(0x100 | ++c.sp)) & 0b11001111);
+                    break;
+
+                case TAX: c.ldx(c.ac); break;
+                case TAY: c.ldy(c.ac); break;
+                case TSX: c.ldx(c.sp); break;
+                case TXA: c.lda(c.x); break;
+                case TXS: c.sp = c.x; break;
+                case TYA: c.lda(c.y); break;
+
+                case DEX: c.ldx(c.x - 1); break;
+                case DEY: c.ldy(c.y - 1); break;
+                case INX: c.ldx(c.x + 1); break;
+                case INY: c.ldy(c.y + 1); break;
+
+                case CLC: c.sr.c = false; break;
+                case CLD: c.sr.d = false; break;
+                case CLI: c.sr.i = false; break;
+                case CLV: c.sr.v = false; break;
+                case SEC: c.sr.c = true; break;
+                case SED: c.sr.d = true; break;
+                case SEI: c.sr.i = true; break;
+
+                case NOP:
+                case JSR:
+                case Illegal:
+                    break;
+            }
+        }
+    }
+
+} // mos6502
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+
+#include "types.h"
+#include "cpu.h"
+
+namespace mos6502 {
+
+    /*
+     * Runs a CPU one bus cycle per tick() instead of one instruction per step(), so page handlers see every
+     * access, dummy ones included, at the cycle the hardware makes it.
+     *
+     * The instruction sequencer is a single C++20 coroutine that suspends before each bus cycle. Addressing
+     * and cycle order follow the NMOS 6502, the operations themselves are the CPU's own (adc, asl_, cmp_, ...).
+     * Registers, memory and the cycle count live in the CPU, so an instance can switch between this core and
+     * CPU::run() at any instruction boundary.
+     */
+    class TickCore {
+        struct Routine {
+            struct promise_type {
+                std::exception_ptr exception;
+
+                Routine get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                std::suspend_always final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { exception = std::current_exception(); }
+            };
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        // one bus cycle, performed when the coroutine is resumed by the next tick()
+        struct Cycle {
+            Memory& memory;
+            address addr;
+            byte value;
+            bool write;
+
+            [[nodiscard]] bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<>) const noexcept {}
+            byte await_resume() {
+                if (write) memory.write(addr, value);
+                else value = memory.read(addr);
+                return value;
+            }
+        };
+
+        // the opcode fetch takes the PC when it happens, so it can be changed between instructions
+        struct OpcodeFetch {
+            CPU& cpu;
+
+            [[nodiscard]] bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<>) const noexcept {}
+            byte await_resume() const { return cpu.opcode = cpu.memory.fetchOpcode(cpu.pc++); }
+        };
+
+        // a cycle without bus activity, spent by host calls
+        struct Idle {
+            [[nodiscard]] bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<>) const noexcept {}
+            void await_resume() const noexcept {}
+        };
+
+        CPU& cpu;
+        Routine routine{};
+        bool boundary = false;
+
+        Cycle read(const address addr) const { return {cpu.memory, addr, 0, false}; }
+        Cycle write(const address addr, const byte value) const { return {cpu.memory, addr, value, true}; }
+
+        Routine sequence();
+        void restart();
+
+    public:
+        explicit TickCore(CPU& cpu);
+        ~TickCore();
+
+        TickCore(const TickCore&) = delete;
+        TickCore& operator=(const TickCore&) = delete;
+
+        // performs one bus cycle, does nothing while the CPU is halted
+        void tick();
+
+        // true when the last instruction has completed and the next tick() fetches an opcode
+        [[nodiscard]] bool atInstructionBoundary() const { return boundary; }
+
+        // ticks through one whole instruction, returns its cycles
+        cycles step();
+
+        // same contract as CPU::run(budget): whole instructions until `budget` cycles have elapsed,
+        // the CPU halts, a breakpoint is reached or a stop is requested
+        RunResult run(std::uint64_t budget);
+    };
+
+} // mos6502
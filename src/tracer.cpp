@@ -0,0 +1,51 @@
+#include "tracer.h"
+
+#include <fmt/format.h>
+
+#include "disassembler.h"
+
+namespace mos6502 {
+
+    // "0204  E0 0A     CPX #$0A          A=00 X=00 Y=00 SP=FF P=00 CYC=8\n" stays well below this
+    constexpr std::size_t maxTraceLine = 128;
+
+    Tracer::Tracer(std::FILE* out, const std::size_t bufferSize) : out(out), buffer(bufferSize) {}
+
+    Tracer::~Tracer() {
+        flush();
+    }
+
+    void Tracer::record(const CPU& cpu) {
+        if (buffer.size() - used < maxTraceLine) flush();
+
+        const auto registers = cpu.getRegisters();
+        const auto& memory = cpu.getMemory();
+        const byte bytes[] = {
+            memory.peek(registers.pc),
+            memory.peek(registers.pc + 1),
+            memory.peek(registers.pc + 2),
+        };
+        const auto length = opcodes[bytes[0]].length;
+
+        char* line = buffer.data() + used;
+        char* end = fmt::format_to(line, "{:04X}  ", registers.pc);
+        for (byte i = 0; i < 3; ++i) {
+            end = i < length ? fmt::format_to(end, "{:02X} ", bytes[i]) : fmt::format_to(end, "   ");
+        }
+
+        char* text = end + 1;
+        *end = ' ';
+        end = disassemble(text, registers.pc, bytes);
+        while (end < text + maxInstructionLength + 2) *end++ = ' ';
+
+        end = fmt::format_to(end, "A={:02X} X={:02X} Y={:02X} SP={:02X} P={:02X} CYC={}\n",
+            registers.ac, registers.x, registers.y, registers.sp, registers.sr, cpu.getCycleCount());
+        used = end - buffer.data();
+    }
+
+    void Tracer::flush() {
+        std::fwrite(buffer.data(), 1, used, out);
+        used = 0;
+    }
+
+} // mos6502
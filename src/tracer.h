@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+#include "cpu.h"
+
+namespace mos6502 {
+
+    // Writes one line per executed instruction: address, bytes, disassembly and the registers before it.
+    class Tracer {
+        std::FILE* out;
+        std::vector<char> buffer;
+        std::size_t used = 0;
+
+    public:
+        explicit Tracer(std::FILE* out, std::size_t bufferSize = 1 << 20);
+        ~Tracer();
+
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        // to call before the instruction at the current pc executes
+        void record(const CPU& cpu);
+
+        void flush();
+    };
+
+} // mos6502
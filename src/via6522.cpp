@@ -0,0 +1,198 @@
+#include "via6522.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace mos6502 {
+
+    Via6522::Via6522(CPU& cpu, const address base, const std::uint32_t irqSource)
+        : cpu(cpu), memory(cpu.getMemory()), base(base), irqSource(irqSource) {
+        if ((base & 0xFF) > 0xF0) throw std::runtime_error("VIA registers must not cross a page boundary");
+        previousRead = memory.mapRead(base >> 8, this);
+        previousWrite = memory.mapWrite(base >> 8, this);
+    }
+
+    Via6522::~Via6522() {
+        if (memory.readHandler(base >> 8) == this) memory.mapRead(base >> 8, previousRead);
+        if (memory.writeHandler(base >> 8) == this) memory.mapWrite(base >> 8, previousWrite);
+        cpu.cancel(this);
+        cpu.setIrq(irqSource, false);
+    }
+
+    byte Via6522::read(const address addr) {
+        if (!inRange(addr)) return previousRead ? previousRead->read(addr) : memory.peek(addr);
+
+        const auto now = cpu.getCycleCount();
+        switch (static_cast<Register>(addr - base)) {
+            case ORB:
+                clearFlags(CB1 | CB2);
+                return portB();
+            case ORA:
+                clearFlags(CA1 | CA2);
+                return portA();
+            case ORANoHandshake: return portA();
+            case DDRB: return ddrb;
+            case DDRA: return ddra;
+            case T1CL:
+                clearFlags(Timer1);
+                return timer1(now) & 0xFF;
+            case T1CH: return timer1(now) >> 8;
+            case T1LL: return t1Latch & 0xFF;
+            case T1LH: return t1Latch >> 8;
+            case T2CL:
+                clearFlags(Timer2);
+                return timer2(now) & 0xFF;
+            case T2CH: return timer2(now) >> 8;
+            case SR: return sr;
+            case ACR: return acr;
+            case PCR: return pcr;
+            case IFR: return ifr | (ifr & ier ? 0x80 : 0x00);
+            case IER: return ier | 0x80;
+        }
+        return 0;
+    }
+
+    void Via6522::write(const address addr, const byte value) {
+        if (!inRange(addr)) {
+            if (previousWrite) previousWrite->write(addr, value);
+            else memory.poke(addr, value);
+            return;
+        }
+
+        const auto now = cpu.getCycleCount();
+        switch (static_cast<Register>(addr - base)) {
+            case ORB:
+                orb = value;
+                clearFlags(CB1 | CB2);
+                break;
+            case ORA:
+                ora = value;
+                clearFlags(CA1 | CA2);
+                break;
+            case ORANoHandshake: ora = value; break;
+            case DDRB: ddrb = value; break;
+            case DDRA: ddra = value; break;
+            case T1CL:
+            case T1LL:
+                t1Latch = (t1Latch & 0xFF00) | value;
+                break;
+            case T1LH:
+                t1Latch = (t1Latch & 0x00FF) | value << 8;
+                clearFlags(Timer1);
+                break;
+            case T1CH:
+                // loads the counter from the latch and starts it, the flag is set when it passes zero
+                t1Latch = (t1Latch & 0x00FF) | value << 8;
+                t1Count = t1Latch;
+                t1Start = now;
+                t1Next = now + t1Latch + 1;
+                t1Armed = true;
+                clearFlags(Timer1);
+                reschedule();
+                break;
+            case T2CL: t2LatchLow = value; break;
+            case T2CH:
+                t2Count = t2LatchLow | value << 8;
+                t2Start = now;
+                t2Armed = true;
+                clearFlags(Timer2);
+                reschedule();
+                break;
+            case SR: sr = value; break;
+            case ACR: acr = value; break;
+            case PCR: pcr = value; break;
+            case IFR: clearFlags(value & 0x7F); break;
+            case IER:
+                ier = value & 0x80 ? ier | (value & 0x7F) : ier & ~value;
+                updateIrq();
+                break;
+        }
+    }
+
+    void Via6522::expire(const std::uint64_t now) {
+        if (t1Armed && now >= t1Next) {
+            setFlags(Timer1);
+            if (continuous()) {
+                // reloaded from the latch the cycle after reaching 0xFFFF, so a period is the latch plus 2
+                const std::uint64_t period = t1Latch + 2;
+                t1Next += ((now - t1Next) / period + 1) * period;
+                t1Start = t1Next - t1Latch - 1;
+                t1Count = t1Latch;
+            } else {
+                t1Armed = false;
+            }
+        }
+        if (t2Armed && now >= t2Start + t2Count + 1) {
+            setFlags(Timer2);
+            t2Armed = false;
+        }
+        reschedule();
+    }
+
+    word Via6522::timer1(const std::uint64_t now) const {
+        // free-running and reloaded since, in the tick core expire() only runs at the end of the instruction
+        if (t1Armed && continuous() && now > t1Next) {
+            const std::uint64_t period = t1Latch + 2;
+            const auto phase = (now - t1Next) % period;
+            return phase == 0 ? 0xFFFF : static_cast<word>(t1Latch - (phase - 1));
+        }
+        if (now < t1Start) return 0xFFFF; // expire() ran at the underflow, the reload is the next cycle
+
+        // counts on down through 0xFFFF after a one-shot
+        return static_cast<word>(t1Count - (now - t1Start));
+    }
+
+    word Via6522::timer2(const std::uint64_t now) const {
+        return static_cast<word>(t2Count - (now - t2Start));
+    }
+
+    void Via6522::setFlags(const byte flags) {
+        ifr |= flags;
+        updateIrq();
+    }
+
+    void Via6522::clearFlags(const byte flags) {
+        ifr &= ~flags;
+        updateIrq();
+    }
+
+    std::vector<byte> Via6522::saveState() const {
+        StateWriter out;
+        out.put(ora).put(orb).put(ddra).put(ddrb).put(inputA).put(inputB).put(sr).put(acr).put(pcr).put(ifr).put(ier);
+        out.put(t1Latch).put(t1Count).put(t1Start).put(t1Next).put<byte>(t1Armed);
+        out.put(t2LatchLow).put(t2Count).put(t2Start).put<byte>(t2Armed);
+        return std::move(out).bytes();
+    }
+
+    void Via6522::restoreState(const std::span<const byte> state) {
+        StateReader in(state);
+        for (byte* field : {&ora, &orb, &ddra, &ddrb, &inputA, &inputB, &sr, &acr, &pcr, &ifr, &ier}) *field = in.get<byte>();
+        t1Latch = in.get<word>();
+        t1Count = in.get<word>();
+        t1Start = in.get<std::uint64_t>();
+        t1Next = in.get<std::uint64_t>();
+        t1Armed = in.get<byte>();
+        t2LatchLow = in.get<byte>();
+        t2Count = in.get<word>();
+        t2Start = in.get<std::uint64_t>();
+        t2Armed = in.get<byte>();
+        if (!in.done()) throw std::runtime_error("VIA state has the wrong size");
+
+        updateIrq();
+        reschedule();
+    }
+
+    void Via6522::updateIrq() {
+        cpu.setIrq(irqSource, ifr & ier & 0x7F);
+    }
+
+    void Via6522::reschedule() {
+        if (!t1Armed && !t2Armed) {
+            cpu.cancel(this);
+            return;
+        }
+        const auto t2Next = t2Start + t2Count + 1;
+        cpu.schedule(this, t1Armed && t2Armed ? std::min(t1Next, t2Next) : t1Armed ? t1Next : t2Next);
+    }
+
+} // mos6502
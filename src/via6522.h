@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+
+#include "types.h"
+#include "cpu.h"
+#include "memory.h"
+#include "save_state.h"
+
+namespace mos6502 {
+
+    /*
+     * MOS 6522 Versatile Interface Adapter: two 8-bit ports and two 16-bit interval timers with IRQ.
+     *
+     * The timers are not counted down per cycle. Loading one records the cycle it started at; reads compute the
+     * counter from the CPU's cycle count, and the underflow is a CPU::schedule() event, so a running timer costs
+     * nothing until it fires. The interpreter accesses registers at the cycle its instruction started, the tick
+     * core at the exact bus cycle.
+     *
+     * Modelled: ports A and B with data direction, timer 1 one-shot and free-running, timer 2 one-shot, IFR and
+     * IER. The shift register, PCR and handshake lines are plain storage, timer 2 always counts cycles and PB7
+     * is not driven by timer 1.
+     */
+    class Via6522 final : public PageHandler, public TimedDevice, public StatefulDevice {
+    public:
+        enum Register : byte {
+            ORB, ORA, DDRB, DDRA, T1CL, T1CH, T1LL, T1LH, T2CL, T2CH, SR, ACR, PCR, IFR, IER, ORANoHandshake,
+        };
+
+        enum Interrupt : byte {
+            CA2 = 0x01, CA1 = 0x02, Shift = 0x04, CB2 = 0x08, CB1 = 0x10, Timer2 = 0x20, Timer1 = 0x40,
+        };
+
+        // maps the 16 registers at `base`, the rest of its page keeps working as before
+        Via6522(CPU& cpu, address base, std::uint32_t irqSource = 0x01);
+        ~Via6522() override;
+
+        Via6522(const Via6522&) = delete;
+        Via6522& operator=(const Via6522&) = delete;
+
+        byte read(address addr) override;
+        void write(address addr, byte value) override;
+        void expire(std::uint64_t now) override;
+
+        [[nodiscard]] const char* stateName() const override { return "via"; }
+        [[nodiscard]] std::vector<byte> saveState() const override;
+        void restoreState(std::span<const byte> state) override;
+
+        // pin levels seen from outside: outputs where the data direction bit is set, the inputs elsewhere
+        [[nodiscard]] byte portA() const { return (ora & ddra) | (inputA & ~ddra); }
+        [[nodiscard]] byte portB() const { return (orb & ddrb) | (inputB & ~ddrb); }
+        void setInputA(const byte value) { inputA = value; }
+        void setInputB(const byte value) { inputB = value; }
+
+    private:
+        CPU& cpu;
+        Memory& memory;
+        address base;
+        std::uint32_t irqSource;
+        PageHandler* previousRead{};
+        PageHandler* previousWrite{};
+
+        byte ora{}, orb{}, ddra{}, ddrb{};
+        byte inputA = 0xFF, inputB = 0xFF; // undriven inputs are pulled up
+        byte sr{}, acr{}, pcr{}, ifr{}, ier{};
+
+        word t1Latch{};
+        word t1Count{};          // counter value at t1Start
+        std::uint64_t t1Start{}; // cycle timer 1 was last loaded at
+        std::uint64_t t1Next{};  // cycle of its next underflow
+        bool t1Armed{};          // the next underflow sets the interrupt flag
+
+        byte t2LatchLow{};
+        word t2Count{};
+        std::uint64_t t2Start{};
+        bool t2Armed{};
+
+        [[nodiscard]] bool continuous() const { return acr & 0x40; }
+        [[nodiscard]] word timer1(std::uint64_t now) const;
+        [[nodiscard]] word timer2(std::uint64_t now) const;
+
+        [[nodiscard]] bool inRange(address addr) const { return static_cast<address>(addr - base) < 16; }
+
+        void setFlags(byte flags);
+        void clearFlags(byte flags);
+        void updateIrq();
+        void reschedule();
+    };
+
+} // mos6502
@@ -0,0 +1,202 @@
+// Compile-time regression checks of instruction semantics, run on StaticCPU through the ALU it shares with CPU.
+// Nothing here runs: the target builds only if every static_assert holds.
+
+#include "static_cpu.h"
+
+namespace {
+
+    using namespace mos6502;
+
+    constexpr byte C = 0x01, Z = 0x02, I = 0x04, D = 0x08, V = 0x40, N = 0x80;
+
+    constexpr byte flags(const StaticCPU& cpu) { return cpu.getRegisters().sr; }
+
+    // loads and transfers set N and Z from the value moved, TXS leaves them alone
+    constexpr auto transfers = execute(assemble<R"(
+        .org $0200
+        LDA #$80
+        STA $10
+        TAX
+        STX $11
+        LDY #$00
+        STY $12
+        TYA
+        LDX #$7F
+        TXS
+        BRK
+    )">());
+    static_assert(transfers.memory[0x10] == 0x80 && transfers.memory[0x11] == 0x80 && transfers.memory[0x12] == 0x00);
+    static_assert(transfers.ac == 0x00 && transfers.x == 0x7F && transfers.sp == 0x7F);
+    static_assert(flags(transfers) == 0); // from LDX #$7F
+
+    constexpr auto transferFlags = execute(assemble<".org $0200 \n LDY #$00 \n BRK">());
+    static_assert(flags(transferFlags) == Z);
+
+#pragma region Binary arithmetic
+
+    // the signed overflow of two positives, and an unsigned carry out that leaves zero
+    constexpr auto addOverflow = execute(assemble<".org $0200 \n CLC \n LDA #$50 \n ADC #$50 \n BRK">());
+    static_assert(addOverflow.ac == 0xA0 && flags(addOverflow) == (N | V));
+
+    constexpr auto addCarry = execute(assemble<".org $0200 \n SEC \n LDA #$FF \n ADC #$00 \n BRK">());
+    static_assert(addCarry.ac == 0x00 && flags(addCarry) == (Z | C));
+
+    // carry is the inverted borrow
+    constexpr auto subtractBorrow = execute(assemble<".org $0200 \n SEC \n LDA #$50 \n SBC #$F0 \n BRK">());
+    static_assert(subtractBorrow.ac == 0x60 && flags(subtractBorrow) == 0);
+
+    constexpr auto subtractOverflow = execute(assemble<".org $0200 \n SEC \n LDA #$D0 \n SBC #$70 \n BRK">());
+    static_assert(subtractOverflow.ac == 0x60 && flags(subtractOverflow) == (V | C));
+
+    constexpr auto subtractCarryIn = execute(assemble<".org $0200 \n CLC \n LDA #$05 \n SBC #$03 \n BRK">());
+    static_assert(subtractCarryIn.ac == 0x01 && flags(subtractCarryIn) == C);
+
+#pragma endregion
+#pragma region Decimal arithmetic
+
+    constexpr auto decimalAdd = execute(assemble<".org $0200 \n SED \n CLC \n LDA #$19 \n ADC #$28 \n BRK">());
+    static_assert(decimalAdd.ac == 0x47 && flags(decimalAdd) == D);
+
+    // NMOS: Z comes from the binary sum, $9A, and N from $A0, the sum before the high digit is adjusted, though
+    // the accumulator ends up zero
+    constexpr auto decimalAddCarry = execute(assemble<".org $0200 \n SED \n CLC \n LDA #$99 \n ADC #$01 \n BRK">());
+    static_assert(decimalAddCarry.ac == 0x00 && flags(decimalAddCarry) == (D | N | C));
+
+    // V likewise: $79 + $01 overflows to $80
+    constexpr auto decimalAddSign = execute(assemble<".org $0200 \n SED \n CLC \n LDA #$79 \n ADC #$00 \n SEC \n ADC #$00 \n BRK">());
+    static_assert(decimalAddSign.ac == 0x80 && flags(decimalAddSign) == (D | N | V));
+
+    constexpr auto decimalSubtract = execute(assemble<".org $0200 \n SED \n SEC \n LDA #$46 \n SBC #$12 \n BRK">());
+    static_assert(decimalSubtract.ac == 0x34 && flags(decimalSubtract) == (D | C));
+
+    constexpr auto decimalBorrow = execute(assemble<".org $0200 \n SED \n SEC \n LDA #$40 \n SBC #$13 \n BRK">());
+    static_assert(decimalBorrow.ac == 0x27 && flags(decimalBorrow) == (D | C));
+
+    // the flags of a decimal subtraction are the binary ones: $00 - $01 is $FF, negative
+    constexpr auto decimalWrap = execute(assemble<".org $0200 \n SED \n SEC \n LDA #$00 \n SBC #$01 \n BRK">());
+    static_assert(decimalWrap.ac == 0x99 && flags(decimalWrap) == (D | N));
+
+#pragma endregion
+#pragma region Logic, compares and BIT
+
+    constexpr auto logic = execute(assemble<R"(
+        .org $0200
+        LDA #$F0
+        AND #$3C
+        STA $10
+        ORA #$0F
+        STA $11
+        EOR #$FF
+        STA $12
+        BRK
+    )">());
+    static_assert(logic.memory[0x10] == 0x30 && logic.memory[0x11] == 0x3F && logic.memory[0x12] == 0xC0);
+    static_assert(flags(logic) == N);
+
+    constexpr auto compareEqual = execute(assemble<".org $0200 \n LDA #$40 \n CMP #$40 \n BRK">());
+    static_assert(flags(compareEqual) == (Z | C));
+
+    constexpr auto compareLess = execute(assemble<".org $0200 \n LDX #$10 \n CPX #$20 \n BRK">());
+    static_assert(flags(compareLess) == N);
+
+    constexpr auto compareGreater = execute(assemble<".org $0200 \n LDY #$90 \n CPY #$10 \n BRK">());
+    static_assert(flags(compareGreater) == (N | C));
+
+    // BIT takes N and V from the operand and Z from the AND, leaving the accumulator alone
+    constexpr auto bitTest = execute(assemble<".org $0200 \n LDA #$C0 \n STA $10 \n LDA #$01 \n BIT $10 \n BRK">());
+    static_assert(bitTest.ac == 0x01 && flags(bitTest) == (N | V | Z));
+
+#pragma endregion
+#pragma region Shifts, rotates, increments
+
+    constexpr auto shifts = execute(assemble<R"(
+        .org $0200
+        LDA #$81
+        ASL A
+        STA $10
+        LDA #$81
+        STA $11
+        LSR $11
+        CLC
+        LDA #$80
+        ROL A
+        STA $12
+        ROR $13
+        BRK
+    )">());
+    static_assert(shifts.memory[0x10] == 0x02 && shifts.memory[0x11] == 0x40 && shifts.memory[0x12] == 0x00);
+    static_assert(shifts.memory[0x13] == 0x80 && flags(shifts) == N); // ROL's carry rotated into bit 7
+
+    constexpr auto increments = execute(assemble<R"(
+        .org $0200
+        LDA #$FF
+        STA $10
+        INC $10
+        DEC $11
+        LDX #$00
+        DEX
+        LDY #$7F
+        INY
+        BRK
+    )">());
+    static_assert(increments.memory[0x10] == 0x00 && increments.memory[0x11] == 0xFF);
+    static_assert(increments.x == 0xFF && increments.y == 0x80 && flags(increments) == N);
+
+#pragma endregion
+#pragma region Flow, stack and timing
+
+    // 2 (LDX) + 3 * 2 (DEX) + 2 * 3 (taken BNE) + 2 (falling through)
+    constexpr auto countedLoop = execute(assemble<".org $0200 \n LDX #3 \n loop: DEX \n BNE loop \n BRK">());
+    static_assert(countedLoop.x == 0 && countedLoop.cycleCount == 16);
+
+    // JSR pushes the address of its last byte, RTS returns past it
+    constexpr auto subroutine = execute(assemble<R"(
+        .org $0200
+        JSR set
+        STA $11
+        BRK
+    set:
+        LDA #$2A
+        STA $10
+        RTS
+    )">());
+    static_assert(subroutine.memory[0x10] == 0x2A && subroutine.memory[0x11] == 0x2A && subroutine.sp == 0xFF);
+    static_assert(subroutine.memory[0x1FF] == 0x02 && subroutine.memory[0x1FE] == 0x02);
+
+    // PHP pushes B and the unused bit set, PLP drops them
+    constexpr auto stack = execute(assemble<R"(
+        .org $0200
+        SEC
+        SED
+        PHP
+        PLA
+        STA $10
+        LDA #$C3
+        PHA
+        PLP
+        BRK
+    )">());
+    static_assert(stack.memory[0x10] == (0x30 | D | C) && flags(stack) == (N | V | Z | C));
+
+    // an indexed read crossing a page takes a cycle more, (zp),Y included
+    constexpr auto pageCross = execute(assemble<R"(
+        .org $0200
+        LDX #$01
+        LDA $10FF,X
+        LDA #$FF
+        STA $20
+        LDA #$10
+        STA $21
+        LDY #$01
+        LDA ($20),Y
+        BRK
+    )">());
+    static_assert(pageCross.cycleCount == 2 + 5 + 2 + 3 + 2 + 3 + 2 + 6);
+
+    // SEI sets only I, CLV and CLD clear their own flags
+    constexpr auto interruptFlag = execute(assemble<".org $0200 \n SEI \n CLV \n CLD \n BRK">());
+    static_assert(flags(interruptFlag) == I);
+
+#pragma endregion
+
+} // namespace
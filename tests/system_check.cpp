@@ -0,0 +1,100 @@
+// Runs two CPUs of a System through a mailbox handshake in their shared window: CPU 0 posts the numbers 1 to 100
+// one at a time and waits for each to be taken, CPU 1 takes them and adds them up in the window. Every quantum is
+// run several times over, and each run has to leave the same window and the same cycle and instruction counts,
+// whatever the thread timing, with the sum being 5050 at every quantum. An exchange takes two quanta, so the larger
+// ones mostly spin.
+//
+//   6502_system_check
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "assembler.h"
+#include "system.h"
+
+namespace {
+
+    using namespace mos6502;
+
+    // $4000 is set while $4001 holds a number not taken yet, $4002-$4003 the sum so far
+    constexpr auto producer = R"(
+        .org $0200
+        LDX #1
+send:   STX $4001
+        LDA #1
+        STA $4000
+wait:   LDA $4000
+        BNE wait
+        INX
+        CPX #101
+        BNE send
+        BRK
+    )";
+
+    constexpr auto consumer = R"(
+        .org $0200
+wait:   LDA $4000
+        BEQ wait
+        LDA $4001
+        CLC
+        ADC $4002
+        STA $4002
+        BCC taken
+        INC $4003
+taken:  LDA #0
+        STA $4000
+        LDA $4001
+        CMP #100
+        BNE wait
+        BRK
+    )";
+
+    struct Outcome {
+        std::vector<byte> window;
+        std::vector<RunResult> cpus;
+        std::uint64_t quanta;
+    };
+
+    Outcome handshake(const std::uint64_t quantum) {
+        System system(2, 0x40, 1, quantum);
+        system.cpu(0).load(assemble(producer));
+        system.cpu(1).load(assemble(consumer));
+        const auto result = system.run(2'500'000);
+        return {system.shared(), result.cpus, result.quanta};
+    }
+
+    bool operator==(const Outcome& a, const Outcome& b) {
+        return a.window == b.window && a.quanta == b.quanta && std::ranges::equal(a.cpus, b.cpus, [](const RunResult& x, const RunResult& y) {
+            return x.reason == y.reason && x.cycles == y.cycles && x.instructions == y.instructions;
+        });
+    }
+
+} // namespace
+
+int main() {
+    constexpr int repeats = 8;
+    bool failed = false;
+
+    for (const std::uint64_t quantum : {1, 3, 16, 100, 1000, 10'000}) {
+        const auto first = handshake(quantum);
+        const unsigned sum = first.window[2] | first.window[3] << 8;
+
+        if (sum != 5050 || first.cpus[0].reason != StopReason::Halted || first.cpus[1].reason != StopReason::Halted) {
+            fmt::println("quantum {}: sum {}, expected 5050 with both CPUs halted", quantum, sum);
+            failed = true;
+        }
+        for (int i = 1; i < repeats; ++i) {
+            if (handshake(quantum) != first) {
+                fmt::println("quantum {}: run {} differs from the first", quantum, i + 1);
+                failed = true;
+                break;
+            }
+        }
+        fmt::println("quantum {:>6}: {} quanta, {} and {} cycles", quantum, first.quanta, first.cpus[0].cycles, first.cpus[1].cycles);
+    }
+
+    return failed ? 1 : 0;
+}